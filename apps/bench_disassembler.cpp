@@ -0,0 +1,45 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "bdd_disassembler.hpp"
+#include "bdd_elf.hpp"
+
+/**
+ * Linear sweep of the whole .text of a file, as dump does for one function: instructions/sec & MB/sec
+ */
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <elf-file> [rounds]" << std::endl;
+    return 1;
+  }
+  unsigned rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+  if (rounds == 0) rounds = 1;
+
+  elf::ElfFile file(argv[1]);
+  auto text = file.getSectionData(".text");
+  auto address = file.getSectionAddress(".text");
+  if (text.empty()) {
+    std::cerr << argv[1] << " has no .text" << std::endl;
+    return 1;
+  }
+
+  std::size_t instructions = 0, bad = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned round = 0; round < rounds; round++) {
+    auto decoded = disasm::decodeAll(text.data(), text.size(), address);
+    instructions += decoded.size();
+    for (const auto &instruction: decoded) bad += !instruction.isValid();
+  }
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << argv[1] << ": " << text.size() << " bytes of .text, " << instructions / rounds << " instructions ("
+            << bad / rounds << " undecoded) per round" << std::endl;
+  std::cout << rounds << " rounds in " << seconds << "s: " << instructions / seconds << " instructions/sec, "
+            << rounds * text.size() / seconds / 1e6 << " MB/sec" << std::endl;
+  return 0;
+}
@@ -0,0 +1,36 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <cstdlib>
+#include <iostream>
+
+#include "bdd_ptrace.hpp"
+
+/**
+ * Launches a program again & again, as "restart" does: each launch kills & reaps the previous one, then stops the new
+ * one at its exec. Launches/sec & the time of each launch
+ */
+int main(int argc, char **argv) {
+  std::string path = argc > 1 ? argv[1] : STABLE_PROGRAM;
+  unsigned launches = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 300;
+
+  TracedProgram traced(path);
+  trace::Histogram perLaunch;
+  auto start = trace::clock::now();
+  for (unsigned i = 0; i < launches; i++) {
+    auto launch = trace::clock::now();
+    if (!traced.run() || !traced.hasExeced()) {
+      std::cerr << "Launch " << i << " of " << path << " failed" << std::endl;
+      return 1;
+    }
+    perLaunch.add(std::chrono::duration_cast<std::chrono::nanoseconds>(trace::clock::now() - launch).count());
+  }
+  auto seconds = std::chrono::duration<double>(trace::clock::now() - start).count();
+  traced.killTraced();
+  traced.waitForExit(std::chrono::milliseconds(200));
+
+  std::cout << launches << " launches in " << seconds << "s: " << launches / seconds << " launches/sec" << std::endl;
+  std::cout << "Per launch:" << std::endl << perLaunch.toString();
+  return 0;
+}
@@ -0,0 +1,78 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sys/ptrace.h>
+
+#include "bdd_ptrace.hpp"
+
+namespace {
+    constexpr std::size_t smallest = 4 << 10, largest = 16 << 20;
+
+    // Each size is read again until this long, for the small ones to be measurable
+    constexpr std::chrono::milliseconds least_duration(200);
+
+    /**
+     * @return the seconds per call of read, called at least once & for least_duration
+     */
+    template<typename Read>
+    double measure(Read &&read) {
+      unsigned calls = 0;
+      auto start = std::chrono::steady_clock::now();
+      std::chrono::steady_clock::duration elapsed{};
+      do {
+        read();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+      } while (elapsed < least_duration);
+      return std::chrono::duration<double>(elapsed).count() / calls;
+    }
+}
+
+/**
+ * Reads the 16 MiB buffer of buffer_program word by word (PTRACE_PEEKTEXT, as before the bulk reads) and through
+ * TracedProgram::readMemory, from 4 KiB to 16 MiB
+ */
+int main(int argc, char **argv) {
+  std::string path = argc > 1 ? argv[1] : BUFFER_PROGRAM;
+  TracedProgram traced(path);
+  if (!traced.breakpointAtFunction("buffer_ready") || !traced.run()) {
+    std::cerr << "Cannot run " << path << " up to buffer_ready" << std::endl;
+    return 1;
+  }
+  traced.ptraceContinue();
+  auto regs = traced.getRegisters();
+  if (!traced.isTrappedAtBreakpoint() || !regs || regs->rsi < largest) {
+    std::cerr << path << " did not stop in buffer_ready with a " << largest << " bytes buffer" << std::endl;
+    traced.stopTraced();
+    return 1;
+  }
+  addr_t buffer = regs->rdi;
+  pid_t pid = traced.getCurrentThread();
+
+  std::vector<std::uint8_t> peeked(largest), bulk(largest);
+  std::printf("%10s %16s %16s %8s\n", "bytes", "PEEKTEXT MB/s", "bulk MB/s", "speedup");
+  for (std::size_t size = smallest; size <= largest; size *= 4) {
+    auto peekSeconds = measure([&] {
+        for (std::size_t offset = 0; offset < size; offset += sizeof(long)) {
+          long word = ptrace(PTRACE_PEEKTEXT, pid, buffer + offset, nullptr);
+          std::memcpy(peeked.data() + offset, &word, sizeof(word));
+        }
+    });
+    auto bulkSeconds = measure([&] {
+        if (traced.readMemory(buffer, std::span(bulk.data(), size)).transferred != size) std::abort();
+    });
+    if (std::memcmp(peeked.data(), bulk.data(), size) != 0) {
+      std::cerr << "PEEKTEXT & bulk reads differ at " << size << " bytes" << std::endl;
+      traced.stopTraced();
+      return 1;
+    }
+    std::printf("%10zu %16.1f %16.1f %7.1fx\n", size, size / peekSeconds / 1e6, size / bulkSeconds / 1e6,
+                peekSeconds / bulkSeconds);
+  }
+  traced.stopTraced();
+  return 0;
+}
@@ -0,0 +1,81 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "bdd_exclusive_io.hpp"
+
+namespace {
+    // As the "functions" listing: an address & a long (mangled) name per line
+    const char *const name = "_ZNSt6vectorIiSaIiEE17_M_realloc_insertIJRKiEEEvN9__gnu_cxx";
+    constexpr std::uint64_t first_address = 0x401000;
+
+    /**
+     * @return the nanoseconds per line of print, called lines times
+     */
+    template<typename Print>
+    double measure(unsigned lines, Print &&print, bool flushed) {
+      auto start = std::chrono::steady_clock::now();
+      for (unsigned i = 0; i < lines; i++) print(first_address + i * 16);
+      if (flushed) ExclusiveIO::flush();
+      return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lines;
+    }
+}
+
+/**
+ * The "%" prints (printf format) against the fmt prints (runtime & FMT_COMPILE format strings), to stdout: run with
+ * it redirected (ex: > /dev/null), the figures go to stderr. Per line: the cost on the calling thread, then the end
+ * to end cost (until the drain thread wrote everything), then the formatting alone.
+ */
+int main(int argc, char **argv) {
+  unsigned lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  if (lines == 0) lines = 1;
+  if (isatty(STDOUT_FILENO)) std::fprintf(stderr, "stdout is a terminal: the figures measure it too\n");
+
+  ExclusiveIO::initialize(getpid());
+  auto percent = [](std::uint64_t address) { ExclusiveIO::info_f("[0x%016lX]: %s\n", address, name); };
+  auto runtime = [](std::uint64_t address) { ExclusiveIO::info_fmt("[0x{:016X}]: {}\n", address, name); };
+  auto compiled = [](std::uint64_t address) {
+      ExclusiveIO::info_fmt(FMT_COMPILE("[0x{:016X}]: {}\n"), address, name);
+  };
+
+  // Warm-up: rings & buffers grown
+  measure(lines, percent, true);
+  std::fprintf(stderr, "%u lines, ns per line: %12s %12s\n", lines, "caller", "end to end");
+  for (const auto &[label, print]: {std::pair<const char *, void (*)(std::uint64_t)>{"% path", percent},
+                                    {"fmt (runtime)", runtime},
+                                    {"FMT_COMPILE", compiled}}) {
+    auto caller = measure(lines, print, false);
+    ExclusiveIO::flush();
+    auto endToEnd = measure(lines, print, true);
+    std::fprintf(stderr, "%-30s %12.0f %12.0f\n", label, caller, endToEnd);
+  }
+  ExclusiveIO::terminate();
+
+  // What the drain thread does per record
+  std::string out;
+  auto formatting = [&out, lines](auto &&format) {
+      auto start = std::chrono::steady_clock::now();
+      for (unsigned i = 0; i < lines; i++) {
+        out.clear();
+        format(first_address + i * 16);
+      }
+      return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lines;
+  };
+  std::fprintf(stderr, "Formatting alone, ns per line: snprintf %.0f, fmt %.0f, FMT_COMPILE %.0f\n",
+               formatting([&out](std::uint64_t address) {
+                   char line[128];
+                   out.append(line, std::snprintf(line, sizeof(line), "[0x%016lX]: %s\n", address, name));
+               }),
+               formatting([&out](std::uint64_t address) {
+                   fmt::format_to(std::back_inserter(out), "[0x{:016X}]: {}\n", address, name);
+               }),
+               formatting([&out](std::uint64_t address) {
+                   fmt::format_to(std::back_inserter(out), FMT_COMPILE("[0x{:016X}]: {}\n"), address, name);
+               }));
+  return 0;
+}
@@ -0,0 +1,132 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+#include "bdd_elf.hpp"
+
+namespace {
+    // Every 4th symbol is an object: read, then skipped by the index
+    constexpr unsigned object_every = 4;
+
+    constexpr addr_t text_address = 0x400000, function_size = 16;
+
+    /**
+     * Writes an ELF file holding a .text without bytes (NOBITS) and a .symtab of count symbols, out of address order
+     * @return the path of the file, in the temporary directory
+     */
+    std::string writeElf(unsigned count) {
+      std::vector<Elf_SymRef> symbols(count + 1);
+      std::vector<char> strings{0};
+      char name[64];
+      for (unsigned i = 1; i <= count; i++) {
+        auto &symbol = symbols[i];
+        auto length = snprintf(name, sizeof(name), "_ZN5bench8function%uEv", i);
+        symbol.st_name = strings.size();
+        strings.insert(strings.end(), name, name + length + 1);
+        auto type = i % object_every == 0 ? STT_OBJECT : STT_FUNC;
+        symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, type);
+        symbol.st_shndx = 1;
+        // Scattered (Knuth's multiplicative hash), aliases included: the index has sorting to do
+        symbol.st_value = text_address + function_size * ((i * 2654435761U) % count);
+        symbol.st_size = function_size;
+      }
+      const char names[] = "\0.text\0.symtab\0.strtab\0.shstrtab";
+      auto symbolBytes = symbols.size() * sizeof(Elf_SymRef);
+
+      // Header, .symtab, .strtab, .shstrtab, then the section headers
+      std::array<Elf_Shdr, 5> sections{};
+      sections[1].sh_name = 1;
+      sections[1].sh_type = SHT_NOBITS;
+      sections[1].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+      sections[1].sh_addr = text_address;
+      sections[1].sh_size = function_size * count;
+      sections[2].sh_name = 7;
+      sections[2].sh_type = SHT_SYMTAB;
+      sections[2].sh_offset = sizeof(Elf_Ehdr);
+      sections[2].sh_size = symbolBytes;
+      sections[2].sh_link = 3;
+      sections[2].sh_info = 1;
+      sections[2].sh_entsize = sizeof(Elf_SymRef);
+      sections[3].sh_name = 15;
+      sections[3].sh_type = SHT_STRTAB;
+      sections[3].sh_offset = sections[2].sh_offset + symbolBytes;
+      sections[3].sh_size = strings.size();
+      sections[4].sh_name = 23;
+      sections[4].sh_type = SHT_STRTAB;
+      sections[4].sh_offset = sections[3].sh_offset + strings.size();
+      sections[4].sh_size = sizeof(names);
+
+      Elf_Ehdr header{};
+      std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+      header.e_ident[EI_CLASS] = ELFCLASS64;
+      header.e_ident[EI_DATA] = ELFDATA2LSB;
+      header.e_ident[EI_VERSION] = EV_CURRENT;
+      header.e_type = ET_EXEC;
+      header.e_machine = EM_X86_64;
+      header.e_version = EV_CURRENT;
+      header.e_ehsize = sizeof(Elf_Ehdr);
+      header.e_shentsize = sizeof(Elf_Shdr);
+      header.e_shnum = sections.size();
+      header.e_shstrndx = 4;
+      header.e_shoff = (sections[4].sh_offset + sizeof(names) + 7) & ~addr_t(7);
+
+      char path[] = "/tmp/c_bdd_bench_symbols_XXXXXX";
+      int fd = mkstemp(path);
+      if (fd == -1) return "";
+      FILE *file = fdopen(fd, "wb");
+      std::fwrite(&header, sizeof(header), 1, file);
+      std::fwrite(symbols.data(), sizeof(Elf_SymRef), symbols.size(), file);
+      std::fwrite(strings.data(), 1, strings.size(), file);
+      std::fwrite(names, 1, sizeof(names), file);
+      std::fseek(file, (long) header.e_shoff, SEEK_SET);
+      std::fwrite(sections.data(), sizeof(Elf_Shdr), sections.size(), file);
+      std::fclose(file);
+      return path;
+    }
+}
+
+/**
+ * Builds the symbol index (decode, sort, name lookup table) of a generated ELF file: symbols/sec
+ */
+int main(int argc, char **argv) {
+  unsigned count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  unsigned rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+  if (count == 0 || rounds == 0) {
+    std::cerr << "Usage: " << argv[0] << " [symbols] [rounds]" << std::endl;
+    return 1;
+  }
+  // Measuring the decoding, not the cache
+  setenv("C_BDD_NO_INDEX_CACHE", "1", 1);
+
+  auto path = writeElf(count);
+  if (path.empty()) {
+    std::cerr << "Cannot write the ELF file" << std::endl;
+    return 1;
+  }
+  std::size_t functions = count - count / object_every;
+  double best = 0;
+  for (unsigned round = 0; round < rounds; round++) {
+    elf::ElfFile file(path);
+    auto start = std::chrono::steady_clock::now();
+    auto indexed = file.getFunctionSymbols().size();
+    auto named = file.findFunctionByName("_ZN5bench8function1Ev");
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (indexed != functions || named == nullptr) {
+      std::cerr << indexed << " functions indexed, " << functions << " expected" << std::endl;
+      unlink(path.c_str());
+      return 1;
+    }
+    std::cout << "Round " << round << ": " << count << " symbols in " << seconds * 1e3 << "ms, " << count / seconds
+              << " symbols/sec" << std::endl;
+    best = std::max(best, count / seconds);
+  }
+  std::cout << "Best: " << best << " symbols/sec (" << functions << " functions indexed)" << std::endl;
+  unlink(path.c_str());
+  return 0;
+}
@@ -0,0 +1,31 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <cstdlib>
+#include <iostream>
+
+#include "bdd_ptrace.hpp"
+
+/**
+ * Traces the two callees of calls_program (2 calls per iteration) up to its exit: hits/sec & round trip per hit
+ */
+int main(int argc, char **argv) {
+  std::string path = argc > 1 ? argv[1] : CALLS_PROGRAM;
+  std::string iterations = argc > 2 ? argv[2] : "100000";
+  std::vector<char *> parameters{iterations.data()};
+
+  TracedProgram traced(path);
+  if (!traced.run(parameters)) {
+    std::cerr << "Cannot run " << path << std::endl;
+    return 1;
+  }
+  auto report = traced.trace({"callee_*"});
+  std::cout << report.toString();
+  auto expected = 2 * std::strtoul(iterations.c_str(), nullptr, 0);
+  if (report.totalHits() != expected) {
+    std::cerr << report.totalHits() << " hits, " << expected << " calls expected" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,72 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "bdd_ptrace.hpp"
+
+namespace {
+    // Each unwinder backtraces again until this long
+    constexpr std::chrono::milliseconds least_duration(500);
+
+    struct Measure {
+        std::size_t frames = 0;
+        double seconds = 0; // per backtrace
+    };
+
+    Measure measure(TracedProgram &traced, TracedProgram::Unwinder unwinder) {
+      // Warm-up: modules, call frame information & libunwind's caches loaded
+      Measure result{traced.backtrace(unwinder).size(), 0};
+      unsigned calls = 0;
+      auto start = std::chrono::steady_clock::now();
+      std::chrono::steady_clock::duration elapsed{};
+      do {
+        if (traced.backtrace(unwinder).size() != result.frames) std::abort();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+      } while (elapsed < least_duration);
+      result.seconds = std::chrono::duration<double>(elapsed).count() / calls;
+      return result;
+    }
+}
+
+/**
+ * Backtraces recursion_program (built without frame pointers) from its deepest call, through the own unwinder (CFI,
+ * stack read in bulk) then libunwind (a ptrace call per word): frames/sec of each
+ */
+int main(int argc, char **argv) {
+  std::string path = argc > 1 ? argv[1] : RECURSION_PROGRAM;
+  std::string depth = argc > 2 ? argv[2] : "200";
+  std::vector<char *> parameters{depth.data()};
+
+  TracedProgram traced(path);
+  if (!traced.breakpointAtFunction("deepest") || !traced.run(parameters)) {
+    std::cerr << "Cannot run " << path << " up to deepest" << std::endl;
+    return 1;
+  }
+  traced.ptraceContinue();
+  if (!traced.isTrappedAtBreakpoint()) {
+    std::cerr << path << " did not stop in deepest" << std::endl;
+    traced.stopTraced();
+    return 1;
+  }
+
+  auto own = measure(traced, TracedProgram::Unwinder::Own);
+  auto libunwind = measure(traced, TracedProgram::Unwinder::Libunwind);
+  traced.stopTraced();
+  std::printf("%-10s %8s %16s %14s\n", "unwinder", "frames", "us/backtrace", "frames/sec");
+  for (const auto &[label, result]: {std::pair{"own", own}, {"libunwind", libunwind}}) {
+    if (result.frames == 0) {
+      std::printf("%-10s %8s\n", label, "failed");
+      continue;
+    }
+    std::printf("%-10s %8zu %16.1f %14.0f\n", label, result.frames, result.seconds * 1e6,
+                result.frames / result.seconds);
+  }
+  if (own.frames != 0 && libunwind.frames != 0)
+    std::printf("Speedup: %.1fx\n", (libunwind.seconds / libunwind.frames) / (own.seconds / own.frames));
+  return own.frames != 0 ? 0 : 1;
+}
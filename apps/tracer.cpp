@@ -2,25 +2,48 @@
 // Created by byjtew on 08/03/2022.
 //
 
+#include <fstream>
 #include <iostream>
 #include <unistd.h>
 #include <cstdlib>
 #include <vector>
 
 #include "bdd_ptrace.hpp"
+#include "bdd_session.hpp"
 #include "bdd_exclusive_io.hpp"
 
 static bool force_end = false;
 
-std::vector<std::string> readInput() {
+// Above, the ticks come faster than the program can be stopped & walked
+constexpr unsigned long profile_max_frequency = 10000;
+
+// A dump is printed at once: beyond, better read by chunks
+constexpr unsigned long mem_max_size = 1 << 20;
+
+/**
+ * Every input goes through the event loop of the traced program: lines typed while it runs are kept for here
+ */
+std::vector<std::string> readInput(TracedProgram &traced) {
   std::vector<std::string> words;
-  std::string sentence, word;
-  std::getline(std::cin, sentence);
-  std::istringstream iss(sentence);
+  auto sentence = traced.readLine();
+  if (!sentence) { // stdin closed
+    force_end = true;
+    return words;
+  }
+  std::istringstream iss(*sentence);
+  std::string word;
   while (iss >> word) words.push_back(word);
   return words;
 }
 
+/**
+ * @return the first word of the next line, empty if none
+ */
+std::string readAnswer(TracedProgram &traced) {
+  auto words = readInput(traced);
+  return words.empty() ? "" : words.front();
+}
+
 static std::map<std::string, std::string> usage_map = {
     {"r",                              "Run the traced program."},
     {"run",                            "Run the traced program."},
@@ -36,6 +59,8 @@ static std::map<std::string, std::string> usage_map = {
 
     {"kill",                           "Force the traced program to stop (SIGKILL). Memory leaks may occur."},
 
+    {"interrupt",                      "Typed while the traced program runs: stop it and get the prompt back."},
+
     {"status",                         "Display the current state of the traced program (exited/segfault/...)."},
 
     {"functions",                      "Display every functions in the traced program."},
@@ -45,18 +70,48 @@ static std::map<std::string, std::string> usage_map = {
     {"registers",                      "Display every registers values (as %llu only)."},
     {"reg / registers",                "Display every registers values (as %llu only)."},
 
-    {"d",                              "Display the program (assembly & C) with the next n lines from the current location."},
-    {"dump",                           "Display the program (assembly & C) with the next n lines from the current location."},
-    {"d / dump <n>",                   "Display the program (assembly & C) with the next n lines from the current location."},
+    {"d",                              "Display the disassembled program with the next n lines from the current location."},
+    {"dump",                           "Display the disassembled program with the next n lines from the current location."},
+    {"d / dump <n>",                   "Display the disassembled program with the next n lines from the current location."},
 
-    {"bp",                             "Creates a breakpoint at the specified location."},
+    {"bp",                             "Creates a breakpoint at the specified location (address, function or file:line)."},
     {"bp <address|function-name>",     "Creates a breakpoint at the specified location."},
 
-    {"bp off",                         "Removes a breakpoint from the specified location."},
-    {"bp off <address|function-name>", "Removes a breakpoint from the specified location."},
+    {"bp off",                         "Removes a breakpoint from the specified location (address, function or file:line)."},
+    {"bp off <address|function-name|file:line>", "Removes a breakpoint from the specified location."},
 
     {"bp show",                        "Display every breakpoints."},
 
+    {"mem",                            "Display the traced program memory (hexadecimal & ASCII)."},
+    {"mem <address> <size>",           "Display the traced program memory (hexadecimal & ASCII)."},
+
+    {"inferiors",                      "Display every debugged process: the program, its forks & spawned instances."},
+
+    {"inferior",                       "Select the process to inspect, step & continue."},
+    {"inferior <id>",                  "Select the process to inspect, step & continue."},
+
+    {"spawn",                          "Start another instance of the program, stopped at its first instruction."},
+    {"spawn <parameters>",             "Start another instance of the program, stopped at its first instruction."},
+
+    {"threads",                        "Display every thread of the traced program (* marks the current one)."},
+
+    {"thread",                         "Select the thread to inspect, step & continue (it must be stopped)."},
+    {"thread <tid>",                   "Select the thread to inspect, step & continue (it must be stopped)."},
+
+    {"mode",                           "Stop every thread on an event (all-stop) or only the one concerned (non-stop)."},
+    {"mode <all-stop|non-stop>",       "Stop every thread on an event (all-stop) or only the one concerned (non-stop)."},
+
+    {"trace",                          "Count the calls of the matching functions without stopping, then show the hits."},
+    {"trace <pattern...> [-t]",        "Count the calls of the matching functions (glob or /regex/), -t records timestamps."},
+
+    {"profile",                        "Sample the stacks of the running program, then show the hottest functions."},
+    {"profile <hz> [seconds] [folded-file]",
+                                       "Sample the stacks at hz, write them folded (flame graphs) or show them."},
+
+    {"output",                         "Where the program output goes from the next run: inherited, or captured (pipe/pty)."},
+    {"output <inherit|pipe|pty> [log-file] [-q]",
+                                       "Capture the program output, also to a log file with stop markers (-q: log only)."},
+
     {"bt",                             "Show the current stack."},
     {"backtrace",                      "Show the current stack."},
     {"bt / backtrace",                 "Show the current stack."},
@@ -88,13 +143,24 @@ void manCommand() {
                            "restart\t\t\t\t\t\t\t ", usage_map.at("restart"), "\n",
                            "stop   \t\t\t\t\t\t\t ", usage_map.at("stop"), "\n",
                            "kill   \t\t\t\t\t\t\t ", usage_map.at("kill"), "\n",
+                           "interrupt \t\t\t\t\t\t ", usage_map.at("interrupt"), "\n",
                            "status \t\t\t\t\t\t\t ", usage_map.at("status"), "\n",
                            "functions <full>\t\t\t\t ", usage_map.at("functions"), "\n",
                            "reg, registers\t\t\t\t\t ", usage_map.at("reg"), "\n",
                            "d, dump <n> \t\t\t\t\t ", usage_map.at("d"), "\n",
-                           "bp <address|function-name> \t\t ", usage_map.at("bp"), "\n",
-                           "bp off <address|function-name> \t ", usage_map.at("bp off"), "\n",
+                           "bp <address|function-name|file:line> \t ", usage_map.at("bp"), "\n",
+                           "bp off <address|function-name|file:line> ", usage_map.at("bp off"), "\n",
                            "bp show \t\t\t\t\t\t ", usage_map.at("bp show"), "\n",
+                           "mem <address> <size> \t\t\t ", usage_map.at("mem"), "\n",
+                           "inferiors \t\t\t\t\t\t ", usage_map.at("inferiors"), "\n",
+                           "inferior <id> \t\t\t\t\t ", usage_map.at("inferior"), "\n",
+                           "spawn <parameters> \t\t\t\t ", usage_map.at("spawn"), "\n",
+                           "threads \t\t\t\t\t\t ", usage_map.at("threads"), "\n",
+                           "thread <tid> \t\t\t\t\t ", usage_map.at("thread"), "\n",
+                           "mode <all-stop|non-stop> \t\t ", usage_map.at("mode"), "\n",
+                           "trace <pattern...> [-t] \t\t ", usage_map.at("trace"), "\n",
+                           "profile <hz> [seconds] [file] \t\t ", usage_map.at("profile"), "\n",
+                           "output <inherit|pipe|pty> [log] [-q] \t ", usage_map.at("output"), "\n",
                            "bt, backtrace \t\t\t\t\t ", usage_map.at("bt"), "\n",
                            "elf \t\t\t\t\t\t\t ", usage_map.at("elf"), "\n",
                            "help, man \t\t\t\t\t\t ", usage_map.at("man"), "\n",
@@ -107,7 +173,7 @@ void versionCommand() {
   ExclusiveIO::info_nf("Current version: ", BDD_VERSION, "\n");
 }
 
-void runCommand(TracedProgram &traced, std::vector<std::string> &input);
+void runCommand(DebugSession &session, std::vector<std::string> &input);
 
 void ipCommand(const TracedProgram &traced);
 
@@ -125,33 +191,54 @@ void restartCommand(TracedProgram &traced);
 
 void bpCommand(TracedProgram &traced, std::vector<std::string> &input);
 
+void memCommand(const TracedProgram &traced, const std::vector<std::string> &input);
+
 void bpOffCommand(TracedProgram &traced, const std::vector<std::string> &input);
 
+void traceCommand(TracedProgram &traced, const std::vector<std::string> &input);
+
+void profileCommand(TracedProgram &traced, const std::vector<std::string> &input);
+
+void threadsCommand(const TracedProgram &traced);
+
+void threadCommand(TracedProgram &traced, const std::vector<std::string> &input);
+
+void modeCommand(TracedProgram &traced, const std::vector<std::string> &input);
+
+void outputCommand(TracedProgram &traced, const std::vector<std::string> &input);
+
+void inferiorsCommand(const DebugSession &session);
+
+void inferiorCommand(DebugSession &session, const std::vector<std::string> &input);
+
+void spawnCommand(DebugSession &session, std::vector<std::string> &input);
+
 void statusCommand(const TracedProgram &traced);
 
-void elfCommand(const TracedProgram &traced);
+void elfCommand(TracedProgram &traced);
 
-void stopCommand(const TracedProgram &traced);
+void stopCommand(TracedProgram &traced);
 
 void killCommand(const TracedProgram &traced);
 
 void bpShowCommand(TracedProgram &traced);
 
-void command_loop(TracedProgram &traced) {
+void command_loop(DebugSession &session) {
   std::vector<std::string> input;
   ExclusiveIO::info_f("Debug ready.\n");
 
   do {
     input.clear();
+    auto &traced = session.current();
     onIPStopped(traced);
 
     ExclusiveIO::info_f("$ : ");
-    input = readInput();
+    input = readInput(traced);
     if (input.empty()) continue;
     std::string choice = input.at(0);
 
     if (choice == "run" || choice == "r")
-      runCommand(traced, input);
+      runCommand(session, input);
     else if ((choice == "restart") && (traced.isAlive() && !traced.isExiting()))
       restartCommand(traced);
     else if (choice.starts_with("bp") && input.size() > 1 && input.at(1).starts_with("off"))
@@ -166,6 +253,26 @@ void command_loop(TracedProgram &traced) {
       functionsCommand(traced, input);
     else if (choice == "step")
       stepCommand(traced);
+    else if (choice == "mem")
+      memCommand(traced, input);
+    else if (choice == "inferiors")
+      inferiorsCommand(session);
+    else if (choice == "inferior")
+      inferiorCommand(session, input);
+    else if (choice == "spawn")
+      spawnCommand(session, input);
+    else if (choice == "threads")
+      threadsCommand(traced);
+    else if (choice == "thread")
+      threadCommand(traced, input);
+    else if (choice == "mode")
+      modeCommand(traced, input);
+    else if (choice == "trace")
+      traceCommand(traced, input);
+    else if (choice == "profile")
+      profileCommand(traced, input);
+    else if (choice == "output")
+      outputCommand(traced, input);
     else if (choice == "bt" || choice == "backtrace")
       backtraceCommand(traced);
     else if (choice == "reg" || choice == "registers")
@@ -198,29 +305,37 @@ void restart(TracedProgram &traced) {
   traced.run();
 }
 
-void runCommand(TracedProgram &traced, std::vector<std::string> &input) {
+void runCommand(DebugSession &session, std::vector<std::string> &input) {
+  auto &traced = session.current();
   std::string validation_input;
   if (!traced.hasStarted()) { // Executing
     std::vector<char *> params;
     for (unsigned i = 1; i < input.size(); i++)
       params.push_back(input.at(i).data());
-    traced.run(params);
-    traced.ptraceContinue();
-  } else if (traced.isDead() || traced.isExiting()) { // Restart
+    if (traced.run(params))
+      session.continueCurrent();
+  } else if ((traced.isDead() || traced.isExiting()) && !session.isForked(session.getCurrentId())) { // Restart
     ExclusiveIO::info_f("Re-run the program [Y/n]: ");
 
-    ExclusiveIO::input(validation_input);
+    validation_input = readAnswer(traced);
     if (validation_input == "y" || validation_input == "Y")
       restart(traced);
 
   } else {
     ExclusiveIO::info_f("Continuing program.\n");
-    traced.ptraceContinue();
+    session.continueCurrent();
   }
 }
 
 void ipCommand(const TracedProgram &traced) {
-  ExclusiveIO::info_f("Current pointer address: 0x%016lX\n", traced.getIP());
+  auto elf_ip = traced.getElfIP();
+  auto function = traced.getElfFile().findFunctionByAddress(elf_ip);
+  auto location = traced.getSourceLocation(elf_ip);
+  if (!location.empty()) location.insert(0, " at ");
+  if (function == nullptr)
+    return ExclusiveIO::info_f("Current pointer address: 0x%016lX%s\n", traced.getIP(), location.c_str());
+  ExclusiveIO::info_f("Current pointer address: 0x%016lX (%s+0x%lX)%s\n", traced.getIP(),
+                      std::string(function->name).c_str(), elf_ip - function->address, location.c_str());
 }
 
 
@@ -232,15 +347,15 @@ void killCommand(const TracedProgram &traced) {
   }
 }
 
-void stopCommand(const TracedProgram &traced) {
+void stopCommand(TracedProgram &traced) {
   std::string validation_input;
   {
     ExclusiveIO::info_f("Stopping program.\n");
     traced.stopTraced();
-    usleep(200000); // Waiting for the traced program to stop
-    if (traced.isAlive()) {
+    // Its SIGINT is delivered, 200 ms to exit
+    if (!traced.waitForExit(std::chrono::milliseconds(200))) {
       ExclusiveIO::info_f("The program doesn't stop, do you want to force it [Y/n]: \n");
-      ExclusiveIO::input(validation_input);
+      validation_input = readAnswer(traced);
       if (validation_input.starts_with('Y') || validation_input.starts_with('y')) {
         traced.killTraced();
         force_end = true;
@@ -250,8 +365,10 @@ void stopCommand(const TracedProgram &traced) {
   }
 }
 
-void elfCommand(const TracedProgram &traced) {
-  auto types_and_names = traced.getElfFile().getSymbolsNames();
+void elfCommand(TracedProgram &traced) {
+  // Held for the command: the program may exec another file meanwhile
+  auto elf_file = traced.shareElfFile();
+  auto types_and_names = elf_file->getSymbolsNames();
   std::string hint("Elf available informations:\n1. Program header\n");
   std::vector<std::string> possibles_index;
   int index = 2;
@@ -262,17 +379,18 @@ void elfCommand(const TracedProgram &traced) {
   });
   ExclusiveIO::infoHigh_nf(hint);
   ExclusiveIO::infoHigh_nf("Type the index that you want to display: ");
-  std::string index_selected;
-  ExclusiveIO::input(index_selected);
+  auto index_selected = readAnswer(traced);
   if (index_selected == "1") {
-    traced.getElfFile().printHeader();
+    elf_file->printHeader();
   } else if (std::find(possibles_index.cbegin(), possibles_index.cend(), index_selected) !=
              possibles_index.cend()) {
     int asked_index = (int) strtoul(index_selected.c_str(), nullptr, 0);
-    traced.getElfFile().printSectionHeaderAt(asked_index - 2);
+    elf_file->printSectionHeaderAt(asked_index - 2);
   } else {
     ExclusiveIO::error_f("Unknown index.\n");
   }
+  // Printed through stdio, the logs are written to the file descriptor directly
+  fflush(stdout);
   traced.showStatus();
 }
 
@@ -318,16 +436,23 @@ void backtraceCommand(TracedProgram &traced) {
 void stepCommand(TracedProgram &traced) {
   ExclusiveIO::info_f("Stepping program.\n");
   traced.ptraceStep();
+  auto location = traced.getSourceLocation(traced.getElfIP());
+  if (!location.empty()) ExclusiveIO::info_f("At %s\n", location.c_str());
 }
 
 
 void functionsCommand(const TracedProgram &traced, std::vector<std::string> &input) {
-  auto functionsList = traced.getElfFile().getFunctionsList();
+  const auto &functions = traced.getElfFile().getFunctionSymbols();
   auto full_details = (input.size() > 1 && input.at(1).starts_with("full"));
   ExclusiveIO::info_f("Functions:\n");
-  std::for_each(functionsList.begin(), functionsList.end(), [full_details](const auto &it) {
-      if (it.first > 0 || full_details)
-        ExclusiveIO::info_f("[0x%016lX]: %s\n", it.first, it.second.c_str());
+  std::for_each(functions.cbegin(), functions.cend(), [full_details](const elf::Symbol &it) {
+      if (it.address == 0 && !full_details) return;
+      // Demangled here only: a handful of names are shown out of the whole index
+      auto demangled = elf::demangle(it.name);
+      if (demangled == it.name)
+        ExclusiveIO::info_fmt(FMT_COMPILE("[0x{:016X}]: {}\n"), it.address, it.name);
+      else
+        ExclusiveIO::info_fmt(FMT_COMPILE("[0x{:016X}]: {} ({})\n"), it.address, it.name, demangled);
   });
 }
 
@@ -336,15 +461,21 @@ void bpShowCommand(TracedProgram &traced) {
 }
 
 void bpOffCommand(TracedProgram &traced, const std::vector<std::string> &input) {
-  if (input.size() == 1)
-    return show_usage_for("bp <address|function-name>");
-  std::string bp_choice = input.at(1);
+  if (input.size() == 2)
+    return show_usage_for("bp off <address|function-name|file:line>");
+  std::string bp_choice = input.at(2);
   if (bp_choice.starts_with("0x")) { // Hex choice
     ExclusiveIO::debug_f("Placing bp by address at: 0x%016lX\n", bp_choice.c_str());
     if (!traced.disableBreakpointAtAddress(bp_choice))
       ExclusiveIO::error_f("Breakpoint[%s] failed: wrong address.\n");
     else
       ExclusiveIO::info_f("Breakpoint[%s] disabled.\n", bp_choice.c_str());
+  } else if (bp_choice.find(':') != std::string::npos) { // Source line choice
+    ExclusiveIO::debug_f("Removing bp by source line: %s\n", bp_choice.c_str());
+    if (!traced.disableBreakpointAtLine(bp_choice))
+      ExclusiveIO::error_f("Breakpoint[%s] failed: no breakpoint at this line.\n", bp_choice.c_str());
+    else
+      ExclusiveIO::info_f("Breakpoint[%s] removed.\n", bp_choice.c_str());
   } else { // Name choice
     ExclusiveIO::debug_f("Placing bp by function name: %s\n", bp_choice.c_str());
     if (!traced.disableBreakpointAtFunction(bp_choice))
@@ -366,6 +497,12 @@ void bpCommand(TracedProgram &traced, std::vector<std::string> &input) {
       ExclusiveIO::error_f("Breakpoint[%s] failed: wrong address.\n");
     else
       ExclusiveIO::info_f("Breakpoint[%s] placed.\n", bp_choice.c_str());
+  } else if (bp_choice.find(':') != std::string::npos) { // Source line choice
+    ExclusiveIO::debug_f("Placing bp by source line: %s\n", bp_choice.c_str());
+    if (!traced.breakpointAtLine(bp_choice))
+      ExclusiveIO::error_f("Breakpoint[%s] failed: no code at this line.\n", bp_choice.c_str());
+    else
+      ExclusiveIO::info_f("Breakpoint[%s] placed.\n", bp_choice.c_str());
   } else { // Name choice
     ExclusiveIO::debug_f("Placing bp by function name: %s\n", bp_choice.c_str());
     if (!traced.breakpointAtFunction(bp_choice))
@@ -376,10 +513,197 @@ void bpCommand(TracedProgram &traced, std::vector<std::string> &input) {
   bpShowCommand(traced);
 }
 
+void memCommand(const TracedProgram &traced, const std::vector<std::string> &input) {
+  if (input.size() < 2 || !traced.hasStarted())
+    return show_usage_for("mem <address> <size>");
+  auto address = (addr_t) strtoul(input.at(1).c_str(), (char **) nullptr, 0);
+  auto size = input.size() > 2 ? strtoul(input.at(2).c_str(), (char **) nullptr, 0) : 64;
+  if (size > mem_max_size)
+    return ExclusiveIO::error_f("The size must be at most %lu bytes.\n", mem_max_size);
+
+  std::vector<std::uint8_t> buffer(size);
+  auto access = traced.readMemory(address, buffer);
+  std::string msg;
+  char row[128];
+  for (std::size_t line = 0; line < access.transferred; line += 16) {
+    auto length = snprintf(row, sizeof(row), "[0x%016lX]: ", address + line);
+    std::string ascii;
+    for (std::size_t i = line; i < line + 16; i++) {
+      if (i < access.transferred) {
+        length += snprintf(row + length, sizeof(row) - length, "%02x ", buffer[i]);
+        ascii += isprint(buffer[i]) ? (char) buffer[i] : '.';
+      } else
+        length += snprintf(row + length, sizeof(row) - length, "   ");
+    }
+    msg.append(row).append(" ").append(ascii).append("\n");
+  }
+  ExclusiveIO::info_nf("Memory:\n", msg);
+  if (!access.complete())
+    ExclusiveIO::error_f("Cannot read at 0x%016lX: %s\n", *access.failedAt, strerror(access.error));
+}
+
+void traceCommand(TracedProgram &traced, const std::vector<std::string> &input) {
+  std::vector<std::string> patterns;
+  bool timestamps = false;
+  for (unsigned i = 1; i < input.size(); i++) {
+    if (input.at(i) == "-t") timestamps = true;
+    else patterns.push_back(input.at(i));
+  }
+  if (patterns.empty())
+    return show_usage_for("trace <pattern...> [-t]");
+  if (!traced.hasStarted()) {
+    if (!traced.run()) return;
+  } else if (traced.isDead() || traced.isExiting())
+    return ExclusiveIO::error_f("The program is not running, use 'run' first.\n");
+
+  ExclusiveIO::info_f("Tracing program.\n");
+  trace::Report report;
+  try {
+    report = traced.trace(patterns, timestamps);
+  } catch (const std::invalid_argument &e) {
+    return ExclusiveIO::error_f("%s\n", e.what());
+  }
+  if (report.functions.empty())
+    return ExclusiveIO::error_f("No function matches.\n");
+  ExclusiveIO::info_nf("Trace:\n", report.toString(), "\n");
+}
+
+void profileCommand(TracedProgram &traced, const std::vector<std::string> &input) {
+  if (input.size() < 2)
+    return show_usage_for("profile <hz> [seconds] [folded-file]");
+  char *end;
+  auto frequency = strtoul(input.at(1).c_str(), &end, 10);
+  if (*end != '\0' || frequency == 0 || frequency > profile_max_frequency)
+    return ExclusiveIO::error_f("The frequency must be within 1-%lu Hz.\n", profile_max_frequency);
+  std::optional<profile::clock::duration> duration;
+  std::string path;
+  for (unsigned i = 2; i < input.size(); i++) {
+    auto seconds = strtod(input.at(i).c_str(), &end);
+    if (!duration && *end == '\0' && seconds > 0)
+      duration = std::chrono::duration_cast<profile::clock::duration>(std::chrono::duration<double>(seconds));
+    else
+      path = input.at(i);
+  }
+  if (!traced.hasStarted()) {
+    if (!traced.run()) return;
+  } else if (traced.isDead() || traced.isExiting())
+    return ExclusiveIO::error_f("The program is not running, use 'run' first.\n");
+
+  ExclusiveIO::info_f("Profiling program at %lu Hz.\n", frequency);
+  auto report = traced.profile(frequency, duration);
+  if (report.samples == 0)
+    return ExclusiveIO::error_f("No sample taken.\n");
+  if (path.empty())
+    ExclusiveIO::info_nf("Folded stacks:\n", report.folded);
+  else {
+    std::ofstream folded(path, std::ios::trunc);
+    if (!(folded << report.folded))
+      ExclusiveIO::error_f("Cannot write the folded stacks to %s.\n", path.c_str());
+    else
+      ExclusiveIO::info_f("Folded stacks written to %s.\n", path.c_str());
+  }
+  ExclusiveIO::info_nf("Profile:\n", report.toString(), "\n");
+}
+
+void threadsCommand(const TracedProgram &traced) {
+  if (!traced.hasStarted())
+    return ExclusiveIO::error_f("The program is not running.\n");
+  std::string msg;
+  char row[256];
+  for (const auto &[tid, thread]: traced.getThreads()) {
+    auto marker = tid == traced.getCurrentThread() ? '*' : ' ';
+    auto ip = traced.getThreadIP(tid);
+    if (thread.running || !ip)
+      snprintf(row, sizeof(row), "%c %d: running\n", marker, tid);
+    else if (WIFSTOPPED(thread.status))
+      snprintf(row, sizeof(row), "%c %d: stopped (%s) at 0x%016lX\n", marker, tid, strsignal(WSTOPSIG(thread.status)), *ip);
+    else
+      snprintf(row, sizeof(row), "%c %d: exited\n", marker, tid);
+    msg.append(row);
+  }
+  ExclusiveIO::info_nf("Threads:\n", msg);
+}
+
+void threadCommand(TracedProgram &traced, const std::vector<std::string> &input) {
+  if (input.size() < 2)
+    return show_usage_for("thread <tid>");
+  auto tid = (pid_t) strtol(input.at(1).c_str(), (char **) nullptr, 10);
+  if (!traced.selectThread(tid))
+    return ExclusiveIO::error_f("Thread %d is unknown or running.\n", tid);
+  ExclusiveIO::info_f("Current thread: %d\n", tid);
+}
+
+void modeCommand(TracedProgram &traced, const std::vector<std::string> &input) {
+  if (input.size() < 2)
+    return ExclusiveIO::info_f("Mode: %s\n", traced.getStopMode() == StopMode::AllStop ? "all-stop" : "non-stop");
+  if (input.at(1) == "all-stop")
+    traced.setStopMode(StopMode::AllStop);
+  else if (input.at(1) == "non-stop")
+    traced.setStopMode(StopMode::NonStop);
+  else
+    return show_usage_for("mode <all-stop|non-stop>");
+  ExclusiveIO::info_f("Mode: %s\n", input.at(1).c_str());
+}
+
+void outputCommand(TracedProgram &traced, const std::vector<std::string> &input) {
+  auto options = traced.getOutput();
+  if (input.size() >= 2) {
+    options = {};
+    if (input.at(1) == "pipe")
+      options.mode = output::Mode::Pipe;
+    else if (input.at(1) == "pty")
+      options.mode = output::Mode::Pty;
+    else if (input.at(1) != "inherit")
+      return show_usage_for("output <inherit|pipe|pty> [log-file] [-q]");
+    for (unsigned i = 2; i < input.size(); i++) {
+      if (input.at(i) == "-q") options.console = false;
+      else options.log_path = input.at(i);
+    }
+    if (options.mode == output::Mode::Inherit && (!options.console || !options.log_path.empty()))
+      return ExclusiveIO::error_f("The inherited output can't be logged: use pipe or pty.\n");
+    traced.setOutput(options);
+  }
+  auto mode = output::getModeName(options.mode);
+  ExclusiveIO::info_f("Output: %s%s%s%s\n", std::string(mode).c_str(),
+                      options.console ? "" : ", not shown", options.log_path.empty() ? "" : ", logged to ",
+                      options.log_path.c_str());
+  if (traced.hasStarted() && input.size() >= 2) ExclusiveIO::info_f("Applied from the next run.\n");
+}
+
+void inferiorsCommand(const DebugSession &session) {
+  std::string msg;
+  char row[PATH_MAX + 64];
+  for (const auto &[id, inferior]: session.getInferiors()) {
+    auto marker = id == session.getCurrentId() ? '*' : ' ';
+    const char *state = !inferior->hasStarted() ? "not started" : inferior->isDead() ? "exited"
+                                                                   : inferior->isRunning() ? "running" : "stopped";
+    snprintf(row, sizeof(row), "%c %d: pid %d, %s (%s)\n", marker, id, inferior->getPid(),
+             inferior->getPath().c_str(), state);
+    msg.append(row);
+  }
+  ExclusiveIO::info_nf("Inferiors:\n", msg);
+}
+
+void inferiorCommand(DebugSession &session, const std::vector<std::string> &input) {
+  if (input.size() < 2)
+    return show_usage_for("inferior <id>");
+  auto id = (int) strtol(input.at(1).c_str(), (char **) nullptr, 10);
+  if (!session.select(id))
+    return ExclusiveIO::error_f("Inferior %d is unknown.\n", id);
+  ExclusiveIO::info_f("Current inferior: %d (pid %d)\n", id, session.current().getPid());
+}
+
+void spawnCommand(DebugSession &session, std::vector<std::string> &input) {
+  std::vector<char *> params;
+  for (unsigned i = 1; i < input.size(); i++)
+    params.push_back(input.at(i).data());
+  session.spawn(params);
+}
+
 void restartCommand(TracedProgram &traced) {
   std::string validation_input;
   ExclusiveIO::info_f("Restart the program [Y/n]: ");
-  ExclusiveIO::input(validation_input);
+  validation_input = readAnswer(traced);
   if (validation_input == "y" || validation_input == "Y")
     restart(traced);
 }
@@ -392,6 +716,10 @@ void onIPStopped(const TracedProgram &traced) {
     ExclusiveIO::info_f("The program exited normally.\n");
   else if (traced.isTrappedAtBreakpoint()) {
     ExclusiveIO::info_f("The program hit a breakpoint.\n");
+  } else if (traced.isInterrupted()) {
+    ExclusiveIO::info_f("The program has been interrupted.\n");
+  } else if (traced.hasExeced()) {
+    ExclusiveIO::info_f("The program executed %s.\n", traced.getPath().c_str());
   } else if (traced.isSegfault()) {
     auto seg_data = traced.getSegfaultData();
     ExclusiveIO::info_f("The program has a segfault: %s (at 0x%016lX)\n", seg_data.first.c_str(), seg_data.second);
@@ -416,8 +744,9 @@ int main(int argc, char **argv) {
     }
   }
 
-  auto traced = TracedProgram(std::string(argv[1]));
-  command_loop(traced);
-  traced.stopTraced();
+  DebugSession session(argv[1]);
+  command_loop(session);
+  for (const auto &[id, inferior]: session.getInferiors())
+    if (inferior->hasStarted()) inferior->stopTraced();
   return 0;
 }
@@ -0,0 +1,73 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#ifndef C_BDD_BDD_DISASSEMBLER_HPP
+#define C_BDD_BDD_DISASSEMBLER_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "bdd_elf.hpp"
+
+namespace disasm {
+    constexpr unsigned max_instruction_length = 15;
+
+    /**
+     * One decoded x86-64 instruction, printed in AT&T syntax (as objdump does)
+     */
+    struct Instruction {
+        addr_t address = 0;
+        std::uint8_t length = 0;
+        std::array<std::uint8_t, max_instruction_length> bytes{};
+
+        // Prefixes included (ex: "lock addl", "rep stos")
+        std::string mnemonic;
+        std::string operands;
+
+        // Branch/call destination or RIP-relative memory address, when statically known
+        std::optional<addr_t> target;
+
+        // Offset of the disp32 in bytes for a RIP-relative memory operand, 0 otherwise (ex: to relocate the instruction)
+        std::uint8_t ripDisplacementOffset = 0;
+
+        [[nodiscard]] bool isValid() const { return mnemonic != "(bad)"; }
+    };
+
+    /**
+     * Decodes a single instruction
+     * @param code bytes to decode
+     * @param size number of readable bytes
+     * @param address address of the first byte, used for relative targets
+     * @return the instruction, "(bad)" with a length of 1 if the bytes can't be decoded
+     */
+    [[nodiscard]] Instruction decode(const std::uint8_t *code, std::size_t size, addr_t address);
+
+    /**
+     * Linear sweep decoding of a whole buffer
+     * @param code bytes to decode
+     * @param size number of readable bytes
+     * @param address address of the first byte
+     * @return every instruction, in order
+     */
+    [[nodiscard]] std::vector<Instruction> decodeAll(const std::uint8_t *code, std::size_t size, addr_t address);
+
+    /**
+     * @return the instruction as an objdump-like line: "address: bytes \t mnemonic operands"
+     */
+    [[nodiscard]] std::string formatInstruction(const Instruction &instruction);
+
+    /**
+     * @param condition low nibble of the jcc/setcc/cmovcc opcode (Intel manual, Jcc): o, no, b, ae, e, ne, be, a,
+     * s, ns, p, np, l, ge, le, g
+     * @param eflags flags register of the program
+     * @return whether the jump is taken
+     */
+    [[nodiscard]] bool conditionHolds(std::uint8_t condition, std::uint64_t eflags);
+
+} // namespace disasm
+
+#endif //C_BDD_BDD_DISASSEMBLER_HPP
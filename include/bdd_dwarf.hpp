@@ -0,0 +1,228 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#ifndef C_BDD_BDD_DWARF_HPP
+#define C_BDD_BDD_DWARF_HPP
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "bdd_elf.hpp"
+
+namespace dwarf {
+
+    /**
+     * One row of the DWARF line table
+     */
+    struct LineEntry {
+        addr_t address;
+        std::uint32_t file; // index in LineTable::getFiles()
+        std::uint32_t line;
+        std::uint16_t column;
+        bool isStatement;   // recommended breakpoint location
+        bool endSequence;   // first address after a contiguous sequence (no source)
+    };
+
+    /**
+     * Address <-> source line mapping, decoded from .debug_line (DWARF 2 to 5) on the first lookup,
+     * or read back from the index cache (see cache::load)
+     * @cite https://dwarfstd.org/doc/DWARF5.pdf (6.2 Line Number Information)
+     */
+    class LineTable {
+    private:
+        std::shared_ptr<const elf::ElfFile> elf_file;
+        mutable std::once_flag decoded;
+
+        // Full paths, shared by every compilation unit
+        mutable std::vector<std::string> files;
+        mutable std::unordered_map<std::string, std::uint32_t> filesByPath;
+
+        // Every row, sorted by address
+        mutable std::vector<LineEntry> entries;
+
+        // Statement rows indexes, sorted by (file, line, address)
+        mutable std::vector<std::uint32_t> entriesByLocation;
+
+        /**
+         * Decodes every line number program on the first call (thread-safe), later calls return at once
+         */
+        void decode() const;
+
+        /**
+         * @return false if there is no usable saved line table, nothing is then left filled
+         */
+        bool load() const;
+
+        void store() const;
+
+        /**
+         * Decodes one line number program (header + opcodes)
+         * @return the size of the unit, 0 if it can't be decoded
+         */
+        std::size_t decodeUnit(std::span<const std::uint8_t> unit, std::span<const std::uint8_t> lineStrings,
+                               std::span<const std::uint8_t> strings) const;
+
+        std::uint32_t addFile(const std::string &path) const;
+
+    public:
+        LineTable() = default;
+
+        /**
+         * Nothing is decoded yet, the file is kept until then
+         */
+        explicit LineTable(std::shared_ptr<const elf::ElfFile> elf_file) : elf_file(std::move(elf_file)) {}
+
+        [[nodiscard]] bool empty() const {
+          decode();
+          return entries.empty();
+        }
+
+        [[nodiscard]] const std::vector<std::string> &getFiles() const {
+          decode();
+          return files;
+        }
+
+        /**
+         * O(log n) address -> source lookup
+         * @param address Elf address (virtual memory address)
+         * @return the row covering the address, nullptr if there is no source for it
+         */
+        [[nodiscard]] const LineEntry *findByAddress(addr_t address) const;
+
+        /**
+         * O(log n) source -> address lookup. If the line has no code, the next line of the file that has some is used.
+         * @param file full path, path suffix (ex: "samples/stable_program.c") or file name
+         * @param line line number, starting at 1
+         * @return the statement row with the lowest address, nullptr if unknown
+         */
+        [[nodiscard]] const LineEntry *findByLocation(std::string_view file, std::uint32_t line) const;
+
+        /**
+         * @return "path/file.c:42" for the address, an empty string if unknown
+         */
+        [[nodiscard]] std::string getLocationString(addr_t address) const;
+    };
+
+    // DWARF numbers of the x86-64 registers recovered by the CFI: rax, rdx, rcx, rbx, rsi, rdi, rbp, rsp, r8-r15,
+    // then the return address
+    constexpr unsigned cfi_register_count = 17;
+
+    /**
+     * How the caller's value of a register is recovered (DWARF 5, 6.4.1)
+     */
+    struct RegisterRule {
+        enum class Kind : std::uint8_t {
+            Unspecified, // callee-saved ones: same value
+            Undefined,
+            SameValue,
+            Offset,      // saved at CFA + value
+            ValOffset,   // is CFA + value
+            Register,    // in the register number value
+            Expression,  // saved at the address the expression computes, the CFA pushed first
+            ValExpression
+        } kind = Kind::Unspecified;
+        std::int64_t value = 0;
+        std::span<const std::uint8_t> expression;
+    };
+
+    /**
+     * Unwinding rules at one address: how to compute the CFA (canonical frame address: the stack pointer before the
+     * call) and the registers of the caller
+     */
+    struct FrameRow {
+        unsigned cfaRegister = 7;
+        std::int64_t cfaOffset = 0;
+        std::span<const std::uint8_t> cfaExpression; // used instead when not empty
+        std::array<RegisterRule, cfi_register_count> registers{};
+        unsigned returnAddressRegister = 16;
+        bool signalFrame = false; // the return address is the interrupted instruction itself, not after a call
+    };
+
+    /**
+     * Call frame information of an Elf file, from .eh_frame & .debug_frame, indexed on the first lookup
+     * @cite https://dwarfstd.org/doc/DWARF5.pdf (6.4 Call Frame Information)
+     * @cite https://refspecs.linuxfoundation.org/LSB_5.0.0/LSB-Core-generic/LSB-Core-generic/ehframechpt.html
+     */
+    class FrameTable {
+    private:
+        std::shared_ptr<const elf::ElfFile> elf_file;
+        mutable std::once_flag indexed;
+
+        struct Cie {
+            std::uint64_t codeAlignment = 1;
+            std::int64_t dataAlignment = 1;
+            unsigned returnAddressRegister = 16;
+            std::uint8_t fdeEncoding = 0; // DW_EH_PE_* of the FDE addresses (.eh_frame only)
+            bool augmented = false;       // "z": the FDEs have augmentation data to skip
+            bool signalFrame = false;
+            std::span<const std::uint8_t> instructions;
+        };
+
+        struct Fde {
+            addr_t begin;
+            addr_t end;
+            std::uint32_t cie; // index in cies
+            std::span<const std::uint8_t> instructions;
+        };
+
+        mutable std::vector<Cie> cies;
+
+        // Sorted by begin address
+        mutable std::vector<Fde> fdes;
+
+        /**
+         * Indexes every FDE of .eh_frame & .debug_frame on the first call (thread-safe), later calls return at once
+         */
+        void index() const;
+
+        /**
+         * @param address Elf address of the section (.eh_frame pointers are relative to it)
+         * @param ehFrame .eh_frame layout, else .debug_frame's
+         */
+        void indexSection(std::span<const std::uint8_t> section, addr_t address, bool ehFrame) const;
+
+        /**
+         * Runs CFA instructions, up to the target address
+         * @param initial row of the CIE, for DW_CFA_restore (nullptr while running the CIE instructions)
+         * @return false on an unknown instruction
+         */
+        static bool execute(std::span<const std::uint8_t> instructions, const Cie &cie, addr_t location,
+                            addr_t target, FrameRow &row, const FrameRow *initial);
+
+    public:
+        FrameTable() = default;
+
+        explicit FrameTable(std::shared_ptr<const elf::ElfFile> elf_file) : elf_file(std::move(elf_file)) {}
+
+        /**
+         * O(log n) lookup of the FDE, then its instructions are run up to the address
+         * @param address Elf address
+         * @return false if no FDE covers the address, or its instructions can't be run
+         */
+        bool findRow(addr_t address, FrameRow &row) const;
+    };
+
+    /**
+     * Evaluates a DWARF expression of the CFI: constants, registers, stack operations, arithmetic, comparisons,
+     * branches & memory reads
+     * @param initial pushed first (the CFA for the register rules)
+     * @return nullopt on an unsupported operation, or a register or memory that can't be read
+     */
+    std::optional<std::uint64_t>
+    evaluate(std::span<const std::uint8_t> expression, std::optional<std::uint64_t> initial,
+             const std::function<std::optional<std::uint64_t>(unsigned)> &readRegister,
+             const std::function<std::optional<std::uint64_t>(addr_t)> &readMemory);
+
+} // namespace dwarf
+
+#endif //C_BDD_BDD_DWARF_HPP
@@ -8,7 +8,15 @@
 #include <cstdint>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include "elf.h"
+#include "bdd_index_cache.hpp"
 
 #if INTPTR_MAX == INT64_MAX // 64 BITS ARCHITECTURE
 #define ARCHITECTURE 64
@@ -16,13 +24,15 @@ using Elf_Ehdr = Elf64_Ehdr;
 using Elf_Phdr = Elf64_Phdr;
 using Elf_Shdr = Elf64_Shdr;
 using Elf_SymRef = Elf64_Sym;
+using Elf_Nhdr = Elf64_Nhdr;
 
 #elif INTPTR_MAX == INT32_MAX // 32 BITS ARCHITECTURE
 #define ARCHITECTURE 32
 using Elf_Ehdr = Elf32_Ehdr;
 using Elf_Phdr = Elf32_Phdr;
 using Elf_Shdr = Elf32_Shdr;
-using Elf_SymRef = Elf32_Sym
+using Elf_SymRef = Elf32_Sym;
+using Elf_Nhdr = Elf32_Nhdr;
 
 #endif
 
@@ -59,14 +69,133 @@ namespace elf {
         Elf_SymbolBindingWeak = 2
     } Elf_SymbolBinding;
 
-    [[nodiscard]] bool isElfFile(Elf_Ehdr &header);
+    [[nodiscard]] bool isElfFile(const Elf_Ehdr &header);
 
+    /**
+     * To call when showing a name only: the index keeps the names as in the file
+     * @return the C++ name of a mangled symbol (ex: "_ZN3foo3barEv" -> "foo::bar()"), the name itself otherwise
+     */
+    [[nodiscard]] std::string demangle(std::string_view name);
+
+    /**
+     * How the Elf file bytes are brought in memory
+     */
+    enum class LoadMode {
+        Mapped, // Read-only private mapping of the file, paged in on access (default)
+        Copied  // Heap copy of each range, read when first asked for
+    };
+
+    /**
+     * Read-only bytes of an Elf file, every header/section/symbol/string view points into them.
+     * Nothing but the file size is read at construction. Owned by its ElfFile, released with it.
+     */
+    class ElfStorage {
+    private:
+        const char *bytes = nullptr; // Mapped: the whole file
+        int fd = -1;                 // Copied: kept open for the reads
+        std::size_t length = 0;
+        std::int64_t modification = 0; // st_mtim, in nanoseconds
+        bool mapped = false;
+
+    public:
+        ElfStorage(const std::string &elf_filepath, LoadMode mode);
+
+        ElfStorage(const ElfStorage &) = delete;
+
+        ElfStorage &operator=(const ElfStorage &) = delete;
+
+        ~ElfStorage();
+
+        [[nodiscard]] std::size_t size() const { return length; }
+
+        [[nodiscard]] bool isMapped() const { return mapped; }
+
+        [[nodiscard]] std::int64_t getModificationTime() const { return modification; }
+
+        /**
+         * @param buffer receives the bytes when they are not mapped, must outlive the result
+         * @return the bytes [offset, offset + size) of the file, nullptr if out of it or unreadable
+         */
+        [[nodiscard]] const char *load(std::size_t offset, std::size_t size, std::vector<char> &buffer) const;
+
+        /**
+         * Asks the kernel to read [offset, offset + size) ahead (madvise / posix_fadvise), without waiting
+         */
+        void willNeed(std::size_t offset, std::size_t size) const;
+    };
+
+    /**
+     * Function symbol of the index, the name is a view into the Elf string table
+     */
+    struct Symbol {
+        addr_t address;
+        addr_t size;
+        std::string_view name;
+    };
+
+    /**
+     * Parsed Elf file, immutable once built: shared as std::shared_ptr<const ElfFile> by the programs & threads
+     * using it (see ElfRegistry), never copied. Accessors return views into the file bytes.
+     * Only the headers are read at construction: each section is materialized on its first access,
+     * the symbol index on the first lookup (or ahead of time, see prefetch).
+     */
     class ElfFile {
     private:
+        std::unique_ptr<const ElfStorage> storage;
         Elf_Ehdr header{};
-        std::vector<Elf_Phdr> programHeaders;
-        std::vector<Elf_Shdr> sectionsHeaders;
-        std::vector<std::vector<char>> sectionsData;
+        std::vector<char> programHeadersBytes;  // Copied mode only
+        std::vector<char> sectionsHeadersBytes; // Copied mode only
+        std::span<const Elf_Phdr> programHeaders;
+        std::span<const Elf_Shdr> sectionsHeaders;
+
+        // Bytes of each section, by section index, loaded once
+        struct SectionData {
+            std::once_flag loaded;
+            const char *data = nullptr;
+            std::vector<char> owned;
+        };
+        std::unique_ptr<SectionData[]> sections;
+
+        // Names of the saved indexes (see cache::load), empty: not saved
+        std::string indexKey;
+
+        mutable std::once_flag symbolIndexBuilt;
+
+        // Saved symbol index the names point into, when it was loaded from the cache
+        mutable std::shared_ptr<const cache::MappedFile> cachedSymbols;
+
+        // Function symbols of every .symtab & .dynsym, sorted by address
+        mutable std::vector<Symbol> functionSymbols;
+
+        // Function name -> index in functionSymbols
+        mutable std::unordered_map<std::string_view, std::size_t> functionSymbolsByName;
+
+        mutable std::mutex prefetchMutex;
+
+        // Last member: stopped & joined before anything they use is destroyed
+        mutable std::vector<std::jthread> prefetchers;
+
+        /**
+         * Builds functionSymbols & functionSymbolsByName, from the cache if saved, saved in it otherwise
+         */
+        void buildSymbolIndex() const;
+
+        /**
+         * Decodes functionSymbols from .symtab & .dynsym
+         */
+        void decodeSymbols() const;
+
+        /**
+         * @return false if there is no usable saved symbol index, functionSymbols is then left empty
+         */
+        bool loadSymbols() const;
+
+        void storeSymbols() const;
+
+        /**
+         * Builds the symbol index on the first call (thread-safe), later calls return at once
+         */
+        void ensureSymbolIndex() const;
 
 
         /**
@@ -75,12 +204,15 @@ namespace elf {
         */
         [[maybe_unused]] [[nodiscard]] static std::string getSectionTypeAsString(const Elf_Shdr &sHeader);
 
-        [[maybe_unused]] [[nodiscard]] std::string
+        /**
+         * @return a pointer into the string table data, "Unnamed" if out of bounds
+         */
+        [[maybe_unused]] [[nodiscard]] const char *
         getNameFromStringTable(unsigned int strTableIndex, unsigned int offset) const;
 
-        [[maybe_unused]] [[nodiscard]] std::string getSymbolName(const Elf_Shdr &sHeader, const Elf_SymRef &sym) const;
+        [[maybe_unused]] [[nodiscard]] const char *getSymbolName(const Elf_Shdr &sHeader, const Elf_SymRef &sym) const;
 
-        [[maybe_unused]] [[nodiscard]] std::string getSectionName(const Elf_Shdr &sHeader) const;
+        [[maybe_unused]] [[nodiscard]] const char *getSectionName(const Elf_Shdr &sHeader) const;
 
         [[maybe_unused]] [[nodiscard]] std::vector<unsigned int>
         getSectionHeaderIndexesByType(Elf_SectionType type) const;
@@ -93,43 +225,142 @@ namespace elf {
 
         [[maybe_unused]] [[nodiscard]] static std::string getSymbolBindingAsString(const Elf_SymRef &sym);
 
+        /**
+         * @return a pointer into the loaded file, nullptr if the section has no data in the file
+         */
         [[maybe_unused]] [[nodiscard]] const char *getSectionDataPtrAt(unsigned index) const;
 
         static unsigned getSymbolCount(const Elf_Shdr &sHdr);
 
     public:
-        explicit ElfFile(const std::string &eachStrTable);
+        explicit ElfFile(const std::string &elf_filepath, LoadMode mode = LoadMode::Mapped);
 
         ElfFile() = default;
 
         ~ElfFile() = default;
 
+        ElfFile(const ElfFile &) = delete;
+
+        ElfFile &operator=(const ElfFile &) = delete;
+
         [[maybe_unused]] void printHeader(FILE *fp = stdout) const;
 
         [[maybe_unused]] void printProgramHeaders(FILE *fp = stdout) const;
 
         [[maybe_unused]] void printProgramHeaderAt(int index, FILE *fp = stdout) const;
 
-        [[maybe_unused]] void printSectionsHeaders(FILE *fp = stdout);
+        [[maybe_unused]] void printSectionsHeaders(FILE *fp = stdout) const;
 
         [[maybe_unused]] void printSectionHeaderAt(int index, FILE *fp = stdout) const;
 
-        [[maybe_unused]] void printSymbolEntries(FILE *fp = stdout);
+        [[maybe_unused]] void printSymbolEntries(FILE *fp = stdout) const;
+
+        [[maybe_unused]] void
+        printSymbolEntry(unsigned index, const Elf_SymRef &sym, const Elf_Shdr &sHdr, FILE *fp) const;
+
+        /**
+         * @return the Elf address of the function, 0 if unknown
+         */
+        [[maybe_unused]] [[nodiscard]] addr_t getFunctionAddress(std::string_view fct_name) const;
 
-        [[maybe_unused]] void printSymbolEntry(unsigned index, const Elf_SymRef &sym, const Elf_Shdr &sHdr, FILE *fp);
+        /**
+         * O(1) name -> function lookup
+         * @return the function symbol, nullptr if unknown
+         */
+        [[nodiscard]] const Symbol *findFunctionByName(std::string_view fct_name) const;
 
-        [[maybe_unused]] [[nodiscard]] addr_t getFunctionAddress(const std::string &fct_name) const;
+        /**
+         * O(log n) address -> function lookup
+         * @param address Elf address (virtual memory address)
+         * @return the function containing the address, nullptr if none
+         */
+        [[nodiscard]] const Symbol *findFunctionByAddress(addr_t address) const;
+
+        /**
+         * @return every function symbol, sorted by address
+         */
+        [[nodiscard]] const std::vector<Symbol> &getFunctionSymbols() const {
+          ensureSymbolIndex();
+          return functionSymbols;
+        }
+
+        /**
+         * Loads sections & the symbol index in a background thread, for the first accesses not to wait on them
+         * @param names sections to load (ex: ".debug_line"), the missing ones are ignored
+         * @param symbolIndex also builds the symbol index (loading .symtab, .dynsym & their string tables)
+         */
+        void prefetch(const std::vector<std::string> &names, bool symbolIndex = true) const;
 
         [[nodiscard]] Elf_SymRef getSymbolSectionAt(unsigned int index, unsigned offset) const;
 
+        /**
+         * @return an owned copy of the section bytes (empty if the section has no data in the file)
+         */
+        [[nodiscard]] std::vector<char> copySectionDataAt(unsigned index) const;
+
+        /**
+         * @param address Elf address (virtual memory address)
+         * @return the file bytes from the address to the end of its executable section, empty if none
+         */
+        [[nodiscard]] std::span<const std::uint8_t> getCodeAt(addr_t address) const;
+
+        /**
+         * @param name section name (ex: ".debug_line")
+         * @return the file bytes of the section, empty if missing, without data or compressed
+         */
+        [[nodiscard]] std::span<const std::uint8_t> getSectionData(std::string_view name) const;
+
+        /**
+         * @param name section name (ex: ".eh_frame")
+         * @return the Elf address the section is loaded at, 0 if missing or not loaded
+         */
+        [[nodiscard]] addr_t getSectionAddress(std::string_view name) const;
+
+        /**
+         * @return the Elf address of the first loaded segment, page aligned: mapped at offset 0 of the file
+         */
+        [[nodiscard]] addr_t getLoadAddress() const;
+
         [[nodiscard]] std::vector<std::pair<addr_t, std::string>> getFunctionsList() const;
 
+        /**
+         * @return the NT_GNU_BUILD_ID note as hexadecimal (ex: "4c2a9d..."), empty if the file has none
+         */
+        [[nodiscard]] std::string getBuildId() const;
+
+        /**
+         * Identifies the binary for the index cache: its build-id with the sizes of .symtab & .debug_line (kept
+         * apart from its stripped copies, which have the same build-id), else its path, size & modification time
+         * @return empty for a file not loaded from a path
+         */
+        [[nodiscard]] const std::string &getIndexKey() const { return indexKey; }
+
         /**
          * Find every Elf section's type & name, both as strings
          */
         [[nodiscard]] std::vector<std::pair<std::string, std::string>> getSymbolsNames() const;
     };
 
+    /**
+     * Parsed Elf files by canonical path: the programs of a session running the same binary share one ElfFile.
+     * A file no program uses anymore is released. Thread-safe.
+     */
+    class ElfRegistry {
+    private:
+        std::mutex mutex;
+        std::map<std::string, std::weak_ptr<const ElfFile>> files;
+
+    public:
+        /**
+         * @param prefetched sections loaded in the background once the file is parsed, with the symbol index
+         * (nothing if empty, see ElfFile::prefetch)
+         * @return the ElfFile of the path, parsed on the first call only
+         * @throws std::invalid_argument if the file can't be loaded
+         */
+        std::shared_ptr<const ElfFile>
+        get(const std::string &elf_filepath, const std::vector<std::string> &prefetched = {});
+    };
+
 
 } // namespace elf
 
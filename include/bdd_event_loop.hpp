@@ -0,0 +1,124 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#ifndef C_BDD_BDD_EVENT_LOOP_HPP
+#define C_BDD_BDD_EVENT_LOOP_HPP
+
+#include <chrono>
+#include <csignal>
+#include <deque>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <sys/types.h>
+
+/**
+ * Reactor of the debugger: a single epoll instance sleeps on
+ *  - a signalfd of SIGCHLD (blocked for the whole process): any tracee state change, reaped with waitpid(WNOHANG),
+ *  - stdin: the lines typed while the program runs are queued, for the command loop or to interrupt it,
+ *  - a timerfd: deadline of the current wait,
+ *  - the other file descriptors watched (ex: the captured output of the program), handled within the wait.
+ * The children are reaped here for every program of the session, each one then takes the state changes of its own
+ * threads.
+ */
+class EventLoop {
+public:
+    using clock = std::chrono::steady_clock; // CLOCK_MONOTONIC, as the timerfd
+
+    enum class Event {
+        Child,   // SIGCHLD received: waitpid(WNOHANG) has something
+        Input,   // at least one more complete line has been queued, or stdin has been closed
+        Timeout, // the deadline has passed
+        Error
+    };
+
+private:
+    int epoll_fd = -1;
+    int signal_fd = -1;
+    int timer_fd = -1;
+
+    // Signal mask before SIGCHLD was blocked, restored in the traced-program before exec
+    sigset_t previous_mask{};
+
+    // False when stdin can't be polled (ex: a regular file): it is then read only when a line is asked for
+    bool input_watched = false;
+    bool input_armed = false; // in the epoll events, left so between the waits needing it
+    bool input_closed = false;
+    std::string input_buffer;
+    std::deque<std::string> lines;
+
+    // Handlers of the watched file descriptors, called from wait() when readable
+    std::map<int, std::function<void()>> watched;
+
+    // Reaped state changes (TID, waitpid status), oldest first, until the program owning the thread takes them
+    std::deque<std::pair<pid_t, int>> reaped;
+
+    /**
+     * One read of stdin (it is readable, or blocking is fine), split into the queued lines
+     */
+    void readInput();
+
+    /**
+     * Adds/removes EPOLLIN for stdin, only when it changes (a trace waits thousands of times per second)
+     */
+    void setInputArmed(bool armed);
+
+public:
+    EventLoop();
+
+    ~EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    /**
+     * Sleeps until something happens
+     * @param deadline nullopt: no time limit
+     * @param input also wake up when a line is typed (the lines queued before don't count)
+     */
+    Event wait(std::optional<clock::time_point> deadline = std::nullopt, bool input = true);
+
+    /**
+     * Calls the handler whenever the file descriptor is readable or hung up, from inside the waits: they don't
+     * return for it
+     */
+    void watch(int fd, std::function<void()> readable);
+
+    /**
+     * Stops watching a file descriptor (may be called from its own handler), before closing it
+     */
+    void unwatch(int fd);
+
+    /**
+     * Reaps every child state change at hand (waitpid(-1, __WALL | WNOHANG)), without sleeping
+     */
+    void reapChildren();
+
+    /**
+     * @param owns whether a TID belongs to the caller
+     * @return the oldest reaped state change of one of its threads
+     */
+    std::optional<std::pair<pid_t, int>> takeStatus(const std::function<bool(pid_t)> &owns);
+
+    /**
+     * Removes the first queued line equal to the word, if any
+     * @return whether it was there
+     */
+    bool takeLine(const std::string &word);
+
+    /**
+     * @return the first queued line, or the next typed one (sleeps until then), nullopt once stdin is closed
+     */
+    std::optional<std::string> nextLine();
+
+    /**
+     * Restores the signal mask the process had, to call in the child before exec
+     */
+    void restoreSignalMask() const;
+};
+
+#endif //C_BDD_BDD_EVENT_LOOP_HPP
@@ -9,13 +9,21 @@
 
 #pragma GCC diagnostic ignored "-Wformat-security"
 
-#define EXCLUSIVE_IO_MMAP_NAME "/tmp/mmap_bdd_stdoutmutex"
-
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <pthread.h>
 #include <iomanip>
 #include <iostream>
 #include <execution>
+#include <sstream>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <fmt/compile.h>
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <fmt/printf.h>
@@ -24,6 +32,170 @@ typedef struct synchronisation_mutex {
     pthread_mutex_t print_mutex;
 } synchronisation_mutex_t;
 
+namespace exclusive_io {
+    /**
+     * FMT_COMPILE(...) strings: the only fmt internal relied upon, an fmt upgrade breaks this line alone
+     */
+    template<typename T>
+    struct is_compiled : std::is_base_of<fmt::detail::compiled_string, T> {};
+
+    template<typename T>
+    inline constexpr bool is_compiled_v = is_compiled<T>::value;
+
+    /**
+     * Binary encoding of a print argument in an asynchronous record (see ExclusiveIO): numbers, enums & pointers
+     * are kept as is, formatted by the drain thread later on
+     */
+    template<typename T>
+    struct Encoded {
+        static_assert(std::is_trivially_copyable_v<T>, "ExclusiveIO: only C types can be formatted");
+
+        static std::size_t size(const T &) { return sizeof(T); }
+
+        static char *write(char *to, const T &value) {
+          std::memcpy(to, &value, sizeof(T));
+          return to + sizeof(T);
+        }
+
+        static T read(const char *&from) {
+          T value;
+          std::memcpy(&value, from, sizeof(T));
+          from += sizeof(T);
+          return value;
+        }
+    };
+
+    /**
+     * Strings are copied: they seldom outlive the call (ex: a std::string::c_str())
+     */
+    template<>
+    struct Encoded<std::string_view> {
+        static constexpr std::uint32_t null = UINT32_MAX;
+
+        static std::size_t size(std::string_view value) { return sizeof(std::uint32_t) + value.size() + 1; }
+
+        static char *write(char *to, std::string_view value, bool isNull = false) {
+          std::uint32_t length = isNull ? null : value.size();
+          std::memcpy(to, &length, sizeof(length));
+          to += sizeof(length);
+          std::memcpy(to, value.data(), value.size());
+          to[value.size()] = '\0';
+          return to + value.size() + 1;
+        }
+
+        /**
+         * @return the null-terminated copy, in the record
+         */
+        static const char *read(const char *&from) {
+          std::uint32_t length;
+          std::memcpy(&length, from, sizeof(length));
+          from += sizeof(length);
+          if (length == null) {
+            from += 1;
+            return nullptr;
+          }
+          auto value = from;
+          from += length + 1;
+          return value;
+        }
+    };
+
+    /**
+     * Only the bytes a precision lets print are read ("%.*s", "%.8s"): the string may not be null-terminated
+     */
+    template<>
+    struct Encoded<const char *> {
+        static std::string_view view(const char *value, std::size_t limit) {
+          return value != nullptr ? std::string_view(value, strnlen(value, limit)) : "";
+        }
+
+        static std::size_t size(const char *value, std::size_t limit = SIZE_MAX) {
+          return Encoded<std::string_view>::size(view(value, limit));
+        }
+
+        static char *write(char *to, const char *value, std::size_t limit = SIZE_MAX) {
+          return Encoded<std::string_view>::write(to, view(value, limit), value == nullptr);
+        }
+
+        static const char *read(const char *&from) { return Encoded<std::string_view>::read(from); }
+    };
+
+    template<>
+    struct Encoded<char *> : Encoded<const char *> {
+        static char *read(const char *&from) { return const_cast<char *>(Encoded<const char *>::read(from)); }
+    };
+
+    // fmt arguments only: rebuilt from the copy by the drain thread
+    template<>
+    struct Encoded<std::string> : Encoded<std::string_view> {
+    };
+
+    template<typename T>
+    constexpr bool is_c_string = std::is_same_v<T, const char *> || std::is_same_v<T, char *>;
+
+    /**
+     * Encoded size of a print argument
+     * @param limit precision of a string argument (see stringLimits), ignored for the others
+     */
+    template<typename T>
+    std::size_t encodedSize(const T &value, std::size_t limit) {
+      if constexpr (is_c_string<T>) return Encoded<T>::size(value, limit);
+      else return Encoded<T>::size(value);
+    }
+
+    template<typename T>
+    char *encode(char *to, const T &value, std::size_t limit) {
+      if constexpr (is_c_string<T>) return Encoded<T>::write(to, value, limit);
+      else return Encoded<T>::write(to, value);
+    }
+
+    /**
+     * @return the precision of each string argument of a printf format ("%.8s", "%.*s"), SIZE_MAX for the other
+     * arguments & the strings printed whole
+     */
+    template<typename... Args>
+    std::array<std::size_t, sizeof...(Args)> stringLimits(std::string_view format, const Args &... args) {
+      std::array<std::size_t, sizeof...(Args)> limits;
+      limits.fill(SIZE_MAX);
+      if constexpr ((is_c_string<Args> || ...)) {
+        // Values of the integer arguments, for the "*" precisions
+        std::array<long long, sizeof...(Args)> integers{[](const auto &value) -> long long {
+            if constexpr (std::is_integral_v<std::decay_t<decltype(value)>>) return value;
+            else return 0;
+        }(args)...};
+        auto isDigit = [](char c) { return c >= '0' && c <= '9'; };
+        std::size_t argument = 0;
+        for (std::size_t i = 0; i < format.size() && argument < sizeof...(Args); i++) {
+          if (format[i] != '%' || ++i >= format.size() || format[i] == '%') continue;
+          while (i < format.size() && std::string_view("-+ #0").find(format[i]) != std::string_view::npos) i++;
+          if (i < format.size() && format[i] == '*') argument++, i++;
+          while (i < format.size() && isDigit(format[i])) i++;
+          long long precision = -1;
+          if (i < format.size() && format[i] == '.') {
+            if (++i < format.size() && format[i] == '*') {
+              precision = argument < sizeof...(Args) ? integers[argument] : -1;
+              argument++, i++;
+            } else {
+              for (precision = 0; i < format.size() && isDigit(format[i]); i++)
+                precision = precision * 10 + format[i] - '0';
+            }
+          }
+          while (i < format.size() && std::string_view("hljztL").find(format[i]) != std::string_view::npos) i++;
+          if (i >= format.size() || argument >= sizeof...(Args)) break;
+          if (format[i] == 's' && precision >= 0) limits[argument] = precision;
+          argument++;
+        }
+      }
+      return limits;
+    }
+
+    /**
+     * Whether an argument can be deferred to the drain thread, formatted there
+     */
+    template<typename T>
+    constexpr bool encodable = std::is_trivially_copyable_v<T> || std::is_same_v<T, std::string>;
+} // namespace exclusive_io
+
 class ExclusiveIO {
 private:
 
@@ -37,59 +209,241 @@ private:
         FG_BRIGHT_CYAN = 96, FG_CYAN = 36,
         FG_BRIGHT_WHITE = 97, FG_WHITE = 37, FG_GRAY = 90,
         FG_DEFAULT = 39,
+        FG_NONE = 0, // relayed text: written as is, without prefix
     } color_t;
 
     inline static pid_t parent_pid;
-    inline static synchronisation_mutex_t *synchronisation_map;
+    // getpid() == parent_pid, kept up to date on fork (see initialize): a system call for every print otherwise
+    inline static bool is_parent = false;
+    // Anonymous & shared with the forked children (see initialize), one per debugger
+    inline static synchronisation_mutex_t *synchronisation_map = nullptr;
+
+    // Forked child: its prints go to this pipe, relayed by the parent (see redirect)
+    inline static int redirect_fd = -1;
+
+    /**
+     * Asynchronous path, in the debugger process once initialized: each thread appends binary records (format
+     * string & arguments, not formatted) to its own lock-free single-producer ring, a drain thread formats & writes
+     * them in batches, in the order they were logged.
+     * The child (forked, before its exec) and the records too large for a ring take the synchronous path.
+     */
+    inline static std::atomic<bool> asynchronous{false};
+
+    using RenderFunction = void (*)(const char *payload, std::string &out);
 
 
     static bool isParent() {
-      return getpid() == parent_pid;
+      return is_parent;
     }
 
 
+    /**
+     * printf-like formatting of the _f prints (compatibility with the C format strings), appended to the text
+     * in place: no intermediate string
+     */
     template<typename... Args>
-    static std::string formatArgs(const std::string_view &rt_fmt_str, Args &&... args) {
-      // Using C formatting instead of LibFMT.
-      std::string buffer;
-      buffer.resize(rt_fmt_str.length() + 132);
-      auto size = std::sprintf(buffer.data(), rt_fmt_str.data(), args...);
-      buffer.resize(size);
-      return buffer;
+    static void appendFormatted(std::string &out, const char *format, const Args &... args) {
+      constexpr int first_pass_size = 256; // most lines fit: a single pass
+      auto start = out.size();
+      out.resize(start + first_pass_size);
+      auto size = std::snprintf(out.data() + start, first_pass_size + 1, format, args...);
+      if (size < 0) size = 0;
+      if (size > first_pass_size) { // Long arguments: second pass at the right size
+        out.resize(start + size);
+        std::snprintf(out.data() + start, size + 1, format, args...);
+      }
+      out.resize(start + size);
+    }
+
+    /**
+     * Drain thread side of a record: decodes the arguments, appends the formatted text
+     */
+    template<typename... Args>
+    static void renderFormatted(const char *payload, std::string &out) {
+      auto format = exclusive_io::Encoded<std::string_view>::read(payload);
+      // Braced initialization: the arguments are decoded in order
+      std::tuple<Args...> values{exclusive_io::Encoded<Args>::read(payload)...};
+      std::apply([&out, format](const auto &... values) { appendFormatted(out, format, values...); }, values);
+    }
+
+    /**
+     * Drain thread side of a fmt record: FMT_COMPILE strings are types, the record only holds the arguments
+     */
+    template<typename Format, typename... Args>
+    static void renderFmt(const char *payload, std::string &out) {
+      const char *format = nullptr;
+      if constexpr (!exclusive_io::is_compiled_v<Format>)
+        format = exclusive_io::Encoded<std::string_view>::read(payload);
+      std::tuple<Args...> values{exclusive_io::Encoded<Args>::read(payload)...};
+      std::apply([&out, format](const auto &... values) {
+          if constexpr (exclusive_io::is_compiled_v<Format>)
+            fmt::format_to(std::back_inserter(out), Format{}, values...);
+          else
+            fmt::vformat_to(std::back_inserter(out), fmt::string_view(format), fmt::make_format_args(values...));
+      }, values);
+    }
+
+    static void renderText(const char *payload, std::string &out) {
+      out.append(exclusive_io::Encoded<std::string_view>::read(payload));
+    }
+
+    /**
+     * @return where to encode a payload of this size in the ring of the calling thread (waits for room),
+     * nullptr if it takes the synchronous path
+     */
+    static char *reserveRecord(std::size_t payload_size);
+
+    /**
+     * Publishes the record reserved last by the calling thread to the drain thread
+     */
+    static void commitRecord(RenderFunction render, color_t color, bool error);
+
+    /**
+     * Prints text formatted by the caller, deferred on the asynchronous path
+     */
+    static void printText(std::ostream &out, ExclusiveIO::color_t color, std::string_view text) {
+      if (redirect_fd >= 0) return writeRedirected(color, text);
+      if (asynchronous.load(std::memory_order_relaxed)) {
+        if (auto payload = reserveRecord(exclusive_io::Encoded<std::string_view>::size(text))) {
+          exclusive_io::Encoded<std::string_view>::write(payload, text);
+          return commitRecord(&renderText, color, &out == &std::cerr);
+        }
+      }
+      lockPrint();
+      if (color == color_t::FG_NONE)
+        out << text << std::flush;
+      else
+        out << "\033[" << color << "m" << (isParent() ? "[BDD]: " : "[Child]: ") << text << "\033[0m" << std::flush;
+      unlockPrint();
+    }
+
+    /**
+     * Forked child side of redirect: the whole line in one write()
+     */
+    static void writeRedirected(ExclusiveIO::color_t color, std::string_view text);
+
+    /**
+     * fmt path: deferred to the drain thread as the _f prints when the arguments can be copied, else formatted on
+     * the calling thread, into a buffer its next prints reuse (no allocation once grown)
+     * @param format FMT_COMPILE(...) string (parsed at compile time), or a format string checked at compile time
+     */
+    template<typename Format, typename... Args>
+    static void genericFmtPrint(std::ostream &out, ExclusiveIO::color_t color, const Format &format, Args &&... args) {
+      constexpr bool compiled = exclusive_io::is_compiled_v<Format>;
+      if constexpr ((exclusive_io::encodable<std::decay_t<Args>> && ...) &&
+                    (!compiled || std::is_default_constructible_v<Format>)) {
+        if (asynchronous.load(std::memory_order_relaxed)) {
+          std::size_t size = (exclusive_io::Encoded<std::decay_t<Args>>::size(args) + ... + 0);
+          std::string_view view;
+          if constexpr (!compiled) {
+            fmt::string_view format_view(format);
+            view = {format_view.data(), format_view.size()};
+            size += exclusive_io::Encoded<std::string_view>::size(view);
+          }
+          if (auto payload = reserveRecord(size)) {
+            if constexpr (!compiled) payload = exclusive_io::Encoded<std::string_view>::write(payload, view);
+            ((payload = exclusive_io::Encoded<std::decay_t<Args>>::write(payload, args)), ...);
+            return commitRecord(&renderFmt<Format, std::decay_t<Args>...>, color, &out == &std::cerr);
+          }
+        }
+      }
+      thread_local fmt::memory_buffer text;
+      text.clear();
+      if constexpr (compiled)
+        fmt::format_to(fmt::appender(text), format, std::forward<Args>(args)...);
+      else
+        fmt::vformat_to(fmt::appender(text), fmt::string_view(format), fmt::make_format_args(args...));
+      printText(out, color, {text.data(), text.size()});
     }
 
     template<typename... Args>
     static void
     genericFormatPrint(std::ostream &out, ExclusiveIO::color_t color, const std::string_view &rt_fmt_str,
                        Args &&... args) {
-      lockPrint();
-      out << "\033[" << color << "m" << (isParent() ? "[BDD]: " : "[Child]: ")
-          << formatArgs(rt_fmt_str, args...) << "\033[0m" << std::flush;
-      unlockPrint();
+      if (asynchronous.load(std::memory_order_relaxed)) {
+        [[maybe_unused]] auto limits = exclusive_io::stringLimits<std::decay_t<Args>...>(rt_fmt_str, args...);
+        auto size = exclusive_io::Encoded<std::string_view>::size(rt_fmt_str);
+        std::size_t index = 0;
+        ((size += exclusive_io::encodedSize<std::decay_t<Args>>(args, limits[index++])), ...);
+        if (auto payload = reserveRecord(size)) {
+          payload = exclusive_io::Encoded<std::string_view>::write(payload, rt_fmt_str);
+          index = 0;
+          ((payload = exclusive_io::encode<std::decay_t<Args>>(payload, args, limits[index++])), ...);
+          return commitRecord(&renderFormatted<std::decay_t<Args>...>, color, &out == &std::cerr);
+        }
+      }
+      thread_local std::string text;
+      text.clear();
+      appendFormatted(text, rt_fmt_str.data(), args...);
+      printText(out, color, text);
     }
 
     template<typename... Args>
     inline static void
     genericNotFormatPrint(std::ostream &out, ExclusiveIO::color_t color, Args &&... args) {
-      lockPrint();
-      out << "\033[" << color << "m" << (isParent() ? "[BDD]: " : "[Child]: ");
-      ((out << args), ...);
-      out << "\033[0m" << std::flush;
-      unlockPrint();
+      // Streamed types can't be encoded: rendered here, only the write is deferred
+      std::ostringstream text;
+      ((text << args), ...);
+      printText(out, color, text.view());
     }
 
     static void mmapExclusionStructure();
 
+    /**
+     * Drain thread: formats & writes the records of every ring, until terminate()
+     */
+    static void drain();
+
 public:
     static void initialize(pid_t parentPid);
 
     static void terminate();
 
+    /**
+     * Returns once everything logged before by any thread has been written, to call before waiting for the user or
+     * writing to stdout directly
+     */
+    static void flush();
+
+    /**
+     * From the forked child, before its exec: the prints go to the pipe instead of the terminal, they are written
+     * by the parent (see relay)
+     * @param fd write end of the pipe, closed on exec
+     */
+    static void redirect(int fd) {
+      asynchronous.store(false);
+      redirect_fd = fd;
+    }
+
+    /**
+     * Writes the output of a redirected child as is, in order with the other prints
+     */
+    static void relay(std::string_view text) {
+      printText(std::cout, color_t::FG_NONE, text);
+    }
+
+    /**
+     * Writes to stdout without going through the prints (ex: the spliced output of the program), after
+     * everything logged before & under the print lock
+     */
+    template<typename Write>
+    static void writeDirect(Write &&write) {
+      flush();
+      lockPrint();
+      std::cout << std::flush;
+      write();
+      unlockPrint();
+    }
+
     static void lockPrint() {
-      pthread_mutex_lock(&synchronisation_map->print_mutex);
+      if (synchronisation_map == nullptr) return;
+      // Robust: a child that died or exec'd holding it leaves it consistent for the next owner
+      if (pthread_mutex_lock(&synchronisation_map->print_mutex) == EOWNERDEAD)
+        pthread_mutex_consistent(&synchronisation_map->print_mutex);
     }
 
     static void unlockPrint() {
+      if (synchronisation_map == nullptr) return;
       pthread_mutex_unlock(&synchronisation_map->print_mutex);
     }
 
@@ -127,6 +481,61 @@ public:
 
 #pragma endregion
 
+#pragma region fmt print
+
+    /*
+     * fmt format strings (ex: "[0x{:016X}]: {}\n"), checked at compile time. FMT_COMPILE("...") strings are also
+     * parsed at compile time: to prefer in the hot paths.
+     */
+
+    template<typename... Args>
+    static void info_fmt(fmt::format_string<Args...> format, Args &&... args) {
+      ExclusiveIO::genericFmtPrint(std::cout, isParent() ? color_t::FG_BLUE : color_t::FG_GREEN, format,
+                                   std::forward<Args>(args)...);
+    }
+
+    template<typename Format, typename... Args> requires exclusive_io::is_compiled_v<Format>
+    static void info_fmt(const Format &format, Args &&... args) {
+      ExclusiveIO::genericFmtPrint(std::cout, isParent() ? color_t::FG_BLUE : color_t::FG_GREEN, format,
+                                   std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    static void error_fmt(fmt::format_string<Args...> format, Args &&... args) {
+      ExclusiveIO::genericFmtPrint(std::cerr, color_t::FG_RED, format, std::forward<Args>(args)...);
+    }
+
+    template<typename Format, typename... Args> requires exclusive_io::is_compiled_v<Format>
+    static void error_fmt(const Format &format, Args &&... args) {
+      ExclusiveIO::genericFmtPrint(std::cerr, color_t::FG_RED, format, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    static void hint_fmt(fmt::format_string<Args...> format, Args &&... args) {
+      ExclusiveIO::genericFmtPrint(std::cout, color_t::FG_CYAN, format, std::forward<Args>(args)...);
+    }
+
+    template<typename Format, typename... Args> requires exclusive_io::is_compiled_v<Format>
+    static void hint_fmt(const Format &format, Args &&... args) {
+      ExclusiveIO::genericFmtPrint(std::cout, color_t::FG_CYAN, format, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    static void debug_fmt(fmt::format_string<Args...> format, Args &&... args) {
+#if DEBUG
+      ExclusiveIO::genericFmtPrint(std::cout, color_t::FG_GRAY, format, std::forward<Args>(args)...);
+#endif
+    }
+
+    template<typename Format, typename... Args> requires exclusive_io::is_compiled_v<Format>
+    static void debug_fmt(const Format &format, Args &&... args) {
+#if DEBUG
+      ExclusiveIO::genericFmtPrint(std::cout, color_t::FG_GRAY, format, std::forward<Args>(args)...);
+#endif
+    }
+
+#pragma endregion
+
 #pragma region Unformatted print
 
     template<typename... Args>
@@ -170,6 +579,7 @@ public:
 
     template<typename T>
     static void input(T &buf) {
+      flush();
       lockPrint();
       std::cin >> buf;
       unlockPrint();
@@ -0,0 +1,141 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#ifndef C_BDD_BDD_INDEX_CACHE_HPP
+#define C_BDD_BDD_INDEX_CACHE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Indexes built from an Elf file (symbols, line table), saved on disk for the next sessions on the same binary.
+ * One file per binary & kind of index: $XDG_CACHE_HOME/c_bdd/<key>.<kind> ($HOME/.cache when unset), where the key
+ * is the GNU build-id of the binary & the sizes of its .symtab & .debug_line (see elf::ElfFile::getIndexKey).
+ * The files are mapped read-only: the indexes keep views into them instead of copies.
+ * Setting C_BDD_NO_INDEX_CACHE disables the cache.
+ */
+namespace cache {
+
+    /**
+     * Read-only mapping of a whole cache file, released with it
+     */
+    class MappedFile {
+    private:
+        const char *bytes = nullptr;
+        std::size_t length = 0;
+
+    public:
+        /**
+         * @throws std::invalid_argument if the file can't be mapped
+         */
+        explicit MappedFile(const std::string &path);
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile();
+
+        [[nodiscard]] std::span<const char> data() const { return {bytes, length}; }
+    };
+
+    /**
+     * Index being serialized: plain values & arrays, appended in order
+     */
+    class Writer {
+    private:
+        std::vector<char> bytes;
+
+    public:
+        void putBytes(const void *data, std::size_t size) {
+          if (size == 0) return;
+          auto end = bytes.size();
+          bytes.resize(end + size);
+          std::memcpy(bytes.data() + end, data, size);
+        }
+
+        template<typename T>
+        void put(const T &value) { putBytes(&value, sizeof(T)); }
+
+        template<typename T>
+        void putArray(std::span<const T> values) {
+          put<std::uint64_t>(values.size());
+          putBytes(values.data(), values.size_bytes());
+        }
+
+        void putString(std::string_view value) { putArray(std::span<const char>(value.data(), value.size())); }
+
+        [[nodiscard]] std::span<const char> data() const { return bytes; }
+    };
+
+    /**
+     * Index being read back, in the order it was written. Every read is bounds-checked: a truncated or corrupted
+     * file gives nullopt, never an out of bounds access.
+     */
+    class Reader {
+    private:
+        std::span<const char> bytes;
+
+    public:
+        explicit Reader(std::span<const char> bytes) : bytes(bytes) {}
+
+        template<typename T>
+        std::optional<T> get() {
+          if (bytes.size() < sizeof(T)) return std::nullopt;
+          T value;
+          std::memcpy(&value, bytes.data(), sizeof(T));
+          bytes = bytes.subspan(sizeof(T));
+          return value;
+        }
+
+        /**
+         * @return the raw bytes of an array written by putArray (unaligned: memcpy the elements out)
+         */
+        template<typename T>
+        std::optional<std::span<const char>> getArray() {
+          auto count = get<std::uint64_t>();
+          if (!count || *count > bytes.size() / sizeof(T)) return std::nullopt;
+          auto array = bytes.first(*count * sizeof(T));
+          bytes = bytes.subspan(array.size());
+          return array;
+        }
+
+        std::optional<std::string_view> getString() {
+          auto array = getArray<char>();
+          if (!array) return std::nullopt;
+          return std::string_view(array->data(), array->size());
+        }
+
+        [[nodiscard]] bool atEnd() const { return bytes.empty(); }
+    };
+
+    /**
+     * @return the directory of the cache files, empty if disabled or there is no home
+     */
+    [[nodiscard]] std::string getDirectory();
+
+    /**
+     * @param key identifies the binary the index was built from
+     * @param kind kind of index (ex: "symbols"), part of the file name
+     * @param payload receives the saved index (without the cache file header), valid as long as the mapping
+     * @return the mapping of the file, nullptr if there is none or it is unusable
+     */
+    [[nodiscard]] std::shared_ptr<const MappedFile> load(const std::string &key, std::string_view kind,
+                                                         std::span<const char> &payload);
+
+    /**
+     * Saves an index atomically (written aside, then renamed): concurrent sessions never see a partial file
+     * @return false if the cache is disabled or the file can't be written
+     */
+    bool store(const std::string &key, std::string_view kind, const Writer &index);
+
+} // namespace cache
+
+#endif //C_BDD_BDD_INDEX_CACHE_HPP
@@ -0,0 +1,116 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#ifndef C_BDD_BDD_OUTPUT_HPP
+#define C_BDD_BDD_OUTPUT_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * Output of the traced program (stdout & stderr), captured instead of written to the terminal of the debugger.
+ * The bytes never go through the debugger's memory: they are moved from the capture pipe to the terminal and/or
+ * a log file with splice(), tee() duplicating them when both are wanted. The log gets a marker at every stop,
+ * to match the output with the breakpoints.
+ */
+namespace output {
+
+    enum class Mode {
+        Inherit, // the terminal of the debugger, nothing captured
+        Pipe,    // stdout & stderr to a pipe (the program sees no terminal: usually fully buffered)
+        Pty      // stdout & stderr to a pseudo-terminal (line buffered, colors, as in a terminal)
+    };
+
+    struct Options {
+        Mode mode = Mode::Inherit;
+        bool console = true;  // shown in the terminal, in order with the prints of the debugger
+        std::string log_path; // appended to, none if empty
+    };
+
+    [[nodiscard]] std::string_view getModeName(Mode mode);
+
+    /**
+     * Capture of one run: created before the fork, the child takes its end (see attachChild)
+     */
+    class Capture {
+    private:
+        int source_fd = -1; // read end of the pipe or pty master, non-blocking
+        int child_fd = -1;  // write end of the pipe or pty slave, until the fork
+        bool pty = false;
+
+        // splice() needs a pipe on one side: the bytes of the pty master go through it
+        int staging[2] = {-1, -1};
+
+        // Terminal & log: the bytes are tee()'d here for the log
+        int copy[2] = {-1, -1};
+
+        int log_fd = -1;
+        bool console = true;
+
+        // Cleared when the terminal refuses splice() (old kernels): copied through a buffer then
+        bool console_splice = true;
+
+        std::uint64_t captured = 0; // bytes
+        std::uint64_t stops = 0;
+
+        /**
+         * Moves the bytes at hand once (at most one pipe capacity)
+         * @return the number of bytes moved, 0 at the end of the output, -1 if there is none for now
+         */
+        long pumpOnce();
+
+        /**
+         * Moves exactly size bytes, already in the pipe, to the terminal or the log
+         */
+        void moveAll(int from, int to, std::size_t size);
+
+        void closeAll();
+
+    public:
+        /**
+         * @throws std::invalid_argument if the pipe, pty or log file can't be opened
+         */
+        explicit Capture(const Options &options);
+
+        Capture(const Capture &) = delete;
+
+        Capture &operator=(const Capture &) = delete;
+
+        ~Capture();
+
+        /**
+         * @return the file descriptor to watch, readable when the program has written something
+         */
+        [[nodiscard]] int getFd() const { return source_fd; }
+
+        /**
+         * Child side, before exec: its stdout & stderr become the capture (and the pty its controlling terminal)
+         */
+        void attachChild() const;
+
+        /**
+         * Parent side, after the fork: the child keeps the only writing end
+         */
+        void detachChild();
+
+        /**
+         * Moves everything the program has written so far to the terminal and/or the log, without blocking
+         * @return false once the output is over (every writer has closed it)
+         */
+        bool pump();
+
+        /**
+         * Pumps what is pending, then writes a marker line to the log (if any)
+         * @param event description of the stop (ex: "breakpoint at main+0x4")
+         */
+        void markStop(std::string_view event);
+
+        [[nodiscard]] std::uint64_t getCaptured() const { return captured; }
+    };
+
+} // namespace output
+
+#endif //C_BDD_BDD_OUTPUT_HPP
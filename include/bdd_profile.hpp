@@ -0,0 +1,110 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#ifndef C_BDD_BDD_PROFILE_HPP
+#define C_BDD_BDD_PROFILE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bdd_elf.hpp"
+#include "bdd_trace.hpp"
+
+/**
+ * Sampling profiler: the running program is stopped at a fixed rate, the stack of every thread walked (addresses
+ * only) and the program resumed. The stacks are aggregated in a trie, named once after the run and written as
+ * folded stacks ("outer;inner count" per line), as read by flamegraph.pl, inferno or speedscope.
+ */
+namespace profile {
+    using clock = trace::clock;
+
+    /**
+     * Sampled stacks by address, from the outermost frame: a stack seen again only bumps a counter
+     */
+    class StackTrie {
+    private:
+        struct Node {
+            addr_t address;        // call site (the interrupted instruction for the innermost frame)
+            std::uint32_t parent;  // index in nodes
+            std::uint64_t samples; // stacks ending here
+        };
+
+        // The root (no address) comes first, a child always after its parent
+        std::vector<Node> nodes{{0, 0, 0}};
+
+        struct EdgeHash {
+            std::size_t operator()(const std::pair<std::uint32_t, addr_t> &edge) const {
+              return std::hash<addr_t>()(edge.second) * 31 + edge.first;
+            }
+        };
+
+        // Child of a node by address
+        std::unordered_map<std::pair<std::uint32_t, addr_t>, std::uint32_t, EdgeHash> children;
+
+    public:
+        /**
+         * @param frames innermost first, as unwound
+         */
+        void add(std::span<const addr_t> frames);
+
+        /**
+         * @return the number of distinct frames (nodes) in the trie
+         */
+        [[nodiscard]] std::size_t size() const { return nodes.size() - 1; }
+
+        /**
+         * @return every distinct address, sorted, to be named at once
+         */
+        [[nodiscard]] std::vector<addr_t> getAddresses() const;
+
+        /**
+         * @param names of every address of getAddresses
+         * @return one line per stack of function names (the stacks differing by addresses only are merged)
+         */
+        [[nodiscard]] std::string fold(const std::unordered_map<addr_t, std::string> &names) const;
+
+        /**
+         * @param names of every address of getAddresses
+         * @return the samples of each innermost function, most sampled first
+         */
+        [[nodiscard]] std::vector<std::pair<std::string, std::uint64_t>>
+        getSelfSamples(const std::unordered_map<addr_t, std::string> &names) const;
+    };
+
+    /**
+     * Outcome of TracedProgram::profile
+     */
+    struct Report {
+        unsigned frequency = 0; // asked for, in Hz
+        StackTrie stacks;
+
+        std::uint64_t ticks = 0;   // sampling rounds
+        std::uint64_t missed = 0;  // ticks skipped: the previous round was late
+        std::uint64_t samples = 0; // stacks recorded, one per thread per tick
+        std::uint64_t failed = 0;  // stacks that couldn't be walked: their IP is recorded alone
+
+        // Time the program is stopped by each tick: every thread interrupted, walked & resumed
+        trace::Histogram overhead;
+        clock::duration stopped{};
+
+        clock::duration elapsed{};
+        clock::duration symbolization{};
+
+        std::string folded;
+        std::vector<std::pair<std::string, std::uint64_t>> hottest;
+
+        /**
+         * @return sampling & overhead figures, then the most sampled functions (not the folded stacks)
+         */
+        [[nodiscard]] std::string toString() const;
+    };
+
+} // namespace profile
+
+#endif //C_BDD_BDD_PROFILE_HPP
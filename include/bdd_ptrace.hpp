@@ -12,10 +12,12 @@ constexpr auto BDD_VERSION = "1.0b";
 
 #if INTPTR_MAX == INT64_MAX // 64 BITS ARCHITECTURE
 #define REGISTER_IP RIP
+#define REGISTERS_IP rip
 #define TRAP_MASK   0xFFFFFFFFFFFFFF00
 
 #elif INTPTR_MAX == INT32_MAX // 32 BITS ARCHITECTURE
 #define REGISTER_IP EIP
+#define REGISTERS_IP eip
 #define TRAP_MASK   0xFFFFFF00
 #endif
 
@@ -35,10 +37,18 @@ constexpr auto BDD_VERSION = "1.0b";
 #include <fstream>
 #include <libunwind-ptrace.h>
 #include <queue>
+#include <optional>
+#include <span>
 #include <sys/user.h>
 
 #include "bdd_elf.hpp"
 #include "bdd_exclusive_io.hpp"
+#include "bdd_disassembler.hpp"
+#include "bdd_dwarf.hpp"
+#include "bdd_trace.hpp"
+#include "bdd_profile.hpp"
+#include "bdd_event_loop.hpp"
+#include "bdd_output.hpp"
 
 constexpr unsigned max_stack_size = 256;
 
@@ -50,7 +60,7 @@ private:
     bool enabled = false;
     pid_t program_pid;
     addr_t address;
-    instr_t original;
+    std::uint8_t original = 0;
     std::string name;
 
 public:
@@ -64,9 +74,9 @@ public:
     }
 
     /**
-     * @return the original instruction
+     * @return the original byte, replaced by the INT3 while enabled
      */
-    [[nodiscard]] instr_t getOriginal() const {
+    [[nodiscard]] std::uint8_t getOriginal() const {
       return original;
     }
 
@@ -77,12 +87,71 @@ public:
       return name;
     }
 
-    bool enable();
+    /**
+     * State update after the INT3 has been written by TracedProgram::armBreakpoints
+     */
+    void setArmed(std::uint8_t original_byte) {
+      original = original_byte;
+      enabled = true;
+    }
+
+    /**
+     * State update after the original byte has been written back by TracedProgram::disarmBreakpoints
+     */
+    void setDisarmed() {
+      enabled = false;
+    }
+
+    /**
+     * State update of the copy of a breakpoint in a forked process (its memory holds the same INT3)
+     */
+    void setProgram(pid_t pid) {
+      program_pid = pid;
+    }
+};
+
+/**
+ * Outcome of a bulk memory access: the bytes before the first failure are always transferred
+ */
+struct MemoryAccess {
+    std::size_t transferred = 0;
+
+    // First address that could be neither read/written directly nor through /proc/<pid>/mem
+    std::optional<addr_t> failedAt;
+    int error = 0;
 
-    void disable();
+    [[nodiscard]] bool complete() const { return !failedAt.has_value(); }
 };
 
-constexpr auto objdump_cmd_format = "objdump -C -D -S -l -w --start-address=0x%016lX --stop-address=0x%016lX %s | tail -n+6";
+/**
+ * all-stop: an event on any thread stops every thread, continuing resumes all of them.
+ * non-stop: only the thread having the event stops, continuing resumes that thread only.
+ */
+enum class StopMode {
+    AllStop, NonStop
+};
+
+/**
+ * Ptrace state of one thread of the traced-program
+ */
+struct TracedThread {
+    int status = 0; // last waitpid status
+    bool running = false;
+    __ptrace_request resumedWith = PTRACE_CONT;
+
+    // PTRACE_INTERRUPT sent by the debugger (or initial stop of a new thread), swallowed when it shows up
+    bool stopRequested = false;
+
+    // Event seen while stopping the threads (all-stop), reported by the next wait
+    bool pending = false;
+
+    // Registers of the current stop, fetched once per stop and written back on resume
+    std::optional<user_regs_struct> registers;
+    bool registersDirty = false;
+
+    // FP/vector registers of the current stop, only fetched when asked for
+    std::optional<user_fpregs_struct> fpRegisters;
+};
 
 
 class TracedProgram {
@@ -90,33 +159,263 @@ private:
     // Libunwind: backtrace purpose
     unw_cursor_t unwind_cursor{};
 
+    // One address space for the program, keeping the unwind info libunwind has found from a backtrace to the next
+    // (until an exec), and one accessors context per thread
+    unw_addr_space_t unwind_space = nullptr;
+    std::map<pid_t, void *> unwind_contexts;
+
+    // Bumped whenever the stacks may have changed: new stop, registers or memory written
+    std::uint64_t stop_generation = 0;
+
+    // Last backtrace, returned as is while the same thread is at the same stop
+    struct CachedBacktrace {
+        pid_t tid = 0;
+        std::uint64_t generation = 0;
+        std::queue<std::pair<addr_t, std::string>> frames;
+    };
+    std::optional<CachedBacktrace> cached_backtrace;
+
+    // Own unwinder: executable mappings of the program (/proc/<pid>/maps), reloaded when a pc falls outside
+    struct UnwindModule {
+        addr_t start = 0;
+        addr_t end = 0;
+        addr_t bias = 0; // runtime address - Elf address
+        bool main = false;
+        std::string name; // of the file, without its directory
+        std::shared_ptr<const elf::ElfFile> file;
+        std::shared_ptr<const dwarf::FrameTable> frames;
+    };
+    std::vector<UnwindModule> unwind_modules;
+
+    // Call frame information by file path, indexed once until the next exec
+    std::map<std::string, std::shared_ptr<const dwarf::FrameTable>> frame_tables;
+
+    // Bytes of the stack from the stack pointer, read in bulk by each backtrace
+    std::vector<std::uint8_t> stack_snapshot;
+
+    // One frame found by the own unwinder
+    struct UnwoundFrame {
+        addr_t pc;     // return address for the callers
+        addr_t lookup; // instruction of the frame: the call itself for the callers
+    };
+    std::vector<UnwoundFrame> unwound_frames;
+
     // Physical first address of the program
     addr_t ram_start_address = 0;
 
     // Executable file path
     std::string elf_file_path;
 
-    // Elf class object
-    elf::ElfFile elf_file;
+    // Elf class object, shared with the other programs of the session running the same file
+    std::shared_ptr<const elf::ElfFile> elf_file;
+
+    // Source lines (empty without debug information), shared with the forked programs
+    std::shared_ptr<const dwarf::LineTable> line_table;
+
+    // Loads the new executable on exec
+    std::shared_ptr<elf::ElfRegistry> elf_registry;
 
     pid_t traced_pid{};
-    int cached_status = 0;
+
+    // Every thread of the program by TID, the main thread's TID being traced_pid
+    mutable std::map<pid_t, TracedThread> threads;
+
+    // Thread of the last reported event: the one inspected, stepped & continued
+    pid_t current_tid = 0;
+
+    // State returned while no thread exists (before the first run)
+    mutable TracedThread no_thread;
+
+    StopMode stop_mode = StopMode::AllStop;
+
+    // Tracee events, stdin & timers, shared by the programs of a session (it blocks SIGCHLD for every thread,
+    // so it must exist before any other thread)
+    std::shared_ptr<EventLoop> event_loop;
+
+    // Processes created by fork/vfork (PTRACE_EVENT_FORK/VFORK), not adopted yet
+    std::vector<pid_t> forked;
+
+    // False: the forked processes are detached at once (see detachFork)
+    bool follow_forks = true;
+
+    // Where the output of the next run goes
+    output::Options output_options;
+
+    // Output of the current run if captured, shared with the forked programs (they write to it too)
+    std::shared_ptr<output::Capture> output_capture;
+
+    // /proc/<pid>/mem, opened on the first access that needs it
+    mutable int memory_fd = -1;
 
     // Every breakpoint placed (enabled or not)
     std::map<addr_t, Breakpoint> breakpointsMap;
 
     std::vector<Breakpoint> pendingBreakpointsMap;
 
+    // Decoded code, by start Elf address (usually a function start)
+    struct DisassembledRange {
+        addr_t end = 0;
+        std::vector<disasm::Instruction> instructions;
+    };
+    mutable std::map<addr_t, DisassembledRange> disassemblyCache;
+
+    // Displaced stepping: the instructions under breakpoints run from copies in scratch pages of the program,
+    // or are emulated on the registers for relative branches & calls
+    enum class Emulation {
+        None, Jump, ConditionalJump, Call
+    };
+    struct DisplacedInstruction {
+        std::uint8_t length = 0; // 0 if the instruction can't be decoded
+        addr_t slot = 0;         // copy address, 0 if not copied
+        Emulation emulation = Emulation::None;
+        std::uint8_t condition = 0; // jcc condition code
+        addr_t target = 0;
+    };
+
+    enum class Displaced {
+        No,      // resumeBreakpoint is needed
+        Copy,    // the IP points to the copy, run by the next resume
+        Emulated // the instruction has been executed on the registers
+    };
+    std::map<addr_t, DisplacedInstruction> displaced; // by breakpoint address
+    std::map<addr_t, addr_t> displacedBySlot;         // slot -> breakpoint address
+    std::vector<addr_t> scratch_pages;
+    std::size_t scratch_used = 0; // in the last page
+    bool scratch_failed = false;
 
-    void initChild(std::vector<char *> &parameters);
 
-    void initBDD();
+    /**
+     * Child side of run: waits on the go pipe (the parent seizes it meanwhile), then execs.
+     * Its prints go to the output pipe (see ExclusiveIO::redirect). A failed exec writes its errno to the error pipe
+     * and exits
+     */
+    void initChild(std::vector<char *> &parameters, int go_fd, int output_fd, int error_fd);
 
+    /**
+     * @return whether the program is there, stopped at its exec
+     */
+    bool initBDD(int go_fd, int output_fd, int error_fd);
+
+    /**
+     * Waits for the next event worth reporting (waitpid(-1, __WALL)), handling the thread creations & exits
+     * on the way. It becomes the current thread; in all-stop mode, every other thread is stopped.
+     * Meanwhile, the lines typed are queued for the command loop, "interrupt" stops the program.
+     */
     void waitAndUpdateStatus();
 
+    /**
+     * Next state change of one thread, or of any thread of the program, as reaped by the event loop
+     * @param tid thread to wait for, -1 for any
+     * @param input watch stdin meanwhile, "interrupt" stops the program
+     * @return nullopt past the deadline, or when no state change can come anymore (nothing running)
+     */
+    std::optional<std::pair<pid_t, int>>
+    nextStatus(pid_t tid, std::optional<EventLoop::clock::time_point> deadline, bool input);
+
+    /**
+     * Sleeps in the event loop until a state change of the program
+     * @param tid thread to wait for, -1 for any (the input is only watched then)
+     * @param deadline nullopt: no time limit
+     * @return false if the deadline has passed first
+     */
+    bool waitForEvent(pid_t tid, std::optional<EventLoop::clock::time_point> deadline = std::nullopt);
+
+    /**
+     * Internal part of the events: clone, fork, initial & requested stops, exits of secondary threads
+     * @param resumeStopped resume the threads whose stop is swallowed
+     * @return whether the event has to be reported
+     */
+    bool handleEvent(pid_t tid, int status, bool resumeStopped);
+
+    /**
+     * Lets a forked process go instead of adopting it (ex: during a trace, nothing would resume it):
+     * after its initial stop, every breakpoint is removed from its memory and it is detached
+     */
+    void detachFork(pid_t child);
+
+    /**
+     * Resumes one thread, after writing its registers back
+     * @param signal delivered to the thread, 0 to suppress the one it stopped for
+     */
+    void resumeThread(pid_t tid, __ptrace_request request, int signal = 0);
+
+    /**
+     * Stops every running thread but the current one (PTRACE_INTERRUPT, then waits for each of them)
+     * @return the threads stopped here, to resume afterwards when needed
+     */
+    std::vector<pid_t> stopOthers();
+
+    /**
+     * Stops every running thread but one (PTRACE_INTERRUPT, then waits for each of them)
+     * @param except TID left as it is (0: none)
+     * @return the threads stopped here, those having another event to report left out (kept pending)
+     */
+    std::vector<pid_t> stopThreads(pid_t except);
+
+    [[nodiscard]] TracedThread &currentThread() const;
+
+    /**
+     * Points the unwind cursor at the current thread, creating the address space & its context on first use
+     */
     void attachUnwind();
 
-    void attachPtrace(int &status);
+    /**
+     * Destroys every libunwind context & the address space (new process, exec): the next backtrace starts afresh
+     */
+    void releaseUnwind();
+
+    /**
+     * Reads the executable mappings of the program, with their Elf file & call frame information
+     */
+    void loadUnwindModules();
+
+    /**
+     * @param reload allowed to reload the mappings once when the address is outside, cleared then
+     * @return the module mapping the address, nullptr if none
+     */
+    const UnwindModule *findUnwindModule(addr_t address, bool &reload);
+
+    /**
+     * Own unwinder: the stack is read in bulk from the stack pointer (a chunk, doubled while the frames lie deeper),
+     * the frames are then walked with the call frame information of each module (.eh_frame/.debug_frame), the frame
+     * pointer chain where there is none. Addresses only, nothing symbolized.
+     * @param frames receives the frames of the current thread, innermost first, none if the first one can't be found
+     */
+    void walkStack(std::vector<UnwoundFrame> &frames);
+
+    /**
+     * @return the symbolized frames of walkStack, empty if the first one can't be found (libunwind is used then)
+     */
+    std::queue<std::pair<addr_t, std::string>> unwindStack();
+
+    /**
+     * @param address runtime address, within the mappings known to the unwinder
+     * @return the demangled function, "[module]" without symbol, the address outside every module
+     */
+    [[nodiscard]] std::string getFunctionAt(addr_t address);
+
+    /**
+     * Libunwind unwinder: one ptrace call per word of stack read
+     */
+    std::queue<std::pair<addr_t, std::string>> unwindLibunwind();
+
+    /**
+     * @return what the current stop is, for the output markers (ex: "breakpoint")
+     */
+    [[nodiscard]] std::string describeStop() const;
+
+    /**
+     * Parent side of a captured run: the output is pumped by the event loop from now on
+     */
+    void watchOutput();
+
+    /**
+     * PTRACE_SEIZE with every option, lets the child exec and waits for its PTRACE_EVENT_EXEC stop.
+     * The child's prints until its exec are relayed from the output pipe. On failure, the child is reaped and the
+     * error shown
+     * @return success
+     */
+    bool attachPtrace(int go_fd, int output_fd, int error_fd);
 
     [[nodiscard]] addr_t getTracedRAMAddress() const;
 
@@ -124,7 +423,7 @@ private:
      * Direct instruction backward-step without breakpoint handling.
      * Used in continue & step functions when handling a breakpoint
      */
-    void ptraceBackwardStep() const;
+    void ptraceBackwardStep();
 
     /**
      * If breakpoint:\n
@@ -135,6 +434,45 @@ private:
      */
     void resumeBreakpoint();
 
+    /**
+     * Maps a page in the program by running an mmap syscall in place of the breakpoint it is trapped at
+     * @return the page address, 0 on failure
+     */
+    addr_t allocateScratchPage();
+
+    /**
+     * Prepared once per breakpoint: relative branches & calls are emulated, other instructions are copied
+     * to a scratch page followed by a jump back to the next one (RIP-relative operands adjusted).
+     * Instructions depending on the IP otherwise (indirect calls, loops, syscalls, ...) stay in line.
+     */
+    const DisplacedInstruction &getDisplaced(const Breakpoint &bp);
+
+    /**
+     * Gets the program trapped at a breakpoint past it without removing the INT3 (displaced stepping):
+     * the IP goes to the copy of the instruction, run by the next PTRACE_CONT/SINGLESTEP, or the instruction
+     * is emulated on the registers
+     */
+    Displaced displaceBreakpoint();
+
+    /**
+     * After a stop inside a copy (single-step, fault), puts the IP back at the same place in the original code
+     */
+    void relocateFromScratch();
+
+    void clearDisplaced();
+
+    /**
+     * After an exec (PTRACE_EVENT_EXEC past the launch): loads the new executable, the threads & memory of the
+     * previous one are gone. Breakpoints on functions the new executable also has are placed again.
+     */
+    void reloadAfterExec();
+
+    /**
+     * PTRACE_CONT, after writing the registers back. The next stop is left to waitAndUpdateStatus
+     * @param signal delivered to the current thread
+     */
+    void resumeTraced(int signal = 0);
+
     static void printSiginfo_t(const siginfo_t &info);
 
     static std::string getSegfaultCodeAsString(siginfo_t &info);
@@ -151,19 +489,133 @@ private:
 
     static addr_t strAddr_tToHex(const std::string &strAddress);
 
+    /**
+     * Single byte patch through /proc/<pid>/mem (PEEKTEXT/POKETEXT as a fallback), without touching the
+     * disassembly cache: used to swap a breakpoint byte while the Breakpoint state stays the same
+     * @return success
+     */
+    bool writeByte(addr_t address, std::uint8_t value);
+
+    /**
+     * Fills the register cache of a thread, if it is stopped
+     * @return the cached registers, nullptr if they can't be read
+     */
+    const user_regs_struct *fetchRegisters(pid_t tid) const;
+
+    /**
+     * @return the cached registers of the current thread
+     */
+    const user_regs_struct *fetchRegisters() const;
+
+    /**
+     * Writes the modified registers of a thread back (PTRACE_SETREGS), must be called before resuming it
+     */
+    void flushRegisters(pid_t tid);
+
+    /**
+     * Writes the modified registers of every thread back
+     */
+    void flushRegisters();
+
+    /**
+     * Drops the register caches of a thread, its next stop will fetch them again
+     */
+    void invalidateRegisters(pid_t tid);
+
+    /**
+     * @return the /proc/<pid>/mem file descriptor of the traced-program, -1 if it can't be opened
+     */
+    [[nodiscard]] int getMemoryFile() const;
+
+    /**
+     * Shared by armBreakpoints & disarmBreakpoints
+     * @param arm true to write the INT3s, false to write the original bytes back
+     */
+    std::size_t patchBreakpoints(const std::vector<addr_t> &addresses, bool arm);
+
+    /**
+     * Shared by breakpointAtLine & disableBreakpointAtLine
+     * @param location "file.c:42"
+     * @return the first entry of this line (or the next one having code), nullptr if none
+     */
+    [[nodiscard]] const dwarf::LineEntry *findLine(const std::string &location) const;
+
+    void closeMemoryFile() const;
+
+    /**
+     * Reads the code the traced-program is currently executing, breakpoints replaced by the original bytes.
+     * Falls back to the Elf file bytes if the program is not started (or can't be read)
+     * @param address Elf address (virtual memory address)
+     * @param size maximum number of bytes
+     */
+    [[nodiscard]] std::vector<std::uint8_t> readCode(addr_t address, std::size_t size) const;
+
+    /**
+     * Decodes [start, end) (extended to the whole function if start is a function), or reuses the cached instructions
+     * @param start Elf address of the first instruction
+     * @param end Elf address to decode at least up to
+     */
+    [[nodiscard]] const std::vector<disasm::Instruction> &disassemble(addr_t start, addr_t end) const;
+
+    /**
+     * Drops the cached instructions covering [address, address + size), to call whenever the traced-program text
+     * is written
+     * @param address Elf address (virtual memory address)
+     */
+    void invalidateDisassembly(addr_t address, std::size_t size = 1);
+
+    /**
+     * Drops every cached instruction (new process)
+     */
+    void invalidateDisassembly();
+
+    /**
+     * @return "<function+0x..>" if the Elf address is inside a known function, else an empty string
+     */
+    [[nodiscard]] std::string symbolize(addr_t address) const;
+
 public:
-    explicit TracedProgram(const std::string &exec_path);
+    /**
+     * @param loop event loop of the session, a new one if null
+     * @param registry Elf files of the session, a new one if null
+     */
+    explicit TracedProgram(const std::string &exec_path, std::shared_ptr<EventLoop> loop = nullptr,
+                           std::shared_ptr<elf::ElfRegistry> registry = nullptr);
 
+    /**
+     * Adopts a process forked by the parent program: already traced (inherited options), the same memory
+     * (breakpoints & scratch pages included) and the same files
+     * @param child its PID, its first stop (PTRACE_EVENT_STOP) is swallowed and it runs
+     */
+    TracedProgram(const TracedProgram &parent, pid_t child);
+
+    TracedProgram(const TracedProgram &) = delete;
+
+    TracedProgram &operator=(const TracedProgram &) = delete;
 
     ~TracedProgram() {
-      ptrace(PTRACE_DETACH, traced_pid, 0, 0);
-      ExclusiveIO::terminate();
+      // A detached program would die on the first INT3 left behind
+      if (hasStarted() && isAlive()) {
+        stopOthers();
+        disarmBreakpoints();
+      }
+      closeMemoryFile();
+      flushRegisters();
+      releaseUnwind();
+      for (const auto &thread: threads) ptrace(PTRACE_DETACH, thread.first, 0, 0);
     }
 
 #pragma region breakpoints
 
     [[nodiscard]] bool breakpointAtFunction(const std::string &fctName);
 
+    /**
+     * Try to place & enable a breakpoint at a source line (or the next one having code)
+     * @param location "file.c:42", the file being a full path, a path suffix or a file name
+     * @return success
+     */
+    [[nodiscard]] bool breakpointAtLine(const std::string &location);
+
     /**
      * @return current physical address of the (E|R)IP
      */
@@ -174,7 +626,18 @@ public:
     /**
      * Run the traced-program to the end (except segfaults/breakpoints/...)
      */
-    void ptraceContinue(bool lock = true);
+    void ptraceContinue();
+
+    /**
+     * First half of ptraceContinue: gets past the breakpoint and resumes, the stop is left to pollEvent
+     */
+    void resume();
+
+    /**
+     * Handles the state changes of the program already reaped, without sleeping
+     * @return whether one of them is worth reporting (the program is then stopped as after ptraceContinue)
+     */
+    bool pollEvent();
 
     /**
      * Steps one instruction in the traced-program (with automated breakpoints handling)
@@ -202,12 +665,78 @@ public:
 
     [[nodiscard]] bool isTrapped() const;
 
+    /**
+     * @return whether the program stopped on interrupt()
+     */
+    [[nodiscard]] bool isInterrupted() const;
+
+    /**
+     * @return whether the program stopped on an exec of a new executable
+     */
+    [[nodiscard]] bool hasExeced() const;
+
+    /**
+     * @return whether a thread of the program is running
+     */
+    [[nodiscard]] bool isRunning() const;
+
 #pragma endregion
 
-    [[nodiscard]] elf::ElfFile getElfFile() const {
+    /**
+     * @return the Elf file of the current executable, valid until the next exec (see shareElfFile)
+     */
+    [[nodiscard]] const elf::ElfFile &getElfFile() const {
+      return *elf_file;
+    }
+
+    /**
+     * @return a handle on the Elf file, to keep it past an exec or use it from another thread
+     */
+    [[nodiscard]] std::shared_ptr<const elf::ElfFile> shareElfFile() const {
       return elf_file;
     }
 
+    [[nodiscard]] const dwarf::LineTable &getLineTable() const {
+      return *line_table;
+    }
+
+    [[nodiscard]] const std::string &getPath() const {
+      return elf_file_path;
+    }
+
+    [[nodiscard]] pid_t getPid() const {
+      return traced_pid;
+    }
+
+    /**
+     * @return the processes it forked since the last call, to adopt
+     */
+    std::vector<pid_t> takeForks() {
+      return std::exchange(forked, {});
+    }
+
+    /**
+     * @param address Elf address (virtual memory address)
+     * @return "path/file.c:42", an empty string if unknown
+     */
+    [[nodiscard]] std::string getSourceLocation(addr_t address) const {
+      return line_table->getLocationString(address);
+    }
+
+    /**
+     * Where the output of the program goes from the next run on
+     */
+    void setOutput(const output::Options &options) { output_options = options; }
+
+    [[nodiscard]] const output::Options &getOutput() const { return output_options; }
+
+    /**
+     * To call when a stop is reported: what the program wrote up to it is shown first, and the log of the output
+     * gets a marker (see output::Capture::markStop)
+     * @param reason described from the state of the program if empty
+     */
+    void markStop(std::string_view reason = {}) const;
+
     /**
      * Send a SIGINT to the traced-program
      */
@@ -219,16 +748,35 @@ public:
     void killTraced() const;
 
     /**
-     * Execute the traced-program
+     * Stops the running traced-program (PTRACE_INTERRUPT of the current thread), its stop is reported as any other
+     */
+    void interrupt() const;
+
+    /**
+     * Lets the traced-program run until it exits, the signals it gets being delivered (ex: after stopTraced)
+     * @param timeout the program is stopped again past it
+     * @return whether it exited
+     */
+    bool waitForExit(std::chrono::milliseconds timeout);
+
+    /**
+     * @return the next line of the user (typed ahead while the program was running, or read now),
+     * nullopt once stdin is closed
+     */
+    std::optional<std::string> readLine() { return event_loop->nextLine(); }
+
+    /**
+     * Execute the traced-program, stopped before its first instruction
      * @param parameters
+     * @return false if it can't be executed (the reason is shown)
      */
-    void run(std::vector<char *> &parameters);
+    bool run(std::vector<char *> &parameters);
 
     /**
      * Execute the traced-program
-     * @param parameters
+     * @return false if it can't be executed
      */
-    void run();
+    bool run();
 
     /**
      * Adds a breakpoint to the map
@@ -254,10 +802,30 @@ public:
     void printBreakpointsMap() const;
 
     /**
-     * Dump the assembly program at the specified location
-     * @param address location
-     * @param offset area of the dump
-     * @return parsed dump
+     * Enables the given breakpoints of the map at once: the sites are grouped by page, each page is read once,
+     * patched locally, then written back (one read & one write per page instead of a PEEK/POKE pair per site)
+     * @param addresses physical addresses of breakpoints of the map, already enabled ones are ignored
+     * @return the number of breakpoints enabled
+     */
+    std::size_t armBreakpoints(const std::vector<addr_t> &addresses);
+
+    /**
+     * Disables the given breakpoints of the map at once, the same way as armBreakpoints
+     * @param addresses physical addresses of breakpoints of the map, already disabled ones are ignored
+     * @return the number of breakpoints disabled
+     */
+    std::size_t disarmBreakpoints(const std::vector<addr_t> &addresses);
+
+    /**
+     * Disables every breakpoint of the map at once
+     */
+    std::size_t disarmBreakpoints();
+
+    /**
+     * Disassemble the program at the specified location (from the instruction containing it)
+     * @param address location, as an Elf address
+     * @param offset area of the dump, in bytes
+     * @return objdump-like listing
      */
     [[nodiscard]] std::string dumpAt(addr_t address, addr_t offset = 20) const;
 
@@ -284,13 +852,36 @@ public:
      */
     [[nodiscard]] std::queue<std::pair<addr_t, std::string>> backtrace();
 
+    enum class Unwinder {
+        Own, Libunwind
+    };
+
+    /**
+     * Backtrace through one unwinder only, never cached: to compare them
+     * @return the parsed backtrace, empty if the own unwinder can't find the first frame
+     */
+    [[nodiscard]] std::queue<std::pair<addr_t, std::string>> backtrace(Unwinder unwinder);
+
     /**
      * @return details over the current segfault
      */
     [[nodiscard]] std::pair<std::string, addr_t> getSegfaultData() const;
 
+    /**
+     * @return the registers of the current stop (cached, no syscall after the first call)
+     */
     [[nodiscard]] std::optional<user_regs_struct> getRegisters() const;
 
+    /**
+     * @return the FP/vector registers of the current stop, fetched on the first call
+     */
+    [[nodiscard]] std::optional<user_fpregs_struct> getFPRegisters() const;
+
+    /**
+     * Replaces the registers of the traced-program, written back on the next resume
+     */
+    void setRegisters(const user_regs_struct &regs);
+
     /**
      * Try to disable a breakpoint at the specified location
      */
@@ -301,6 +892,11 @@ public:
      */
     [[nodiscard]] bool disableBreakpointAtAddress(const std::string &hex_addr_as_str);
 
+    /**
+     * Try to disable the breakpoint of a source line, found as by breakpointAtLine (a pending one is removed)
+     */
+    [[nodiscard]] bool disableBreakpointAtLine(const std::string &location);
+
     /**
      * Enables every pending breakpoints, happen if any 'bp' has been required before the first 'run'
      * @return the status for each breakpoint
@@ -308,6 +904,76 @@ public:
     std::vector<std::pair<Breakpoint, bool>> placeEveryPendingBreakpoints();
 
     [[nodiscard]] bool hasStarted() const;
+
+#pragma region Threads
+
+    [[nodiscard]] const std::map<pid_t, TracedThread> &getThreads() const { return threads; }
+
+    [[nodiscard]] pid_t getCurrentThread() const { return current_tid; }
+
+    /**
+     * Makes a stopped thread the current one (inspected, stepped & continued)
+     * @return false if the thread is unknown or running
+     */
+    bool selectThread(pid_t tid);
+
+    /**
+     * @return the IP of a stopped thread, nullopt if it is running
+     */
+    [[nodiscard]] std::optional<addr_t> getThreadIP(pid_t tid) const;
+
+    [[nodiscard]] StopMode getStopMode() const { return stop_mode; }
+
+    /**
+     * Switching to all-stop stops every running thread
+     */
+    void setStopMode(StopMode mode);
+
+#pragma endregion Threads
+
+#pragma region Trace
+
+    /**
+     * Function-entry tracing: arms a breakpoint on every matching function (except those already holding one)
+     * and resumes through each hit without coming back to the user, until anything else stops the program.
+     * The trace breakpoints are removed afterwards.
+     * @param patterns globs (ex: "str*") or regexes between slashes (ex: "/^_Z.*vector/") over the function names
+     * @param timestamps also records the time of every hit
+     * @return hit counters & round-trip timings, without any function if nothing matched
+     */
+    trace::Report trace(const std::vector<std::string> &patterns, bool timestamps = false);
+
+    /**
+     * Sampling profiler: at each tick, every thread is interrupted (PTRACE_INTERRUPT), its stack walked (addresses
+     * only, see walkStack) and resumed, until anything else stops the program or the duration is over (the program
+     * is then interrupted). The addresses are named in one batch afterwards.
+     * @param frequency ticks per second
+     * @param duration nullopt: until the program stops
+     * @return samples, folded stacks & the time the ticks cost, nothing if the program isn't running
+     */
+    profile::Report profile(unsigned frequency, std::optional<profile::clock::duration> duration = std::nullopt);
+
+#pragma endregion Trace
+
+#pragma region Memory
+
+    /**
+     * Reads any range of the traced-program memory, in as few syscalls as possible (process_vm_readv).
+     * Pages that can't be read this way (ex: PROT_NONE) are read through /proc/<pid>/mem.
+     * @param address physical address
+     * @param buffer destination, its size is the size of the read
+     */
+    MemoryAccess readMemory(addr_t address, std::span<std::uint8_t> buffer) const;
+
+    /**
+     * Writes any range of the traced-program memory (process_vm_writev).
+     * Read-only pages (ex: text, for breakpoints) are written through /proc/<pid>/mem.
+     * @param address physical address
+     * @param data bytes to write
+     */
+    MemoryAccess writeMemory(addr_t address, std::span<const std::uint8_t> data);
+
+#pragma endregion Memory
 };
 
 #endif //C_BDD_BDD_PTRACE_HPP
@@ -0,0 +1,99 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#ifndef C_BDD_BDD_SESSION_HPP
+#define C_BDD_BDD_SESSION_HPP
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "bdd_ptrace.hpp"
+
+/**
+ * Every process debugged at once (inferiors): the program launched, the processes it forks (followed from their
+ * birth, with the breakpoints of their parent) and the instances started with spawn.
+ * They share one event loop, woken up by the state changes of any of them, and one parsed Elf file per executable.
+ * One inferior is the current one: inspected, stepped & continued by the commands.
+ */
+class DebugSession {
+private:
+    // First member: SIGCHLD is blocked before anything else exists
+    std::shared_ptr<EventLoop> event_loop;
+
+    std::shared_ptr<elf::ElfRegistry> elf_registry;
+
+    std::string exec_path;
+
+    // By inferior number, from 1
+    std::map<int, std::unique_ptr<TracedProgram>> inferiors;
+
+    // Inferiors adopted on a fork, dropped once they exit
+    std::set<int> forked;
+
+    int current_id = 1;
+    int next_id = 1;
+
+    /**
+     * Creates an inferior for every process forked by the others since the last call
+     */
+    void adoptForks();
+
+    /**
+     * Stops the current inferior if it runs, else the first running one
+     */
+    void interrupt();
+
+public:
+    explicit DebugSession(const std::string &exec_path);
+
+    ~DebugSession();
+
+    DebugSession(const DebugSession &) = delete;
+
+    DebugSession &operator=(const DebugSession &) = delete;
+
+    [[nodiscard]] TracedProgram &current() { return *inferiors.at(current_id); }
+
+    [[nodiscard]] int getCurrentId() const { return current_id; }
+
+    [[nodiscard]] const std::map<int, std::unique_ptr<TracedProgram>> &getInferiors() const { return inferiors; }
+
+    [[nodiscard]] bool isForked(int id) const { return forked.contains(id); }
+
+    /**
+     * Makes an inferior the current one
+     * @return false if there is no such inferior
+     */
+    bool select(int id);
+
+    /**
+     * Starts another instance of the executable, stopped before its first instruction, as the current inferior
+     * @return its number, 0 if it can't be executed
+     */
+    int spawn(std::vector<char *> &parameters);
+
+    /**
+     * Resumes the current inferior, then waits for the next event of any inferior (see waitAny).
+     * A forked inferior stopped at its exit is let go first, the first inferior becoming the current one
+     */
+    void continueCurrent();
+
+    /**
+     * Sleeps until an inferior stops for an event worth reporting, it becomes the current one.
+     * Forked processes are adopted on the way; the exits of the inferiors other than the current one are only shown.
+     * Returns at once when no inferior runs.
+     */
+    void waitAny();
+
+    /**
+     * @return the next line of the user, nullopt once stdin is closed
+     */
+    std::optional<std::string> readLine() { return event_loop->nextLine(); }
+};
+
+#endif //C_BDD_BDD_SESSION_HPP
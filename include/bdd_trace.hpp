@@ -0,0 +1,97 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#ifndef C_BDD_BDD_TRACE_HPP
+#define C_BDD_BDD_TRACE_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bdd_elf.hpp"
+
+namespace trace {
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * Counters of one traced function
+     */
+    struct FunctionHits {
+        std::string name;
+        addr_t address = 0; // physical address of the breakpoint
+        std::uint64_t hits = 0;
+
+        // Nanoseconds since the start of the trace, one per hit (only recorded when asked for)
+        std::vector<std::uint64_t> timestamps;
+    };
+
+    /**
+     * Power-of-two buckets of durations, in nanoseconds
+     */
+    class Histogram {
+    private:
+        std::array<std::uint64_t, 64> buckets{};
+        std::uint64_t count = 0;
+        std::uint64_t total = 0;
+        std::uint64_t min = UINT64_MAX;
+        std::uint64_t max = 0;
+
+    public:
+        void add(std::uint64_t nanoseconds);
+
+        [[nodiscard]] std::uint64_t getCount() const { return count; }
+
+        /**
+         * @return one line per non-empty bucket: "[  1us,   2us): count ####"
+         */
+        [[nodiscard]] std::string toString() const;
+    };
+
+    /**
+     * Outcome of TracedProgram::trace
+     */
+    struct Report {
+        std::vector<FunctionHits> functions;
+
+        // Time spent by the debugger on each hit: from the stop being seen to the program running again
+        Histogram roundTrip;
+
+        clock::duration elapsed{};
+
+        [[nodiscard]] std::uint64_t totalHits() const;
+
+        /**
+         * @return hit counts (most hit first), hits/sec and the round-trip histogram
+         */
+        [[nodiscard]] std::string toString() const;
+    };
+
+    /**
+     * Function names selection, compiled once
+     */
+    class FunctionFilter {
+    private:
+        std::vector<std::string> globs;
+        std::vector<std::regex> regexes;
+
+    public:
+        /**
+         * @param patterns each one is either "/regex/" (ECMAScript) or a glob (fnmatch: *, ?, [...])
+         * @throws std::invalid_argument on a malformed regex
+         */
+        explicit FunctionFilter(const std::vector<std::string> &patterns);
+
+        /**
+         * @return whether the name matches any of the patterns
+         */
+        [[nodiscard]] bool matches(const std::string &name) const;
+    };
+
+} // namespace trace
+
+#endif //C_BDD_BDD_TRACE_HPP
@@ -0,0 +1,1964 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+#include "bdd_disassembler.hpp"
+
+using namespace disasm;
+
+namespace {
+
+#pragma region Registers
+
+    constexpr const char *reg64[16] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                       "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+    constexpr const char *reg32[16] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+                                       "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+    constexpr const char *reg16[16] = {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+                                       "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"};
+    constexpr const char *reg8Rex[16] = {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+                                         "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+    constexpr const char *reg8Legacy[8] = {"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh"};
+    constexpr const char *segmentRegs[8] = {"es", "cs", "ss", "ds", "fs", "gs", "?", "?"};
+    constexpr const char *conditions[16] = {"o", "no", "b", "ae", "e", "ne", "be", "a",
+                                            "s", "ns", "p", "np", "l", "ge", "le", "g"};
+
+#pragma endregion
+
+    // Opcode entry flags
+    enum {
+        F_NONE = 0,
+        F_SUFFIX = 1,   // Size suffix when no register operand gives the size (movl $0x0,(%rax))
+        F_D64 = 2,      // Default operand size is 64 bits in long mode (push, pop, call, jmp)
+        F_BRANCH = 4,   // Relative branch (bnd prefix allowed)
+        F_INDIRECT = 8, // Indirect branch/call, printed with '*'
+    };
+
+    struct OpcodeEntry {
+        const char *mnemonic;
+        const char *operands; // Intel order, comma separated
+        unsigned flags;
+    };
+
+    // Alternatives selected by the mandatory prefix: none, 66, F3, F2
+    struct SseEntry {
+        OpcodeEntry variants[4];
+    };
+
+#pragma region Tables
+
+    constexpr const char *aluNames[8] = {"add", "or", "adc", "sbb", "and", "sub", "xor", "cmp"};
+    constexpr const char *shiftNames[8] = {"rol", "ror", "rcl", "rcr", "shl", "shr", "sal", "sar"};
+    constexpr const char *group3Names[8] = {"test", "test", "not", "neg", "mul", "imul", "div", "idiv"};
+
+    // Two-byte opcodes (0F xx) which are prefix independent
+    OpcodeEntry twoByteEntry(std::uint8_t op) {
+      switch (op) {
+        case 0x05:
+          return {"syscall", "", F_NONE};
+        case 0x06:
+          return {"clts", "", F_NONE};
+        case 0x07:
+          return {"sysret", "", F_NONE};
+        case 0x0B:
+          return {"ud2", "", F_NONE};
+        case 0x0D:
+          return {"prefetchw", "M", F_NONE};
+        case 0x31:
+          return {"rdtsc", "", F_NONE};
+        case 0xA2:
+          return {"cpuid", "", F_NONE};
+        case 0xA3:
+          return {"bt", "Ev,Gv", F_SUFFIX};
+        case 0xA4:
+          return {"shld", "Ev,Gv,Ib", F_SUFFIX};
+        case 0xA5:
+          return {"shld", "Ev,Gv,CL", F_SUFFIX};
+        case 0xAB:
+          return {"bts", "Ev,Gv", F_SUFFIX};
+        case 0xAC:
+          return {"shrd", "Ev,Gv,Ib", F_SUFFIX};
+        case 0xAD:
+          return {"shrd", "Ev,Gv,CL", F_SUFFIX};
+        case 0xAF:
+          return {"imul", "Gv,Ev", F_SUFFIX};
+        case 0xB0:
+          return {"cmpxchg", "Eb,Gb", F_SUFFIX};
+        case 0xB1:
+          return {"cmpxchg", "Ev,Gv", F_SUFFIX};
+        case 0xB3:
+          return {"btr", "Ev,Gv", F_SUFFIX};
+        case 0xBB:
+          return {"btc", "Ev,Gv", F_SUFFIX};
+        case 0xC0:
+          return {"xadd", "Eb,Gb", F_SUFFIX};
+        case 0xC1:
+          return {"xadd", "Ev,Gv", F_SUFFIX};
+        default:
+          return {nullptr, nullptr, F_NONE};
+      }
+    }
+
+    // Two-byte SSE opcodes, selected by mandatory prefix
+    SseEntry sseEntry(std::uint8_t op) {
+      switch (op) {
+        case 0x10:
+          return {{{"movups", "V,W", 0}, {"movupd", "V,W", 0}, {"movss", "V,W", 0}, {"movsd", "V,W", 0}}};
+        case 0x11:
+          return {{{"movups", "W,V", 0}, {"movupd", "W,V", 0}, {"movss", "W,V", 0}, {"movsd", "W,V", 0}}};
+        case 0x12:
+          return {{{"movlps", "V,W", 0}, {"movlpd", "V,M", 0}, {"movsldup", "V,W", 0}, {"movddup", "V,W", 0}}};
+        case 0x13:
+          return {{{"movlps", "M,V", 0}, {"movlpd", "M,V", 0}, {}, {}}};
+        case 0xE6:
+          return {{{}, {"cvttpd2dq", "V,W", 0}, {"cvtdq2pd", "V,W", 0}, {"cvtpd2dq", "V,W", 0}}};
+        case 0x14:
+          return {{{"unpcklps", "V,W", 0}, {"unpcklpd", "V,W", 0}, {}, {}}};
+        case 0x15:
+          return {{{"unpckhps", "V,W", 0}, {"unpckhpd", "V,W", 0}, {}, {}}};
+        case 0x16:
+          return {{{"movhps", "V,W", 0}, {"movhpd", "V,M", 0}, {"movshdup", "V,W", 0}, {}}};
+        case 0x17:
+          return {{{"movhps", "M,V", 0}, {"movhpd", "M,V", 0}, {}, {}}};
+        case 0x28:
+          return {{{"movaps", "V,W", 0}, {"movapd", "V,W", 0}, {}, {}}};
+        case 0x29:
+          return {{{"movaps", "W,V", 0}, {"movapd", "W,V", 0}, {}, {}}};
+        case 0x2A:
+          return {{{}, {}, {"cvtsi2ss", "V,Ey", F_SUFFIX}, {"cvtsi2sd", "V,Ey", F_SUFFIX}}};
+        case 0x2B:
+          return {{{"movntps", "M,V", 0}, {"movntpd", "M,V", 0}, {}, {}}};
+        case 0x2C:
+          return {{{}, {}, {"cvttss2si", "Gy,W", 0}, {"cvttsd2si", "Gy,W", 0}}};
+        case 0x2D:
+          return {{{}, {}, {"cvtss2si", "Gy,W", 0}, {"cvtsd2si", "Gy,W", 0}}};
+        case 0x2E:
+          return {{{"ucomiss", "V,W", 0}, {"ucomisd", "V,W", 0}, {}, {}}};
+        case 0x2F:
+          return {{{"comiss", "V,W", 0}, {"comisd", "V,W", 0}, {}, {}}};
+        case 0x50:
+          return {{{"movmskps", "Gd,U", 0}, {"movmskpd", "Gd,U", 0}, {}, {}}};
+        case 0x51:
+          return {{{"sqrtps", "V,W", 0}, {"sqrtpd", "V,W", 0}, {"sqrtss", "V,W", 0}, {"sqrtsd", "V,W", 0}}};
+        case 0x54:
+          return {{{"andps", "V,W", 0}, {"andpd", "V,W", 0}, {}, {}}};
+        case 0x55:
+          return {{{"andnps", "V,W", 0}, {"andnpd", "V,W", 0}, {}, {}}};
+        case 0x56:
+          return {{{"orps", "V,W", 0}, {"orpd", "V,W", 0}, {}, {}}};
+        case 0x57:
+          return {{{"xorps", "V,W", 0}, {"xorpd", "V,W", 0}, {}, {}}};
+        case 0x58:
+          return {{{"addps", "V,W", 0}, {"addpd", "V,W", 0}, {"addss", "V,W", 0}, {"addsd", "V,W", 0}}};
+        case 0x59:
+          return {{{"mulps", "V,W", 0}, {"mulpd", "V,W", 0}, {"mulss", "V,W", 0}, {"mulsd", "V,W", 0}}};
+        case 0x5A:
+          return {{{"cvtps2pd", "V,W", 0}, {"cvtpd2ps", "V,W", 0}, {"cvtss2sd", "V,W", 0}, {"cvtsd2ss", "V,W", 0}}};
+        case 0x5B:
+          return {{{"cvtdq2ps", "V,W", 0}, {"cvtps2dq", "V,W", 0}, {"cvttps2dq", "V,W", 0}, {}}};
+        case 0x5C:
+          return {{{"subps", "V,W", 0}, {"subpd", "V,W", 0}, {"subss", "V,W", 0}, {"subsd", "V,W", 0}}};
+        case 0x5D:
+          return {{{"minps", "V,W", 0}, {"minpd", "V,W", 0}, {"minss", "V,W", 0}, {"minsd", "V,W", 0}}};
+        case 0x5E:
+          return {{{"divps", "V,W", 0}, {"divpd", "V,W", 0}, {"divss", "V,W", 0}, {"divsd", "V,W", 0}}};
+        case 0x5F:
+          return {{{"maxps", "V,W", 0}, {"maxpd", "V,W", 0}, {"maxss", "V,W", 0}, {"maxsd", "V,W", 0}}};
+        case 0x60:
+          return {{{"punpcklbw", "P,Q", 0}, {"punpcklbw", "V,W", 0}, {}, {}}};
+        case 0x61:
+          return {{{"punpcklwd", "P,Q", 0}, {"punpcklwd", "V,W", 0}, {}, {}}};
+        case 0x62:
+          return {{{"punpckldq", "P,Q", 0}, {"punpckldq", "V,W", 0}, {}, {}}};
+        case 0x63:
+          return {{{"packsswb", "P,Q", 0}, {"packsswb", "V,W", 0}, {}, {}}};
+        case 0x64:
+          return {{{"pcmpgtb", "P,Q", 0}, {"pcmpgtb", "V,W", 0}, {}, {}}};
+        case 0x65:
+          return {{{"pcmpgtw", "P,Q", 0}, {"pcmpgtw", "V,W", 0}, {}, {}}};
+        case 0x66:
+          return {{{"pcmpgtd", "P,Q", 0}, {"pcmpgtd", "V,W", 0}, {}, {}}};
+        case 0x67:
+          return {{{"packuswb", "P,Q", 0}, {"packuswb", "V,W", 0}, {}, {}}};
+        case 0x68:
+          return {{{"punpckhbw", "P,Q", 0}, {"punpckhbw", "V,W", 0}, {}, {}}};
+        case 0x69:
+          return {{{"punpckhwd", "P,Q", 0}, {"punpckhwd", "V,W", 0}, {}, {}}};
+        case 0x6A:
+          return {{{"punpckhdq", "P,Q", 0}, {"punpckhdq", "V,W", 0}, {}, {}}};
+        case 0x6B:
+          return {{{"packssdw", "P,Q", 0}, {"packssdw", "V,W", 0}, {}, {}}};
+        case 0x6C:
+          return {{{}, {"punpcklqdq", "V,W", 0}, {}, {}}};
+        case 0x6D:
+          return {{{}, {"punpckhqdq", "V,W", 0}, {}, {}}};
+        case 0x6E:
+          return {{{"movd", "P,Ey", 0}, {"movd", "V,Ey", 0}, {}, {}}};
+        case 0x6F:
+          return {{{"movq", "P,Q", 0}, {"movdqa", "V,W", 0}, {"movdqu", "V,W", 0}, {}}};
+        case 0x70:
+          return {{{"pshufw", "P,Q,Ib", 0}, {"pshufd", "V,W,Ib", 0}, {"pshufhw", "V,W,Ib", 0},
+                   {"pshuflw", "V,W,Ib", 0}}};
+        case 0x74:
+          return {{{"pcmpeqb", "P,Q", 0}, {"pcmpeqb", "V,W", 0}, {}, {}}};
+        case 0x75:
+          return {{{"pcmpeqw", "P,Q", 0}, {"pcmpeqw", "V,W", 0}, {}, {}}};
+        case 0x76:
+          return {{{"pcmpeqd", "P,Q", 0}, {"pcmpeqd", "V,W", 0}, {}, {}}};
+        case 0x7E:
+          return {{{"movd", "Ey,P", 0}, {"movd", "Ey,V", 0}, {"movq", "V,W", 0}, {}}};
+        case 0x7F:
+          return {{{"movq", "Q,P", 0}, {"movdqa", "W,V", 0}, {"movdqu", "W,V", 0}, {}}};
+        case 0xB8:
+          return {{{}, {}, {"popcnt", "Gv,Ev", 0}, {}}};
+        case 0xBC:
+          return {{{"bsf", "Gv,Ev", 0}, {"bsf", "Gv,Ev", 0}, {"tzcnt", "Gv,Ev", 0}, {}}};
+        case 0xBD:
+          return {{{"bsr", "Gv,Ev", 0}, {"bsr", "Gv,Ev", 0}, {"lzcnt", "Gv,Ev", 0}, {}}};
+        case 0xC2:
+          return {{{"cmpps", "V,W,Ib", 0}, {"cmppd", "V,W,Ib", 0}, {"cmpss", "V,W,Ib", 0}, {"cmpsd", "V,W,Ib", 0}}};
+        case 0xC4:
+          return {{{"pinsrw", "P,Ed,Ib", 0}, {"pinsrw", "V,Ed,Ib", 0}, {}, {}}};
+        case 0xC5:
+          return {{{"pextrw", "Gd,N,Ib", 0}, {"pextrw", "Gd,U,Ib", 0}, {}, {}}};
+        case 0xC6:
+          return {{{"shufps", "V,W,Ib", 0}, {"shufpd", "V,W,Ib", 0}, {}, {}}};
+        case 0xD4:
+          return {{{"paddq", "P,Q", 0}, {"paddq", "V,W", 0}, {}, {}}};
+        case 0xD6:
+          return {{{}, {"movq", "W,V", 0}, {}, {}}};
+        case 0xD7:
+          return {{{"pmovmskb", "Gd,N", 0}, {"pmovmskb", "Gd,U", 0}, {}, {}}};
+        case 0xDA:
+          return {{{"pminub", "P,Q", 0}, {"pminub", "V,W", 0}, {}, {}}};
+        case 0xDB:
+          return {{{"pand", "P,Q", 0}, {"pand", "V,W", 0}, {}, {}}};
+        case 0xDE:
+          return {{{"pmaxub", "P,Q", 0}, {"pmaxub", "V,W", 0}, {}, {}}};
+        case 0xDF:
+          return {{{"pandn", "P,Q", 0}, {"pandn", "V,W", 0}, {}, {}}};
+        case 0xE7:
+          return {{{"movntq", "M,P", 0}, {"movntdq", "M,V", 0}, {}, {}}};
+        case 0xEB:
+          return {{{"por", "P,Q", 0}, {"por", "V,W", 0}, {}, {}}};
+        case 0xEF:
+          return {{{"pxor", "P,Q", 0}, {"pxor", "V,W", 0}, {}, {}}};
+        case 0xF8:
+          return {{{"psubb", "P,Q", 0}, {"psubb", "V,W", 0}, {}, {}}};
+        case 0xF9:
+          return {{{"psubw", "P,Q", 0}, {"psubw", "V,W", 0}, {}, {}}};
+        case 0xFA:
+          return {{{"psubd", "P,Q", 0}, {"psubd", "V,W", 0}, {}, {}}};
+        case 0xFB:
+          return {{{"psubq", "P,Q", 0}, {"psubq", "V,W", 0}, {}, {}}};
+        case 0xFC:
+          return {{{"paddb", "P,Q", 0}, {"paddb", "V,W", 0}, {}, {}}};
+        case 0xFD:
+          return {{{"paddw", "P,Q", 0}, {"paddw", "V,W", 0}, {}, {}}};
+        case 0xFE:
+          return {{{"paddd", "P,Q", 0}, {"paddd", "V,W", 0}, {}, {}}};
+        default:
+          return {};
+      }
+    }
+
+    // VEX encoded opcodes (map 1 = 0F, 2 = 0F38, 3 = 0F3A), selected by the implied prefix
+    SseEntry vexEntry(unsigned map, std::uint8_t op) {
+      if (map == 1) {
+        switch (op) {
+          case 0x10:
+            return {{{"vmovups", "V,W", 0}, {"vmovupd", "V,W", 0}, {"vmovss", "V,W", 0}, {"vmovsd", "V,W", 0}}};
+          case 0x11:
+            return {{{"vmovups", "W,V", 0}, {"vmovupd", "W,V", 0}, {"vmovss", "W,V", 0}, {"vmovsd", "W,V", 0}}};
+          case 0x12:
+            return {{{}, {}, {"vmovsldup", "V,W", 0}, {"vmovddup", "V,W", 0}}};
+          case 0x14:
+            return {{{"vunpcklps", "V,H,W", 0}, {"vunpcklpd", "V,H,W", 0}, {}, {}}};
+          case 0x15:
+            return {{{"vunpckhps", "V,H,W", 0}, {"vunpckhpd", "V,H,W", 0}, {}, {}}};
+          case 0x28:
+            return {{{"vmovaps", "V,W", 0}, {"vmovapd", "V,W", 0}, {}, {}}};
+          case 0x29:
+            return {{{"vmovaps", "W,V", 0}, {"vmovapd", "W,V", 0}, {}, {}}};
+          case 0x2A:
+            return {{{}, {}, {"vcvtsi2ss", "V,H,Ey", F_SUFFIX}, {"vcvtsi2sd", "V,H,Ey", F_SUFFIX}}};
+          case 0x2C:
+            return {{{}, {}, {"vcvttss2si", "Gy,W", 0}, {"vcvttsd2si", "Gy,W", 0}}};
+          case 0x2D:
+            return {{{}, {}, {"vcvtss2si", "Gy,W", 0}, {"vcvtsd2si", "Gy,W", 0}}};
+          case 0x2E:
+            return {{{"vucomiss", "V,W", 0}, {"vucomisd", "V,W", 0}, {}, {}}};
+          case 0x2F:
+            return {{{"vcomiss", "V,W", 0}, {"vcomisd", "V,W", 0}, {}, {}}};
+          case 0x51:
+            return {{{"vsqrtps", "V,W", 0}, {"vsqrtpd", "V,W", 0}, {"vsqrtss", "V,H,W", 0}, {"vsqrtsd", "V,H,W", 0}}};
+          case 0x54:
+            return {{{"vandps", "V,H,W", 0}, {"vandpd", "V,H,W", 0}, {}, {}}};
+          case 0x55:
+            return {{{"vandnps", "V,H,W", 0}, {"vandnpd", "V,H,W", 0}, {}, {}}};
+          case 0x56:
+            return {{{"vorps", "V,H,W", 0}, {"vorpd", "V,H,W", 0}, {}, {}}};
+          case 0x5A:
+            return {{{"vcvtps2pd", "V,W", 0}, {"vcvtpd2ps", "V,W", 0}, {"vcvtss2sd", "V,H,W", 0},
+                     {"vcvtsd2ss", "V,H,W", 0}}};
+          case 0x5D:
+            return {{{"vminps", "V,H,W", 0}, {"vminpd", "V,H,W", 0}, {"vminss", "V,H,W", 0}, {"vminsd", "V,H,W", 0}}};
+          case 0x5F:
+            return {{{"vmaxps", "V,H,W", 0}, {"vmaxpd", "V,H,W", 0}, {"vmaxss", "V,H,W", 0}, {"vmaxsd", "V,H,W", 0}}};
+          case 0x57:
+            return {{{"vxorps", "V,H,W", 0}, {"vxorpd", "V,H,W", 0}, {}, {}}};
+          case 0x58:
+            return {{{"vaddps", "V,H,W", 0}, {"vaddpd", "V,H,W", 0}, {"vaddss", "V,H,W", 0}, {"vaddsd", "V,H,W", 0}}};
+          case 0x59:
+            return {{{"vmulps", "V,H,W", 0}, {"vmulpd", "V,H,W", 0}, {"vmulss", "V,H,W", 0}, {"vmulsd", "V,H,W", 0}}};
+          case 0x5C:
+            return {{{"vsubps", "V,H,W", 0}, {"vsubpd", "V,H,W", 0}, {"vsubss", "V,H,W", 0}, {"vsubsd", "V,H,W", 0}}};
+          case 0x5E:
+            return {{{"vdivps", "V,H,W", 0}, {"vdivpd", "V,H,W", 0}, {"vdivss", "V,H,W", 0}, {"vdivsd", "V,H,W", 0}}};
+          case 0x6E:
+            return {{{}, {"vmovd", "V,Ey", 0}, {}, {}}};
+          case 0x6F:
+            return {{{}, {"vmovdqa", "V,W", 0}, {"vmovdqu", "V,W", 0}, {}}};
+          case 0x64:
+            return {{{}, {"vpcmpgtb", "V,H,W", 0}, {}, {}}};
+          case 0x65:
+            return {{{}, {"vpcmpgtw", "V,H,W", 0}, {}, {}}};
+          case 0x66:
+            return {{{}, {"vpcmpgtd", "V,H,W", 0}, {}, {}}};
+          case 0x74:
+            return {{{}, {"vpcmpeqb", "V,H,W", 0}, {}, {}}};
+          case 0x75:
+            return {{{}, {"vpcmpeqw", "V,H,W", 0}, {}, {}}};
+          case 0x76:
+            return {{{}, {"vpcmpeqd", "V,H,W", 0}, {}, {}}};
+          case 0x7E:
+            return {{{}, {"vmovd", "Ey,V", 0}, {"vmovq", "V,W", 0}, {}}};
+          case 0x7F:
+            return {{{}, {"vmovdqa", "W,V", 0}, {"vmovdqu", "W,V", 0}, {}}};
+          case 0xD6:
+            return {{{}, {"vmovq", "W,V", 0}, {}, {}}};
+          case 0xD7:
+            return {{{}, {"vpmovmskb", "Gd,U", 0}, {}, {}}};
+          case 0xDA:
+            return {{{}, {"vpminub", "V,H,W", 0}, {}, {}}};
+          case 0xDB:
+            return {{{}, {"vpand", "V,H,W", 0}, {}, {}}};
+          case 0xDE:
+            return {{{}, {"vpmaxub", "V,H,W", 0}, {}, {}}};
+          case 0xDF:
+            return {{{}, {"vpandn", "V,H,W", 0}, {}, {}}};
+          case 0xE7:
+            return {{{}, {"vmovntdq", "M,V", 0}, {}, {}}};
+          case 0xEB:
+            return {{{}, {"vpor", "V,H,W", 0}, {}, {}}};
+          case 0xEF:
+            return {{{}, {"vpxor", "V,H,W", 0}, {}, {}}};
+          case 0xF8:
+            return {{{}, {"vpsubb", "V,H,W", 0}, {}, {}}};
+          case 0xFC:
+            return {{{}, {"vpaddb", "V,H,W", 0}, {}, {}}};
+          case 0xFE:
+            return {{{}, {"vpaddd", "V,H,W", 0}, {}, {}}};
+          default:
+            return {};
+        }
+      }
+      if (map == 2) {
+        switch (op) {
+          case 0x00:
+            return {{{}, {"vpshufb", "V,H,W", 0}, {}, {}}};
+          case 0x17:
+            return {{{}, {"vptest", "V,W", 0}, {}, {}}};
+          case 0x18:
+            return {{{}, {"vbroadcastss", "V,Wx", 0}, {}, {}}};
+          case 0x39:
+            return {{{}, {"vpminsd", "V,H,W", 0}, {}, {}}};
+          case 0x3A:
+            return {{{}, {"vpminuw", "V,H,W", 0}, {}, {}}};
+          case 0x3B:
+            return {{{}, {"vpminud", "V,H,W", 0}, {}, {}}};
+          case 0x58:
+            return {{{}, {"vpbroadcastd", "V,Wx", 0}, {}, {}}};
+          case 0x59:
+            return {{{}, {"vpbroadcastq", "V,Wx", 0}, {}, {}}};
+          case 0x78:
+            return {{{}, {"vpbroadcastb", "V,Wx", 0}, {}, {}}};
+          case 0x79:
+            return {{{}, {"vpbroadcastw", "V,Wx", 0}, {}, {}}};
+          case 0xF2:
+            return {{{"andn", "Gy,By,Ey", 0}, {}, {}, {}}};
+          case 0xF5:
+            return {{{"bzhi", "Gy,Ey,By", 0}, {}, {"pext", "Gy,By,Ey", 0}, {"pdep", "Gy,By,Ey", 0}}};
+          case 0xF6:
+            return {{{}, {}, {}, {"mulx", "By,Gy,Ey", 0}}};
+          case 0xF7:
+            return {{{"bextr", "Gy,Ey,By", 0}, {"shlx", "Gy,Ey,By", 0}, {"sarx", "Gy,Ey,By", 0},
+                     {"shrx", "Gy,Ey,By", 0}}};
+          default:
+            return {};
+        }
+      }
+      switch (op) {
+        case 0x04:
+          return {{{}, {"vpermilps", "V,W,Ib", 0}, {}, {}}};
+        case 0x05:
+          return {{{}, {"vpermilpd", "V,W,Ib", 0}, {}, {}}};
+        case 0x08:
+          return {{{}, {"vroundps", "V,W,Ib", 0}, {}, {}}};
+        case 0x09:
+          return {{{}, {"vroundpd", "V,W,Ib", 0}, {}, {}}};
+        case 0x0A:
+          return {{{}, {"vroundss", "V,H,W,Ib", 0}, {}, {}}};
+        case 0x0B:
+          return {{{}, {"vroundsd", "V,H,W,Ib", 0}, {}, {}}};
+        case 0x0F:
+          return {{{}, {"vpalignr", "V,H,W,Ib", 0}, {}, {}}};
+        case 0x18:
+          return {{{}, {"vinsertf128", "V,H,W,Ib", 0}, {}, {}}};
+        case 0x17:
+          return {{{}, {"vextractps", "Ed,V,Ib", 0}, {}, {}}};
+        case 0x19:
+          return {{{}, {"vextractf128", "W,V,Ib", 0}, {}, {}}};
+        case 0x38:
+          return {{{}, {"vinserti128", "V,H,W,Ib", 0}, {}, {}}};
+        case 0x39:
+          return {{{}, {"vextracti128", "W,V,Ib", 0}, {}, {}}};
+        case 0x63:
+          return {{{}, {"vpcmpistri", "V,W,Ib", 0}, {}, {}}};
+        case 0xF0:
+          return {{{}, {}, {}, {"rorx", "Gy,Ey,Ib", 0}}};
+        default:
+          return {};
+      }
+    }
+
+#pragma endregion
+
+    class Decoder {
+    private:
+        const std::uint8_t *code;
+        std::size_t size;
+        std::size_t pos = 0;
+        addr_t address;
+        bool truncated = false;
+
+        // Prefixes
+        bool operandSize16 = false, addressSize32 = false, repz = false, repnz = false, lock = false;
+        int extraOperandSize = 0;
+        int segment = -1;
+        std::uint8_t rex = 0;
+
+        // VEX & EVEX
+        bool vex = false;
+        bool evex = false;
+        unsigned vectorBits = 128;
+        unsigned vexRegister = 0;
+        unsigned evexRegisterHigh = 0, evexRmHigh = 0, evexMask = 0;
+        bool evexZeroing = false, evexBroadcast = false;
+        unsigned evexDisp8Scale = 1;
+
+        // ModRM
+        bool hasModrm = false;
+        std::uint8_t mod = 0, reg = 0, rm = 0;
+        std::string memory;
+        bool ripRelative = false;
+        std::size_t ripDisplacement = 0; // offset of the RIP-relative disp32
+        bool invalidOperand = false;
+        std::int64_t displacement = 0;
+
+        // Operands
+        unsigned flags = 0;
+        bool mandatoryPrefix = false;
+        bool registerOperand = false;
+        bool memoryOperand = false;
+        unsigned memorySize = 0;
+        std::optional<addr_t> target;
+
+        [[nodiscard]] bool rexW() const { return rex & 8; }
+
+        [[nodiscard]] unsigned rexR() const { return (rex & 4) ? 8 : 0; }
+
+        [[nodiscard]] unsigned rexX() const { return (rex & 2) ? 8 : 0; }
+
+        [[nodiscard]] unsigned rexB() const { return (rex & 1) ? 8 : 0; }
+
+        std::uint8_t next() {
+          if (pos >= size || pos >= max_instruction_length) {
+            truncated = true;
+            return 0;
+          }
+          return code[pos++];
+        }
+
+        std::int64_t readSigned(unsigned bytes) {
+          std::uint64_t value = 0;
+          for (unsigned i = 0; i < bytes; i++)
+            value |= (std::uint64_t) next() << (8 * i);
+          if (bytes < 8 && (value >> (8 * bytes - 1)) & 1)
+            value |= ~0ULL << (8 * bytes);
+          return (std::int64_t) value;
+        }
+
+        [[nodiscard]] unsigned operandSize() const {
+          if (rexW()) return 64;
+          if (flags & F_D64) return operandSize16 ? 16 : 64;
+          return operandSize16 ? 16 : 32;
+        }
+
+        static std::string hex(std::uint64_t value) {
+          char buffer[24];
+          snprintf(buffer, sizeof(buffer), "0x%lx", value);
+          return buffer;
+        }
+
+        static std::string signedHex(std::int64_t value) {
+          if (value < 0) return "-" + hex((std::uint64_t) -value);
+          return hex((std::uint64_t) value);
+        }
+
+        static std::uint64_t truncate(std::int64_t value, unsigned bits) {
+          if (bits >= 64) return (std::uint64_t) value;
+          return (std::uint64_t) value & ((1ULL << bits) - 1);
+        }
+
+        [[nodiscard]] std::string generalRegister(unsigned index, unsigned bits) const {
+          std::string name = "%";
+          switch (bits) {
+            case 8:
+              return name + ((rex != 0 || index >= 8) ? reg8Rex[index] : reg8Legacy[index & 7]);
+            case 16:
+              return name + reg16[index];
+            case 32:
+              return name + reg32[index];
+            default:
+              return name + reg64[index];
+          }
+        }
+
+        [[nodiscard]] std::string vectorRegister(unsigned index, bool forceXmm = false) const {
+          auto bits = forceXmm ? 128 : vectorBits;
+          return std::string(bits == 512 ? "%zmm" : bits == 256 ? "%ymm" : "%xmm") + std::to_string(index);
+        }
+
+        void readModrm() {
+          if (hasModrm) return;
+          hasModrm = true;
+          auto byte = next();
+          mod = byte >> 6;
+          reg = (byte >> 3) & 7;
+          rm = byte & 7;
+          if (mod == 3) return;
+
+          const char *const *names = addressSize32 ? reg32 : reg64;
+          std::string base, index;
+          unsigned scale = 1;
+          bool hasDisplacement = false;
+
+          if (rm == 4) {
+            auto sib = next();
+            scale = 1u << (sib >> 6);
+            unsigned sibIndex = ((sib >> 3) & 7) | rexX();
+            unsigned sibBase = (sib & 7) | rexB();
+            if (sibIndex != 4) index = std::string("%") + names[sibIndex];
+            if ((sib & 7) == 5 && mod == 0) {
+              displacement = readSigned(4);
+              hasDisplacement = true;
+            } else
+              base = std::string("%") + names[sibBase];
+          } else if (rm == 5 && mod == 0) {
+            ripDisplacement = pos;
+            displacement = readSigned(4);
+            hasDisplacement = true;
+            ripRelative = true;
+            base = addressSize32 ? "%eip" : "%rip";
+          } else
+            base = std::string("%") + names[rm | rexB()];
+
+          if (mod == 1) {
+            // EVEX compressed displacement
+            displacement = readSigned(1) * (evex ? evexDisp8Scale : 1);
+            hasDisplacement = true;
+          } else if (mod == 2) {
+            displacement = readSigned(4);
+            hasDisplacement = true;
+          }
+
+          // es/cs/ss/ds overrides are ignored in long mode, only fs/gs are part of the address
+          if (segment >= 4) memory = std::string("%") + segmentRegs[segment] + ":";
+          if (hasDisplacement) memory += signedHex(displacement);
+          if (!base.empty() || !index.empty()) {
+            memory += "(" + base;
+            if (!index.empty()) memory += "," + index + "," + std::to_string(scale);
+            memory += ")";
+          }
+        }
+
+        /**
+         * @param spec operand specification (Intel manual notation)
+         * @return the AT&T operand
+         */
+        std::string operand(std::string_view spec) {
+          auto kind = spec.front();
+          auto sizeCode = spec.size() > 1 ? spec[1] : 'v';
+          unsigned bits;
+          switch (sizeCode) {
+            case 'b':
+              bits = 8;
+              break;
+            case 'w':
+              bits = 16;
+              break;
+            case 'd':
+              bits = 32;
+              break;
+            case 'q':
+              bits = 64;
+              break;
+            case 'y':
+              bits = rexW() ? 64 : 32;
+              break;
+            default:
+              bits = operandSize();
+          }
+
+          if (spec == "AL") {
+            registerOperand = true;
+            return "%al";
+          }
+          if (spec == "rAX") {
+            registerOperand = true;
+            return generalRegister(0, operandSize());
+          }
+          if (spec == "CL") return "%cl";
+          if (spec == "DX") return "(%dx)";
+          if (spec == "1") return "1";
+
+          switch (kind) {
+            case 'E':
+              readModrm();
+              if (mod == 3) {
+                registerOperand = true;
+                return generalRegister(rm | rexB(), bits);
+              }
+              memoryOperand = true;
+              memorySize = bits;
+              return memory;
+            case 'M':
+              readModrm();
+              if (mod == 3) invalidOperand = true;
+              memoryOperand = true;
+              return memory;
+            case 'G':
+              readModrm();
+              registerOperand = true;
+              return generalRegister(reg | rexR(), bits);
+            case 'B':
+              registerOperand = true;
+              return generalRegister(vexRegister, bits);
+            case 'Z':
+              registerOperand = true;
+              return generalRegister((code[pos - 1] & 7) | rexB(), bits);
+            case 'V':
+              readModrm();
+              return vectorRegister(reg | rexR() | evexRegisterHigh, sizeCode == 'x');
+            case 'H':
+              return vectorRegister(vexRegister, sizeCode == 'x');
+            case 'U':
+            case 'W':
+              readModrm();
+              if (mod == 3) return vectorRegister(rm | rexB() | evexRmHigh, sizeCode == 'x');
+              memoryOperand = true;
+              if (evexBroadcast)
+                return memory + "{1to" + std::to_string(vectorBits / (8 * evexDisp8Scale)) + "}";
+              return memory;
+            case 'K':
+              readModrm();
+              return "%k" + std::to_string(reg);
+            case 'L':
+              return "%k" + std::to_string(vexRegister & 7);
+            case 'k':
+              readModrm();
+              if (mod == 3) return "%k" + std::to_string(rm);
+              memoryOperand = true;
+              return memory;
+            case 'P':
+              readModrm();
+              return "%mm" + std::to_string(reg);
+            case 'N':
+            case 'Q':
+              readModrm();
+              if (mod == 3) return "%mm" + std::to_string(rm);
+              memoryOperand = true;
+              return memory;
+            case 'S':
+              readModrm();
+              registerOperand = true;
+              return std::string("%") + segmentRegs[reg];
+            case 'I': {
+              if (sizeCode == 'b') return "$" + hex(truncate(readSigned(1), 8));
+              if (sizeCode == 'w') return "$" + hex(truncate(readSigned(2), 16));
+              if (sizeCode == 'v' && operandSize() == 64) return "$" + hex((std::uint64_t) readSigned(8));
+              auto size_bits = operandSize();
+              auto value = readSigned(size_bits == 16 ? 2 : 4);
+              return "$" + hex(truncate(value, size_bits));
+            }
+            case 's': // Sign-extended imm8
+              return "$" + hex(truncate(readSigned(1), operandSize()));
+            case 'J': {
+              auto relative = readSigned(sizeCode == 'b' ? 1 : 4);
+              target = address + pos + relative;
+              char buffer[24];
+              snprintf(buffer, sizeof(buffer), "%lx", *target);
+              return buffer;
+            }
+            case 'O': {
+              auto offset = (std::uint64_t) readSigned(addressSize32 ? 4 : 8);
+              memoryOperand = true;
+              std::string prefix = segment >= 4 ? std::string("%") + segmentRegs[segment] + ":" : "";
+              return prefix + hex(offset);
+            }
+            default:
+              return "?";
+          }
+        }
+
+        /**
+         * Decodes the operands of an entry, then builds the AT&T form
+         */
+        bool apply(Instruction &ins, const OpcodeEntry &entry) {
+          if (entry.mnemonic == nullptr) return false;
+          flags = entry.flags;
+          std::vector<std::string> operands;
+          std::string_view specs = entry.operands;
+          while (!specs.empty()) {
+            auto comma = specs.find(',');
+            operands.push_back(operand(specs.substr(0, comma)));
+            if (comma == std::string_view::npos) break;
+            specs.remove_prefix(comma + 1);
+          }
+          if (invalidOperand) return false;
+
+          ins.mnemonic = entry.mnemonic;
+          if ((flags & F_SUFFIX) && memoryOperand && !registerOperand) {
+            auto bits = memorySize ? memorySize : operandSize();
+            ins.mnemonic += bits == 8 ? "b" : bits == 16 ? "w" : bits == 32 ? "l" : "q";
+          }
+          if (evex && !operands.empty()) {
+            if (evexMask != 0) operands.front() += "{%k" + std::to_string(evexMask) + "}";
+            if (evexZeroing) operands.front() += "{z}";
+          }
+          for (auto it = operands.rbegin(); it != operands.rend(); it++) {
+            if (!ins.operands.empty()) ins.operands += ",";
+            if (flags & F_INDIRECT) ins.operands += "*";
+            ins.operands += *it;
+          }
+          return true;
+        }
+
+        bool decodeStringOperation(Instruction &ins, std::uint8_t op) {
+          auto bits = (op & 1) ? operandSize() : 8;
+          std::string suffix = bits == 8 ? "b" : bits == 16 ? "w" : bits == 32 ? "l" : "q";
+          std::string accumulator = generalRegister(0, bits);
+          const std::string source = "%ds:(%rsi)", destination = "%es:(%rdi)";
+          switch (op & 0xFE) {
+            case 0xA4:
+              ins.mnemonic = "movs" + suffix;
+              ins.operands = source + "," + destination;
+              break;
+            case 0xA6:
+              ins.mnemonic = "cmps" + suffix;
+              ins.operands = destination + "," + source;
+              break;
+            case 0xAA:
+              ins.mnemonic = "stos";
+              ins.operands = accumulator + "," + destination;
+              break;
+            case 0xAC:
+              ins.mnemonic = "lods";
+              ins.operands = source + "," + accumulator;
+              break;
+            case 0xAE:
+              ins.mnemonic = "scas";
+              ins.operands = destination + "," + accumulator;
+              break;
+            default:
+              return false;
+          }
+          if (repz) ins.mnemonic.insert(0, (op & 0xF6) == 0xA6 ? "repz " : "rep ");
+          if (repnz) ins.mnemonic.insert(0, "repnz ");
+          repz = repnz = false;
+          return true;
+        }
+
+        bool decodeX87(Instruction &ins, std::uint8_t op) {
+          readModrm();
+          static constexpr const char *memoryForms[8][8] = {
+              {"fadds",  "fmuls",  "fcoms",  "fcomps",  "fsubs",  "fsubrs",  "fdivs",  "fdivrs"},
+              {"flds",   nullptr,  "fsts",   "fstps",   "fldenv", "fldcw",   "fnstenv", "fnstcw"},
+              {"fiaddl", "fimull", "ficoml", "ficompl", "fisubl", "fisubrl", "fidivl", "fidivrl"},
+              {"fildl",  "fisttpl", "fistl", "fistpl",  nullptr,  "fldt",    nullptr,  "fstpt"},
+              {"faddl",  "fmull",  "fcoml",  "fcompl",  "fsubl",  "fsubrl",  "fdivl",  "fdivrl"},
+              {"fldl",   "fisttpll", "fstl", "fstpl",   "frstor", nullptr,   "fnsave", "fnstsw"},
+              {"fiadds", "fimuls", "ficoms", "ficomps", "fisubs", "fisubrs", "fidivs", "fidivrs"},
+              {"filds",  "fisttps", "fists", "fistps",  "fbld",   "fildll",  "fbstp",  "fistpll"},
+          };
+          auto group = op - 0xD8;
+          if (mod != 3) {
+            if (memoryForms[group][reg] == nullptr) return false;
+            ins.mnemonic = memoryForms[group][reg];
+            ins.operands = memory;
+            return true;
+          }
+          auto st = "%st(" + std::to_string(rm) + ")";
+          auto modrm = code[pos - 1];
+          switch (op) {
+            case 0xD8: {
+              static constexpr const char *names[8] = {"fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv",
+                                                       "fdivr"};
+              ins.mnemonic = names[reg];
+              ins.operands = st + ",%st";
+              return true;
+            }
+            case 0xD9:
+              if (reg == 0) {
+                ins.mnemonic = "fld";
+                ins.operands = st;
+                return true;
+              }
+              if (reg == 1) {
+                ins.mnemonic = "fxch";
+                ins.operands = st;
+                return true;
+              }
+              if (modrm >= 0xF0) {
+                static constexpr const char *names[16] = {"f2xm1", "fyl2x", "fptan", "fpatan", "fxtract", "fprem1",
+                                                          "fdecstp", "fincstp", "fprem", "fyl2xp1", "fsqrt",
+                                                          "fsincos", "frndint", "fscale", "fsin", "fcos"};
+                ins.mnemonic = names[modrm - 0xF0];
+                return true;
+              }
+              if (modrm >= 0xE8 && modrm <= 0xEE) {
+                static constexpr const char *names[7] = {"fld1", "fldl2t", "fldl2e", "fldpi", "fldlg2", "fldln2",
+                                                         "fldz"};
+                ins.mnemonic = names[modrm - 0xE8];
+                return true;
+              }
+              switch (modrm) {
+                case 0xD0:
+                  ins.mnemonic = "fnop";
+                  return true;
+                case 0xE0:
+                  ins.mnemonic = "fchs";
+                  return true;
+                case 0xE1:
+                  ins.mnemonic = "fabs";
+                  return true;
+                case 0xE4:
+                  ins.mnemonic = "ftst";
+                  return true;
+                case 0xE5:
+                  ins.mnemonic = "fxam";
+                  return true;
+                case 0xE8:
+                  ins.mnemonic = "fld1";
+                  return true;
+                case 0xEE:
+                  ins.mnemonic = "fldz";
+                  return true;
+                case 0xFA:
+                  ins.mnemonic = "fsqrt";
+                  return true;
+                case 0xFC:
+                  ins.mnemonic = "frndint";
+                  return true;
+                default:
+                  return false;
+              }
+            case 0xDA:
+              if (reg < 4) {
+                static constexpr const char *names[4] = {"fcmovb", "fcmove", "fcmovbe", "fcmovu"};
+                ins.mnemonic = names[reg];
+                ins.operands = st + ",%st";
+                return true;
+              }
+              if (modrm == 0xE9) {
+                ins.mnemonic = "fucompp";
+                return true;
+              }
+              return false;
+            case 0xDB:
+              if (reg < 4) {
+                static constexpr const char *names[4] = {"fcmovnb", "fcmovne", "fcmovnbe", "fcmovnu"};
+                ins.mnemonic = names[reg];
+                ins.operands = st + ",%st";
+                return true;
+              }
+              if (reg == 5 || reg == 6) {
+                ins.mnemonic = reg == 5 ? "fucomi" : "fcomi";
+                ins.operands = st + ",%st";
+                return true;
+              }
+              if (modrm == 0xE2) {
+                ins.mnemonic = "fnclex";
+                return true;
+              }
+              if (modrm == 0xE3) {
+                ins.mnemonic = "fninit";
+                return true;
+              }
+              return false;
+            case 0xDC: {
+              static constexpr const char *names[8] = {"fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv",
+                                                       "fdivr"};
+              ins.mnemonic = names[reg];
+              ins.operands = "%st," + st;
+              return true;
+            }
+            case 0xDD:
+              if (reg == 0 || reg == 2 || reg == 3 || reg == 4 || reg == 5) {
+                static constexpr const char *names[8] = {"ffree", nullptr, "fst", "fstp", "fucom", "fucomp"};
+                ins.mnemonic = names[reg];
+                ins.operands = st;
+                return true;
+              }
+              return false;
+            case 0xDE: {
+              if (modrm == 0xD9) {
+                ins.mnemonic = "fcompp";
+                return true;
+              }
+              static constexpr const char *names[8] = {"faddp", "fmulp", nullptr, nullptr, "fsubp", "fsubrp",
+                                                       "fdivp", "fdivrp"};
+              if (names[reg] == nullptr) return false;
+              ins.mnemonic = names[reg];
+              ins.operands = "%st," + st;
+              return true;
+            }
+            case 0xDF:
+              if (reg == 0) {
+                ins.mnemonic = "ffreep";
+                ins.operands = st;
+                return true;
+              }
+              if (modrm == 0xE0) {
+                ins.mnemonic = "fnstsw";
+                ins.operands = "%ax";
+                return true;
+              }
+              if (reg == 5 || reg == 6) {
+                ins.mnemonic = reg == 5 ? "fucomip" : "fcomip";
+                ins.operands = st + ",%st";
+                return true;
+              }
+              return false;
+            default:
+              return false;
+          }
+        }
+
+        /**
+         * FMA3: vf[n]madd/vf[n]msub/vfmaddsub/vfmsubadd {132,213,231} {ps,pd,ss,sd}
+         */
+        bool decodeFma(Instruction &ins, std::uint8_t op) {
+          static constexpr const char *names[10] = {"vfmaddsub", "vfmsubadd", "vfmadd", "vfmadd", "vfmsub", "vfmsub",
+                                                    "vfnmadd", "vfnmadd", "vfnmsub", "vfnmsub"};
+          auto low = op & 0xF;
+          auto order = (op >> 4) == 9 ? "132" : (op >> 4) == 0xA ? "213" : "231";
+          bool scalar = low >= 8 && (low & 1);
+          std::string name = std::string(names[low - 6]) + order + (scalar ? "s" : "p") + (rexW() ? "d" : "s");
+          return apply(ins, {name.c_str(), "V,H,W", 0});
+        }
+
+        /**
+         * cmpps/cmppd/cmpss/cmpsd (& VEX forms), the predicate is part of the mnemonic
+         */
+        bool decodeCompare(Instruction &ins, unsigned variant, bool vexEncoded) {
+          static constexpr const char *predicates[32] = {
+              "eq", "lt", "le", "unord", "neq", "nlt", "nle", "ord", "eq_uq", "nge", "ngt", "false", "neq_oq", "ge",
+              "gt", "true", "eq_os", "lt_oq", "le_oq", "unord_s", "neq_us", "nlt_uq", "nle_uq", "ord_s", "eq_us",
+              "nge_uq", "ngt_uq", "false_os", "neq_os", "ge_oq", "gt_oq", "true_us"};
+          static constexpr const char *types[4] = {"ps", "pd", "ss", "sd"};
+          readModrm();
+          // The predicate is the last byte, after the memory operand
+          std::size_t immediatePosition = pos;
+          std::string operands = vexEncoded ? "V,H,W" : "V,W";
+          auto result = apply(ins, {"cmp", operands.c_str(), 0});
+          if (!result || immediatePosition >= size) return false;
+          auto predicate = next();
+          if (predicate >= (vexEncoded ? 32 : 8)) {
+            ins.mnemonic = std::string(vexEncoded ? "vcmp" : "cmp") + types[variant];
+            ins.operands.insert(0, "$" + hex(predicate) + ",");
+          } else
+            ins.mnemonic = std::string(vexEncoded ? "vcmp" : "cmp") + predicates[predicate] + types[variant];
+          if (variant != 0) mandatoryPrefix = true;
+          if (variant == 2) repz = false;
+          if (variant == 3) repnz = false;
+          return true;
+        }
+
+        bool decodeVex(Instruction &ins, std::uint8_t first) {
+          unsigned map, impliedPrefix;
+          auto byte1 = next();
+          if (first == 0xC5) {
+            rex = 0x40 | ((byte1 & 0x80) ? 0 : 4);
+            map = 1;
+          } else {
+            auto byte2 = next();
+            rex = 0x40 | ((~byte1 >> 5) & 7) | ((byte2 & 0x80) ? 8 : 0);
+            map = byte1 & 0x1F;
+            byte1 = byte2;
+          }
+          vex = true;
+          vexRegister = (~byte1 >> 3) & 0xF;
+          vectorBits = (byte1 & 4) ? 256 : 128;
+          impliedPrefix = byte1 & 3;
+          if (map < 1 || map > 3) return false;
+          auto op = next();
+
+          if (map == 1 && op == 0x77) {
+            ins.mnemonic = vectorBits == 256 ? "vzeroall" : "vzeroupper";
+            return true;
+          }
+          if (map == 1 && ((op >= 0x41 && op <= 0x4B) || (op >= 0x90 && op <= 0x93) || op == 0x98 || op == 0x99))
+            return decodeMaskOperation(ins, op, impliedPrefix);
+          if (map == 2 && op == 0xF3) {
+            readModrm();
+            static constexpr const char *names[8] = {nullptr, "blsr", "blsmsk", "blsi"};
+            if (reg > 3 || names[reg] == nullptr) return false;
+            return apply(ins, {names[reg], "By,Ey", 0});
+          }
+          // 66 -> 1, F3 -> 2, F2 -> 3: same layout as SseEntry
+          if (map == 2 && ((op >= 0x96 && op <= 0x9F) || (op >= 0xA6 && op <= 0xAF) || (op >= 0xB6 && op <= 0xBF)))
+            return decodeFma(ins, op);
+          if (map == 1 && op == 0xC2) return decodeCompare(ins, impliedPrefix, true);
+          if (map == 1 && op == 0xAE) {
+            readModrm();
+            if (mod == 3 || (reg != 2 && reg != 3)) return false;
+            return apply(ins, {reg == 2 ? "vldmxcsr" : "vstmxcsr", "M", 0});
+          }
+          if (map == 3 && impliedPrefix == 1 && ((op >= 0x68 && op <= 0x6F) || (op >= 0x78 && op <= 0x7F))) {
+            // AMD FMA4, W selects whether the ModRM or the imm8[7:4] register is the last source
+            static constexpr const char *names[8] = {"vfmaddps", "vfmaddpd", "vfmaddss", "vfmaddsd",
+                                                     "vfmsubps", "vfmsubpd", "vfmsubss", "vfmsubsd"};
+            std::string name = names[op & 7];
+            if (op >= 0x78) name.insert(2, "n");
+            flags = 0;
+            auto destination = operand("V");
+            auto source = operand("H");
+            auto modrmSource = operand("W");
+            auto extra = vectorRegister(next() >> 4);
+            ins.mnemonic = name;
+            ins.operands = rexW() ? modrmSource + "," + extra : extra + "," + modrmSource;
+            ins.operands += "," + source + "," + destination;
+            return true;
+          }
+          if (map == 3 && op >= 0x4A && op <= 0x4C) {
+            // Fourth register operand in imm8[7:4]
+            static constexpr const char *names[3] = {"vblendvps", "vblendvpd", "vpblendvb"};
+            if (impliedPrefix != 1) return false;
+            if (!apply(ins, {names[op - 0x4A], "V,H,W", 0})) return false;
+            ins.operands.insert(0, vectorRegister(next() >> 4) + ",");
+            return true;
+          }
+
+          if (map == 1 && impliedPrefix == 1 && op >= 0x71 && op <= 0x73) {
+            static constexpr const char *shifts[3][8] = {
+                {nullptr, nullptr, "vpsrlw", nullptr, "vpsraw", nullptr, "vpsllw", nullptr},
+                {nullptr, nullptr, "vpsrld", nullptr, "vpsrad", nullptr, "vpslld", nullptr},
+                {nullptr, nullptr, "vpsrlq", "vpsrldq", nullptr, nullptr, "vpsllq", "vpslldq"},
+            };
+            readModrm();
+            auto name = shifts[op - 0x71][reg];
+            if (name == nullptr || mod != 3) return false;
+            return apply(ins, {name, "H,U,Ib", 0});
+          }
+          if (map == 2 && impliedPrefix == 1 && op >= 0xDB && op <= 0xDF) {
+            static constexpr const char *names[5] = {"vaesimc", "vaesenc", "vaesenclast", "vaesdec", "vaesdeclast"};
+            return apply(ins, {names[op - 0xDB], op == 0xDB ? "V,W" : "V,H,W", 0});
+          }
+
+          auto entry = vexEntry(map, op).variants[impliedPrefix];
+          // Packed integer operations are the SSE2 ones with an extra source
+          std::string integerName;
+          if (entry.mnemonic == nullptr && map == 1 && impliedPrefix == 1) {
+            auto legacy = sseEntry(op).variants[1];
+            if (legacy.mnemonic != nullptr && legacy.mnemonic[0] == 'p' && std::string_view(legacy.operands) == "V,W") {
+              integerName = std::string("v") + legacy.mnemonic;
+              entry = {integerName.c_str(), "V,H,W", 0};
+            }
+          }
+          if (entry.mnemonic == nullptr) {
+            // Keep the length right for unknown opcodes
+            readModrm();
+            if (map == 3 || (map == 1 && ((op >= 0x70 && op <= 0x73) || (op >= 0xC4 && op <= 0xC6)))) next();
+            ins.mnemonic = "(bad)";
+            return !truncated;
+          }
+          // Register to register scalar moves take the upper part from vvvv
+          if (map == 1 && (op == 0x10 || op == 0x11) && impliedPrefix >= 2) {
+            readModrm();
+            if (mod == 3) return apply(ins, {entry.mnemonic, op == 0x10 ? "V,H,U" : "U,H,V", 0});
+          }
+          if (std::string_view(entry.mnemonic) == "vmovd" && rexW()) entry.mnemonic = "vmovq";
+          return apply(ins, entry);
+        }
+
+        /**
+         * AVX-512 opmask instructions (VEX encoded)
+         */
+        bool decodeMaskOperation(Instruction &ins, std::uint8_t op, unsigned impliedPrefix) {
+          // none/W0 -> w, none/W1 -> q, 66/W0 -> b, 66/W1 -> d
+          auto width = [this](unsigned prefix) -> const char * {
+              if (prefix == 0) return rexW() ? "q" : "w";
+              if (prefix == 1) return rexW() ? "d" : "b";
+              return nullptr;
+          };
+          std::string name;
+          const char *operands;
+          switch (op) {
+            case 0x4B:
+              if (impliedPrefix == 1 && !rexW()) name = "kunpckbw";
+              else if (impliedPrefix == 0) name = rexW() ? "kunpckdq" : "kunpckwd";
+              else return false;
+              return apply(ins, {name.c_str(), "K,L,k", 0});
+            case 0x90:
+            case 0x91:
+              if (width(impliedPrefix) == nullptr) return false;
+              name = std::string("kmov") + width(impliedPrefix);
+              return apply(ins, {name.c_str(), op == 0x90 ? "K,k" : "k,K", 0});
+            case 0x92:
+            case 0x93:
+              if (impliedPrefix == 3) name = rexW() ? "kmovq" : "kmovd";
+              else if (impliedPrefix == 0 && !rexW()) name = "kmovw";
+              else if (impliedPrefix == 1 && !rexW()) name = "kmovb";
+              else return false;
+              rex &= ~8;
+              operands = op == 0x92 ? "K,Ey" : "Gd,k";
+              if (name == "kmovq") operands = op == 0x92 ? "K,Eq" : "Gq,k";
+              return apply(ins, {name.c_str(), operands, 0});
+            case 0x98:
+            case 0x99:
+              if (width(impliedPrefix) == nullptr) return false;
+              name = std::string(op == 0x98 ? "kortest" : "ktest") + width(impliedPrefix);
+              return apply(ins, {name.c_str(), "K,k", 0});
+            default: {
+              static constexpr const char *names[11] = {"kand", "kandn", nullptr, "knot", "kor", "kxnor", "kxor",
+                                                        nullptr, nullptr, "kadd", nullptr};
+              auto base = names[op - 0x41];
+              if (base == nullptr || width(impliedPrefix) == nullptr) return false;
+              name = std::string(base) + width(impliedPrefix);
+              return apply(ins, {name.c_str(), op == 0x44 ? "K,k" : "K,L,k", 0});
+            }
+          }
+        }
+
+        struct EvexEntry {
+            const char *w0;
+            const char *w1;
+            const char *operands;
+            unsigned tuple; // Memory operand size in bytes when it isn't a full vector (disp8 scale)
+        };
+
+        /**
+         * EVEX encoded opcodes (AVX-512), selected by map, implied prefix & opcode
+         */
+        static EvexEntry evexEntry(unsigned map, unsigned impliedPrefix, std::uint8_t op) {
+          switch ((map << 16) | (impliedPrefix << 8) | op) {
+            case 0x10010:
+              return {"vmovups", nullptr, "V,W", 0};
+            case 0x10110:
+              return {nullptr, "vmovupd", "V,W", 0};
+            case 0x10011:
+              return {"vmovups", nullptr, "W,V", 0};
+            case 0x10111:
+              return {nullptr, "vmovupd", "W,V", 0};
+            case 0x10028:
+              return {"vmovaps", nullptr, "V,W", 0};
+            case 0x10029:
+              return {"vmovaps", nullptr, "W,V", 0};
+            case 0x1016F:
+              return {"vmovdqa32", "vmovdqa64", "V,W", 0};
+            case 0x1026F:
+              return {"vmovdqu32", "vmovdqu64", "V,W", 0};
+            case 0x1036F:
+              return {"vmovdqu8", "vmovdqu16", "V,W", 0};
+            case 0x1017F:
+              return {"vmovdqa32", "vmovdqa64", "W,V", 0};
+            case 0x1027F:
+              return {"vmovdqu32", "vmovdqu64", "W,V", 0};
+            case 0x1037F:
+              return {"vmovdqu8", "vmovdqu16", "W,V", 0};
+            case 0x10164:
+              return {"vpcmpgtb", nullptr, "K,H,W", 0};
+            case 0x10174:
+              return {"vpcmpeqb", nullptr, "K,H,W", 0};
+            case 0x10175:
+              return {"vpcmpeqw", nullptr, "K,H,W", 0};
+            case 0x10176:
+              return {"vpcmpeqd", nullptr, "K,H,W", 0};
+            case 0x1016E:
+              return {"vmovd", "vmovq", "Vx,Ey", 4};
+            case 0x1017E:
+              return {"vmovd", "vmovq", "Ey,Vx", 4};
+            case 0x1027E:
+              return {nullptr, "vmovq", "Vx,Wx", 8};
+            case 0x101D6:
+              return {nullptr, "vmovq", "Wx,Vx", 8};
+            case 0x101D4:
+              return {nullptr, "vpaddq", "V,H,W", 0};
+            case 0x101DA:
+              return {"vpminub", "vpminub", "V,H,W", 0};
+            case 0x101DB:
+              return {"vpandd", "vpandq", "V,H,W", 0};
+            case 0x101DE:
+              return {"vpmaxub", "vpmaxub", "V,H,W", 0};
+            case 0x101DF:
+              return {"vpandnd", "vpandnq", "V,H,W", 0};
+            case 0x101E7:
+              return {"vmovntdq", nullptr, "M,V", 0};
+            case 0x101EB:
+              return {"vpord", "vporq", "V,H,W", 0};
+            case 0x101EF:
+              return {"vpxord", "vpxorq", "V,H,W", 0};
+            case 0x101F8:
+              return {"vpsubb", "vpsubb", "V,H,W", 0};
+            case 0x101FC:
+              return {"vpaddb", "vpaddb", "V,H,W", 0};
+            case 0x101FE:
+              return {"vpaddd", nullptr, "V,H,W", 0};
+            case 0x20100:
+              return {"vpshufb", "vpshufb", "V,H,W", 0};
+            case 0x20118:
+              return {"vbroadcastss", nullptr, "V,Wx", 4};
+            case 0x20126:
+              return {"vptestmb", "vptestmw", "K,H,W", 0};
+            case 0x20226:
+              return {"vptestnmb", "vptestnmw", "K,H,W", 0};
+            case 0x20127:
+              return {"vptestmd", "vptestmq", "K,H,W", 0};
+            case 0x20227:
+              return {"vptestnmd", "vptestnmq", "K,H,W", 0};
+            case 0x20139:
+              return {"vpminsd", "vpminsq", "V,H,W", 0};
+            case 0x2013A:
+              return {"vpminuw", "vpminuw", "V,H,W", 0};
+            case 0x2013B:
+              return {"vpminud", "vpminuq", "V,H,W", 0};
+            case 0x2013F:
+              return {"vpmaxud", "vpmaxuq", "V,H,W", 0};
+            case 0x20158:
+              return {"vpbroadcastd", nullptr, "V,Wx", 4};
+            case 0x20159:
+              return {nullptr, "vpbroadcastq", "V,Wx", 8};
+            case 0x20164:
+              return {"vpblendmd", "vpblendmq", "V,H,W", 0};
+            case 0x20166:
+              return {"vpblendmb", "vpblendmw", "V,H,W", 0};
+            case 0x20178:
+              return {"vpbroadcastb", nullptr, "V,Wx", 1};
+            case 0x20179:
+              return {"vpbroadcastw", nullptr, "V,Wx", 2};
+            case 0x2017A:
+              return {"vpbroadcastb", nullptr, "V,Ed", 0};
+            case 0x2017B:
+              return {"vpbroadcastw", nullptr, "V,Ed", 0};
+            case 0x2017C:
+              return {"vpbroadcastd", "vpbroadcastq", "V,Ey", 0};
+            case 0x3010F:
+              return {"vpalignr", "vpalignr", "V,H,W,Ib", 0};
+            case 0x30125:
+              return {"vpternlogd", "vpternlogq", "V,H,W,Ib", 0};
+            default:
+              return {nullptr, nullptr, nullptr, 0};
+          }
+        }
+
+        bool decodeEvex(Instruction &ins) {
+          auto p0 = next(), p1 = next(), p2 = next();
+          evex = vex = true;
+          rex = 0x40 | ((~p0 >> 5) & 7) | ((p1 & 0x80) ? 8 : 0);
+          evexRegisterHigh = (p0 & 0x10) ? 0 : 16;
+          evexRmHigh = (p0 & 0x40) ? 0 : 16;
+          auto map = p0 & 7;
+          auto impliedPrefix = p1 & 3;
+          vexRegister = ((~p1 >> 3) & 0xF) | ((p2 & 8) ? 0 : 16);
+          evexZeroing = p2 & 0x80;
+          vectorBits = 128u << ((p2 >> 5) & 3);
+          evexBroadcast = p2 & 0x10;
+          evexMask = p2 & 7;
+          auto op = next();
+
+          // Integer compares with a predicate: vpcmp{eq,lt,le,...}{b,ub,w,uw,d,ud,q,uq}
+          if (map == 3 && impliedPrefix == 1 && (op == 0x1E || op == 0x1F || op == 0x3E || op == 0x3F)) {
+            static constexpr const char *predicates[8] = {"eq", "lt", "le", "false", "neq", "nlt", "nle", "true"};
+            const char *types = (op & 0x20) ? (rexW() ? "w" : "b") : (rexW() ? "q" : "d");
+            evexDisp8Scale = evexBroadcast ? (rexW() ? 8 : 4) : vectorBits / 8;
+            if (evexBroadcast && (op & 0x20)) return false;
+            readModrm();
+            auto predicate = code[pos] & 7;
+            std::string name = std::string("vpcmp") + predicates[predicate] + ((op & 1) ? "" : "u") + types;
+            evexBroadcast = evexBroadcast && mod != 3;
+            if (!apply(ins, {name.c_str(), "K,H,W", 0})) return false;
+            next();
+            return true;
+          }
+
+          auto entry = evexEntry(map, impliedPrefix, op);
+          auto name = rexW() ? entry.w1 : entry.w0;
+          evexDisp8Scale = entry.tuple ? entry.tuple : evexBroadcast ? (rexW() ? 8 : 4) : vectorBits / 8;
+          if (name == nullptr) {
+            readModrm();
+            if (map == 3) next();
+            ins.mnemonic = "(bad)";
+            return !truncated;
+          }
+          if (entry.tuple == 0 && std::string_view(entry.operands).find('W') != std::string_view::npos) {
+            readModrm();
+            evexBroadcast = evexBroadcast && mod != 3;
+          } else
+            evexBroadcast = false;
+          return apply(ins, {name, entry.operands, 0});
+        }
+
+        bool decodeTwoByte(Instruction &ins) {
+          auto op = next();
+
+          if (op == 0x1E && repz && !truncated && pos < size && code[pos] == 0xFA) {
+            next();
+            repz = false;
+            ins.mnemonic = "endbr64";
+            return true;
+          }
+          if (op == 0x1F || op == 0x18 || op == 0x19 || op == 0x1A || op == 0x1B || op == 0x1C || op == 0x1D ||
+              op == 0x1E) {
+            readModrm();
+            if (op == 0x18 && mod != 3 && reg < 4) {
+              static constexpr const char *names[4] = {"prefetchnta", "prefetcht0", "prefetcht1", "prefetcht2"};
+              ins.mnemonic = names[reg];
+              ins.operands = memory;
+              return true;
+            }
+            return apply(ins, {"nop", "Ev", F_SUFFIX});
+          }
+          if (op >= 0x40 && op <= 0x4F) {
+            std::string name = std::string("cmov") + conditions[op & 0xF];
+            ins.mnemonic = name;
+            flags = 0;
+            auto source = operand("Ev");
+            auto destination = operand("Gv");
+            ins.operands = source + "," + destination;
+            return true;
+          }
+          if (op >= 0x80 && op <= 0x8F) {
+            auto name = std::string("j") + conditions[op & 0xF];
+            flags = F_BRANCH;
+            ins.operands = operand("Jz");
+            ins.mnemonic = name;
+            return true;
+          }
+          if (op >= 0x90 && op <= 0x9F) {
+            auto name = std::string("set") + conditions[op & 0xF];
+            ins.operands = operand("Eb");
+            ins.mnemonic = name;
+            return true;
+          }
+          if (op >= 0xC8 && op <= 0xCF) {
+            ins.mnemonic = "bswap";
+            ins.operands = generalRegister((op & 7) | rexB(), rexW() ? 64 : 32);
+            return true;
+          }
+          if (op == 0xB6 || op == 0xB7 || op == 0xBE || op == 0xBF) {
+            auto sourceBits = (op & 1) ? 16 : 8;
+            auto destinationBits = operandSize();
+            flags = 0;
+            std::string source = operand(sourceBits == 8 ? "Eb" : "Ew");
+            std::string destination = operand("Gv");
+            ins.mnemonic = std::string(op < 0xBE ? "movz" : "movs") + (sourceBits == 8 ? "b" : "w") +
+                           (destinationBits == 16 ? "w" : destinationBits == 32 ? "l" : "q");
+            ins.operands = source + "," + destination;
+            return true;
+          }
+          if (op == 0xBA) {
+            readModrm();
+            static constexpr const char *names[8] = {nullptr, nullptr, nullptr, nullptr, "bt", "bts", "btr", "btc"};
+            if (names[reg] == nullptr) return false;
+            return apply(ins, {names[reg], "Ev,Ib", F_SUFFIX});
+          }
+          if (op == 0xAE) {
+            readModrm();
+            if (mod == 3 && reg == 6 && operandSize16) {
+              mandatoryPrefix = true;
+              return apply(ins, {"tpause", "Ed", 0});
+            }
+            if (mod == 3) {
+              static constexpr const char *fences[8] = {nullptr, nullptr, nullptr, nullptr, nullptr, "lfence",
+                                                        "mfence", "sfence"};
+              if (fences[reg] == nullptr) return false;
+              ins.mnemonic = fences[reg];
+              return true;
+            }
+            static constexpr const char *names[8] = {"fxsave", "fxrstor", "ldmxcsr", "stmxcsr", "xsave", "xrstor",
+                                                     "xsaveopt", "clflush"};
+            ins.mnemonic = names[reg];
+            ins.operands = memory;
+            return true;
+          }
+          if (op == 0x01) {
+            readModrm();
+            auto modrm = code[pos - 1];
+            switch (modrm) {
+              case 0xD0:
+                ins.mnemonic = "xgetbv";
+                return true;
+              case 0xD5:
+                ins.mnemonic = "xend";
+                return true;
+              case 0xD6:
+                ins.mnemonic = "xtest";
+                return true;
+              case 0xEE:
+                ins.mnemonic = "rdpkru";
+                return true;
+              case 0xEF:
+                ins.mnemonic = "wrpkru";
+                return true;
+              case 0xF9:
+                ins.mnemonic = "rdtscp";
+                return true;
+              default:
+                return false;
+            }
+          }
+          if (op == 0x71 || op == 0x72 || op == 0x73) {
+            readModrm();
+            static constexpr const char *shifts[3][8] = {
+                {nullptr, nullptr, "psrlw", nullptr, "psraw", nullptr, "psllw", nullptr},
+                {nullptr, nullptr, "psrld", nullptr, "psrad", nullptr, "pslld", nullptr},
+                {nullptr, nullptr, "psrlq", "psrldq", nullptr, nullptr, "psllq", "pslldq"},
+            };
+            auto name = shifts[op - 0x71][reg];
+            if (name == nullptr || mod != 3) return false;
+            mandatoryPrefix = operandSize16;
+            return apply(ins, {name, operandSize16 ? "U,Ib" : "N,Ib", 0});
+          }
+          if (op == 0x38 || op == 0x3A) {
+            auto op3 = next();
+            static constexpr struct {
+                std::uint8_t map, op;
+                const char *name;
+            } ssse3[] = {
+                {0x38, 0x00, "pshufb"}, {0x38, 0x17, "ptest"}, {0x38, 0x2B, "packusdw"}, {0x38, 0x29, "pcmpeqq"},
+                {0x38, 0x37, "pcmpgtq"}, {0x38, 0x38, "pminsb"}, {0x38, 0x39, "pminsd"}, {0x38, 0x3A, "pminuw"},
+                {0x38, 0x3B, "pminud"}, {0x38, 0x3C, "pmaxsb"}, {0x38, 0x3D, "pmaxsd"}, {0x38, 0x3E, "pmaxuw"},
+                {0x38, 0x3F, "pmaxud"}, {0x3A, 0x0F, "palignr"}, {0x3A, 0x16, "pextrd"}, {0x3A, 0x22, "pinsrd"},
+                {0x3A, 0x60, "pcmpestrm"}, {0x3A, 0x61, "pcmpestri"}, {0x3A, 0x62, "pcmpistrm"},
+                {0x3A, 0x63, "pcmpistri"}, {0x3A, 0x08, "roundps"}, {0x3A, 0x09, "roundpd"},
+                {0x3A, 0x0A, "roundss"}, {0x3A, 0x0B, "roundsd"}, {0x38, 0xDB, "aesimc"}, {0x38, 0xDC, "aesenc"},
+                {0x38, 0xDD, "aesenclast"}, {0x38, 0xDE, "aesdec"}, {0x38, 0xDF, "aesdeclast"},
+                {0x3A, 0x44, "pclmulqdq"}, {0x3A, 0xDF, "aeskeygenassist"},
+            };
+            if (op == 0x38 && (op3 == 0xF0 || op3 == 0xF1)) {
+              if (repnz) {
+                repnz = false;
+                flags = 0;
+                auto source = operand(op3 == 0xF0 ? "Eb" : "Ev");
+                auto destination = operand("Gy");
+                ins.mnemonic = std::string("crc32") + (op3 == 0xF0 ? "b" : (operandSize() == 64 ? "q" : "l"));
+                ins.operands = source + "," + destination;
+                return true;
+              }
+              return apply(ins, op3 == 0xF0 ? OpcodeEntry{"movbe", "Gv,M", 0} : OpcodeEntry{"movbe", "M,Gv", 0});
+            }
+            for (const auto &e: ssse3) {
+              if (e.map != op || e.op != op3) continue;
+              mandatoryPrefix = true;
+              return apply(ins, {e.name, op == 0x3A ? "V,W,Ib" : "V,W", 0});
+            }
+            readModrm();
+            if (op == 0x3A) next();
+            return false;
+          }
+
+          if ((op == 0x12 || op == 0x16) && !operandSize16 && !repz && !repnz) {
+            readModrm();
+            if (mod == 3) return apply(ins, {op == 0x12 ? "movhlps" : "movlhps", "V,U", 0});
+          }
+
+          if (op == 0xC2) return decodeCompare(ins, repnz ? 3 : repz ? 2 : operandSize16 ? 1 : 0, false);
+          if (op == 0xC7) {
+            readModrm();
+            if (mod == 3 && (reg == 6 || reg == 7)) return apply(ins, {reg == 6 ? "rdrand" : "rdseed", "Ev", 0});
+            if (mod != 3 && reg == 1) {
+              ins.mnemonic = rexW() ? "cmpxchg16b" : "cmpxchg8b";
+              ins.operands = memory;
+              return true;
+            }
+            return false;
+          }
+
+          auto plain = twoByteEntry(op);
+          if (plain.mnemonic != nullptr) return apply(ins, plain);
+
+          auto sse = sseEntry(op);
+          unsigned variant = repnz ? 3 : repz ? 2 : operandSize16 ? 1 : 0;
+          auto entry = sse.variants[variant];
+          if (entry.mnemonic == nullptr && variant == 1) entry = sse.variants[0];
+          if (entry.mnemonic == nullptr) {
+            static constexpr std::uint8_t withoutModrm[] = {0x06, 0x07, 0x08, 0x09, 0x0B, 0x0E, 0x30, 0x31, 0x32,
+                                                            0x33, 0x34, 0x35, 0x37, 0x77, 0xA0, 0xA1, 0xA2, 0xA8,
+                                                            0xA9, 0xAA};
+            if (std::find(std::begin(withoutModrm), std::end(withoutModrm), op) == std::end(withoutModrm))
+              readModrm();
+            return false;
+          }
+          if (variant != 0) {
+            mandatoryPrefix = true;
+            if (variant == 2) repz = false;
+            if (variant == 3) repnz = false;
+          }
+          // REX.W selects the 64-bit movq form of movd
+          if (std::string_view(entry.mnemonic) == "movd" && rexW()) entry.mnemonic = "movq";
+          return apply(ins, entry);
+        }
+
+        bool decodeOneByte(Instruction &ins, std::uint8_t op) {
+          // ALU block: add/or/adc/sbb/and/sub/xor/cmp
+          if (op < 0x40 && (op & 7) < 6) {
+            static constexpr const char *forms[6] = {"Eb,Gb", "Ev,Gv", "Gb,Eb", "Gv,Ev", "AL,Ib", "rAX,Iz"};
+            return apply(ins, {aluNames[op >> 3], forms[op & 7], F_SUFFIX});
+          }
+          if (op >= 0x50 && op <= 0x57) return apply(ins, {"push", "Zv", F_D64});
+          if (op >= 0x58 && op <= 0x5F) return apply(ins, {"pop", "Zv", F_D64});
+          if (op >= 0x70 && op <= 0x7F) {
+            flags = F_BRANCH;
+            ins.operands = operand("Jb");
+            ins.mnemonic = std::string("j") + conditions[op & 0xF];
+            return true;
+          }
+          if (op >= 0x91 && op <= 0x97) return apply(ins, {"xchg", "Zv,rAX", 0});
+          if (op >= 0xB0 && op <= 0xB7) return apply(ins, {"mov", "Zb,Ib", 0});
+          if (op >= 0xB8 && op <= 0xBF) {
+            if (rexW()) return apply(ins, {"movabs", "Zv,Iv", 0});
+            return apply(ins, {"mov", "Zv,Iz", 0});
+          }
+          if (op >= 0xD8 && op <= 0xDF) return decodeX87(ins, op);
+          if ((op >= 0xA4 && op <= 0xA7) || (op >= 0xAA && op <= 0xAF)) return decodeStringOperation(ins, op);
+
+          switch (op) {
+            case 0x63:
+              flags = 0;
+              {
+                auto source = operand("Ed");
+                auto destination = operand("Gv");
+                ins.mnemonic = rexW() ? "movslq" : "movsxd";
+                ins.operands = source + "," + destination;
+              }
+              return true;
+            case 0x68:
+              return apply(ins, {"push", "Iz", F_D64});
+            case 0x69:
+              return apply(ins, {"imul", "Gv,Ev,Iz", 0});
+            case 0x6A:
+              return apply(ins, {"push", "sIb", F_D64});
+            case 0x6B:
+              return apply(ins, {"imul", "Gv,Ev,sIb", 0});
+            case 0x80:
+              readModrm();
+              return apply(ins, {aluNames[reg], "Eb,Ib", F_SUFFIX});
+            case 0x81:
+              readModrm();
+              return apply(ins, {aluNames[reg], "Ev,Iz", F_SUFFIX});
+            case 0x83:
+              readModrm();
+              return apply(ins, {aluNames[reg], "Ev,sIb", F_SUFFIX});
+            case 0x84:
+              return apply(ins, {"test", "Eb,Gb", F_SUFFIX});
+            case 0x85:
+              return apply(ins, {"test", "Ev,Gv", F_SUFFIX});
+            case 0x86:
+              return apply(ins, {"xchg", "Eb,Gb", F_SUFFIX});
+            case 0x87:
+              return apply(ins, {"xchg", "Ev,Gv", F_SUFFIX});
+            case 0x88:
+              return apply(ins, {"mov", "Eb,Gb", F_SUFFIX});
+            case 0x89:
+              return apply(ins, {"mov", "Ev,Gv", F_SUFFIX});
+            case 0x8A:
+              return apply(ins, {"mov", "Gb,Eb", F_SUFFIX});
+            case 0x8B:
+              return apply(ins, {"mov", "Gv,Ev", F_SUFFIX});
+            case 0x8C:
+              return apply(ins, {"mov", "Ew,Sw", 0});
+            case 0x8D:
+              return apply(ins, {"lea", "Gv,M", 0});
+            case 0x8E:
+              return apply(ins, {"mov", "Sw,Ew", 0});
+            case 0x8F:
+              readModrm();
+              if (reg != 0) return false;
+              return apply(ins, {"pop", "Ev", F_D64});
+            case 0x90:
+              if (rexB()) return apply(ins, {"xchg", "Zv,rAX", 0});
+              if (repz) {
+                repz = false;
+                ins.mnemonic = "pause";
+              } else if (operandSize16) {
+                ins.mnemonic = "xchg";
+                ins.operands = "%ax,%ax";
+                operandSize16 = false;
+              } else
+                ins.mnemonic = "nop";
+              return true;
+            case 0x98:
+              ins.mnemonic = rexW() ? "cltq" : operandSize16 ? "cbtw" : "cwtl";
+              return true;
+            case 0x99:
+              ins.mnemonic = rexW() ? "cqto" : operandSize16 ? "cwtd" : "cltd";
+              return true;
+            case 0x9B:
+              // fwait + fnstsw/fnstcw/... is printed as the waiting form
+              if (pos + 1 < size && code[pos] >= 0xD9 && code[pos] <= 0xDF) {
+                auto modrm = code[pos + 1];
+                auto waitOp = code[pos];
+                auto modrmReg = (modrm >> 3) & 7;
+                bool merge = (waitOp == 0xDF && modrm == 0xE0) || (waitOp == 0xDB && (modrm == 0xE2 || modrm == 0xE3)) ||
+                             (modrm < 0xC0 && ((waitOp == 0xD9 && (modrmReg == 6 || modrmReg == 7)) ||
+                                               (waitOp == 0xDD && (modrmReg == 6 || modrmReg == 7))));
+                if (merge && decodeX87(ins, next())) {
+                  ins.mnemonic.erase(1, 1);
+                  return true;
+                }
+              }
+              ins.mnemonic = "fwait";
+              return true;
+            case 0x9C:
+              ins.mnemonic = "pushf";
+              return true;
+            case 0x9D:
+              ins.mnemonic = "popf";
+              return true;
+            case 0x9E:
+              ins.mnemonic = "sahf";
+              return true;
+            case 0x9F:
+              ins.mnemonic = "lahf";
+              return true;
+            case 0xA0:
+              return apply(ins, {"movabs", "AL,Ob", 0});
+            case 0xA1:
+              return apply(ins, {"movabs", "rAX,Ov", 0});
+            case 0xA2:
+              return apply(ins, {"movabs", "Ob,AL", 0});
+            case 0xA3:
+              return apply(ins, {"movabs", "Ov,rAX", 0});
+            case 0xA8:
+              return apply(ins, {"test", "AL,Ib", 0});
+            case 0xA9:
+              return apply(ins, {"test", "rAX,Iz", 0});
+            case 0xC0:
+              readModrm();
+              return apply(ins, {shiftNames[reg], "Eb,Ib", F_SUFFIX});
+            case 0xC1:
+              readModrm();
+              return apply(ins, {shiftNames[reg], "Ev,Ib", F_SUFFIX});
+            case 0xC2:
+              ins.operands = operand("Iw");
+              ins.mnemonic = "ret";
+              return true;
+            case 0xC3:
+              ins.mnemonic = "ret";
+              return true;
+            case 0xC6:
+              readModrm();
+              if (reg == 7 && mod == 3 && code[pos - 1] == 0xF8) {
+                ins.operands = operand("Ib");
+                ins.mnemonic = "xabort";
+                return true;
+              }
+              if (reg != 0) return false;
+              return apply(ins, {"mov", "Eb,Ib", F_SUFFIX});
+            case 0xC7:
+              readModrm();
+              if (reg == 7 && mod == 3 && code[pos - 1] == 0xF8) {
+                auto relative = readSigned(4);
+                target = address + pos + relative;
+                char buffer[24];
+                snprintf(buffer, sizeof(buffer), "%lx", *target);
+                ins.mnemonic = "xbegin";
+                ins.operands = buffer;
+                return true;
+              }
+              if (reg != 0) return false;
+              return apply(ins, {"mov", "Ev,Iz", F_SUFFIX});
+            case 0xC8: {
+              auto frame = operand("Iw");
+              auto level = operand("Ib");
+              ins.mnemonic = "enter";
+              ins.operands = frame + "," + level;
+              return true;
+            }
+            case 0xC9:
+              ins.mnemonic = "leave";
+              return true;
+            case 0xCA:
+              ins.operands = operand("Iw");
+              ins.mnemonic = "lret";
+              return true;
+            case 0xCB:
+              ins.mnemonic = "lret";
+              return true;
+            case 0xCC:
+              ins.mnemonic = "int3";
+              return true;
+            case 0xCD:
+              ins.operands = operand("Ib");
+              ins.mnemonic = "int";
+              return true;
+            case 0xCF:
+              ins.mnemonic = rexW() ? "iretq" : "iret";
+              return true;
+            case 0xD0:
+              readModrm();
+              return apply(ins, {shiftNames[reg], "Eb", F_SUFFIX});
+            case 0xD1:
+              readModrm();
+              return apply(ins, {shiftNames[reg], "Ev", F_SUFFIX});
+            case 0xD2:
+              readModrm();
+              return apply(ins, {shiftNames[reg], "Eb,CL", F_SUFFIX});
+            case 0xD3:
+              readModrm();
+              return apply(ins, {shiftNames[reg], "Ev,CL", F_SUFFIX});
+            case 0xD7:
+              ins.mnemonic = "xlat";
+              ins.operands = "%ds:(%rbx)";
+              return true;
+            case 0xE0:
+              return apply(ins, {"loopne", "Jb", 0});
+            case 0xE1:
+              return apply(ins, {"loope", "Jb", 0});
+            case 0xE2:
+              return apply(ins, {"loop", "Jb", 0});
+            case 0xE3:
+              return apply(ins, {addressSize32 ? "jecxz" : "jrcxz", "Jb", 0});
+            case 0xE4:
+              return apply(ins, {"in", "AL,Ib", 0});
+            case 0xE5:
+              return apply(ins, {"in", "rAX,Ib", 0});
+            case 0xE6:
+              return apply(ins, {"out", "Ib,AL", 0});
+            case 0xE7:
+              return apply(ins, {"out", "Ib,rAX", 0});
+            case 0xE8:
+              return apply(ins, {"call", "Jz", F_BRANCH | F_D64});
+            case 0xE9:
+              return apply(ins, {"jmp", "Jz", F_BRANCH | F_D64});
+            case 0xEB:
+              return apply(ins, {"jmp", "Jb", F_BRANCH});
+            case 0xEC:
+              return apply(ins, {"in", "AL,DX", 0});
+            case 0xED:
+              return apply(ins, {"in", "rAX,DX", 0});
+            case 0xEE:
+              return apply(ins, {"out", "DX,AL", 0});
+            case 0xEF:
+              return apply(ins, {"out", "DX,rAX", 0});
+            case 0xF1:
+              ins.mnemonic = "int1";
+              return true;
+            case 0xF4:
+              ins.mnemonic = "hlt";
+              return true;
+            case 0xF5:
+              ins.mnemonic = "cmc";
+              return true;
+            case 0xF6:
+              readModrm();
+              if (reg < 2) return apply(ins, {"test", "Eb,Ib", F_SUFFIX});
+              return apply(ins, {group3Names[reg], "Eb", F_SUFFIX});
+            case 0xF7:
+              readModrm();
+              if (reg < 2) return apply(ins, {"test", "Ev,Iz", F_SUFFIX});
+              return apply(ins, {group3Names[reg], "Ev", F_SUFFIX});
+            case 0xF8:
+              ins.mnemonic = "clc";
+              return true;
+            case 0xF9:
+              ins.mnemonic = "stc";
+              return true;
+            case 0xFA:
+              ins.mnemonic = "cli";
+              return true;
+            case 0xFB:
+              ins.mnemonic = "sti";
+              return true;
+            case 0xFC:
+              ins.mnemonic = "cld";
+              return true;
+            case 0xFD:
+              ins.mnemonic = "std";
+              return true;
+            case 0xFE:
+              readModrm();
+              if (reg > 1) return false;
+              return apply(ins, {reg == 0 ? "inc" : "dec", "Eb", F_SUFFIX});
+            case 0xFF:
+              readModrm();
+              switch (reg) {
+                case 0:
+                  return apply(ins, {"inc", "Ev", F_SUFFIX});
+                case 1:
+                  return apply(ins, {"dec", "Ev", F_SUFFIX});
+                case 2:
+                  return apply(ins, {"call", "Ev", F_D64 | F_INDIRECT | F_BRANCH});
+                case 3:
+                  return apply(ins, {"lcall", "M", F_INDIRECT});
+                case 4:
+                  return apply(ins, {"jmp", "Ev", F_D64 | F_INDIRECT | F_BRANCH});
+                case 5:
+                  return apply(ins, {"ljmp", "M", F_INDIRECT});
+                case 6:
+                  return apply(ins, {"push", "Ev", F_D64});
+                default:
+                  return false;
+              }
+            default:
+              return false;
+          }
+        }
+
+    public:
+        Decoder(const std::uint8_t *code, std::size_t size, addr_t address) : code(code), size(size),
+                                                                              address(address) {}
+
+        Instruction run() {
+          Instruction ins;
+          ins.address = address;
+          std::vector<std::string> prefixWords;
+
+          // Legacy prefixes
+          std::uint8_t op;
+          for (;;) {
+            op = next();
+            if (truncated) break;
+            if (op == 0x66) {
+              if (operandSize16) extraOperandSize++;
+              operandSize16 = true;
+            } else if (op == 0x67) addressSize32 = true;
+            else if (op == 0xF3) repz = true;
+            else if (op == 0xF2) repnz = true;
+            else if (op == 0xF0) lock = true;
+            else if (op == 0x2E) segment = 1;
+            else if (op == 0x36) segment = 2;
+            else if (op == 0x3E) segment = 3;
+            else if (op == 0x26) segment = 0;
+            else if (op == 0x64) segment = 4;
+            else if (op == 0x65) segment = 5;
+            else break;
+          }
+          if (!truncated && op >= 0x40 && op <= 0x4F) {
+            rex = op;
+            op = next();
+          }
+
+          bool ok = false;
+          if (!truncated) {
+            if (op == 0x0F) ok = decodeTwoByte(ins);
+            else if ((op == 0xC4 || op == 0xC5) && rex == 0) ok = decodeVex(ins, op);
+            else if (op == 0x62 && rex == 0) ok = decodeEvex(ins);
+            else ok = decodeOneByte(ins, op);
+          }
+
+          if (!ok || truncated) {
+            Instruction bad;
+            bad.address = address;
+            bad.length = 1;
+            bad.bytes[0] = size > 0 ? code[0] : 0;
+            bad.mnemonic = "(bad)";
+            return bad;
+          }
+
+          ins.length = (std::uint8_t) pos;
+          std::memcpy(ins.bytes.data(), code, pos);
+          if (ripRelative) {
+            target = address + pos + displacement;
+            ins.ripDisplacementOffset = (std::uint8_t) ripDisplacement;
+          }
+          ins.target = target;
+
+          // Prefixes not consumed by the instruction are printed as words
+          if (segment >= 0 && segment < 4) {
+            static constexpr const char *names[4] = {"es", "cs", "ss", "ds"};
+            if ((flags & F_INDIRECT) && segment == 3) prefixWords.emplace_back("notrack");
+            else prefixWords.emplace_back(names[segment]);
+          }
+          // 66 is ignored when REX.W is set
+          if (operandSize16 && rexW() && !mandatoryPrefix && !vex) extraOperandSize++;
+          if (extraOperandSize > 0)
+            for (int i = 0; i < extraOperandSize; i++) prefixWords.insert(prefixWords.begin(), "data16");
+          if (lock) prefixWords.insert(prefixWords.begin(), "lock");
+          if (repz && !mandatoryPrefix) prefixWords.insert(prefixWords.begin(), "repz");
+          if (repnz && !mandatoryPrefix) prefixWords.insert(prefixWords.begin(), (flags & F_BRANCH) ? "bnd" : "repnz");
+
+          std::string prefix;
+          for (const auto &word: prefixWords) prefix += word + " ";
+          ins.mnemonic.insert(0, prefix);
+          return ins;
+        }
+    };
+
+} // namespace
+
+
+Instruction disasm::decode(const std::uint8_t *code, std::size_t size, addr_t address) {
+  return Decoder(code, size, address).run();
+}
+
+std::vector<Instruction> disasm::decodeAll(const std::uint8_t *code, std::size_t size, addr_t address) {
+  std::vector<Instruction> instructions;
+  std::size_t offset = 0;
+  while (offset < size) {
+    instructions.push_back(decode(code + offset, size - offset, address + offset));
+    offset += instructions.back().length;
+  }
+  return instructions;
+}
+
+std::string disasm::formatInstruction(const Instruction &instruction) {
+  std::string bytes;
+  char buffer[8];
+  for (unsigned i = 0; i < instruction.length; i++) {
+    snprintf(buffer, sizeof(buffer), "%02x ", instruction.bytes[i]);
+    bytes += buffer;
+  }
+  std::string line;
+  line.resize(64 + bytes.size() + instruction.mnemonic.size() + instruction.operands.size());
+  auto size = snprintf(line.data(), line.size(), "%8lx:\t%-21s\t%-6s %s", instruction.address, bytes.c_str(),
+                       instruction.mnemonic.c_str(), instruction.operands.c_str());
+  line.resize(size);
+  while (!line.empty() && line.back() == ' ') line.pop_back();
+  return line;
+}
+
+bool disasm::conditionHolds(std::uint8_t condition, std::uint64_t eflags) {
+  bool cf = eflags & (1 << 0), pf = eflags & (1 << 2), zf = eflags & (1 << 6), sf = eflags & (1 << 7),
+      of = eflags & (1 << 11);
+  bool result;
+  switch (condition >> 1) {
+    case 0: result = of; break;
+    case 1: result = cf; break;
+    case 2: result = zf; break;
+    case 3: result = cf || zf; break;
+    case 4: result = sf; break;
+    case 5: result = pf; break;
+    case 6: result = sf != of; break;
+    default: result = zf || sf != of; break;
+  }
+  // Odd conditions are the negations
+  return (condition & 1) ? !result : result;
+}
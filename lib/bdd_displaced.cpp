@@ -0,0 +1,213 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <cstring>
+#include <climits>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "bdd_ptrace.hpp"
+
+namespace {
+    const std::size_t page_size = sysconf(_SC_PAGESIZE);
+
+    // Relocated instruction (15 bytes at most) + jump back (14 bytes at most)
+    constexpr std::size_t slot_size = 32;
+
+    bool fitsInt32(std::int64_t value) {
+      return value >= INT32_MIN && value <= INT32_MAX;
+    }
+
+    /**
+     * Instructions that can neither run out of line nor be emulated: their effect depends on the IP
+     * (pushed return address, rcx-relative loops, transactions) or, for syscalls, a restart rewinds the IP
+     */
+    bool runsInLine(const disasm::Instruction &instruction) {
+      // Last word: prefixes as "bnd", "notrack" or "rep" come first
+      std::string_view mnemonic = instruction.mnemonic;
+      auto space = mnemonic.rfind(' ');
+      if (space != std::string_view::npos) mnemonic.remove_prefix(space + 1);
+      return mnemonic.starts_with("call") || mnemonic.starts_with("loop") || mnemonic == "jrcxz" ||
+             mnemonic == "jecxz" || mnemonic.starts_with("xbegin") || mnemonic.starts_with("int") ||
+             mnemonic.starts_with("sys") || mnemonic.starts_with("iret") || mnemonic.starts_with("lret");
+    }
+
+    /**
+     * Appends a jump from "from" (address of the jump itself) to "to": jmp rel32 if close enough,
+     * else jmp *0(%rip) followed by the absolute address
+     */
+    void appendJump(std::vector<std::uint8_t> &code, addr_t from, addr_t to) {
+      std::int64_t relative = to - (from + 5);
+      if (fitsInt32(relative)) {
+        auto value = static_cast<std::int32_t>(relative);
+        code.push_back(0xE9);
+        code.insert(code.end(), (std::uint8_t *) &value, (std::uint8_t *) &value + sizeof(value));
+      } else {
+        code.insert(code.end(), {0xFF, 0x25, 0x00, 0x00, 0x00, 0x00});
+        code.insert(code.end(), (std::uint8_t *) &to, (std::uint8_t *) &to + sizeof(to));
+      }
+    }
+}
+
+addr_t TracedProgram::allocateScratchPage() {
+  ExclusiveIO::debug_f("TracedProgram::allocateScratchPage()\n");
+  // The syscall instruction is written over the breakpoint the program is stopped at, then put back
+  auto regs = fetchRegisters();
+  if (regs == nullptr || !isTrappedAtBreakpoint()) return 0;
+  auto saved = *regs;
+  auto site = getIP();
+  std::array<std::uint8_t, 2> code{};
+  static constexpr std::array<std::uint8_t, 2> syscall_code = {0x0F, 0x05};
+  // No other thread may run into the syscall instruction
+  auto stopped = stop_mode == StopMode::NonStop ? stopOthers() : std::vector<pid_t>();
+  if (!readMemory(site, code).complete() || !writeMemory(site, syscall_code).complete()) {
+    for (auto tid: stopped) resumeThread(tid, PTRACE_CONT);
+    return 0;
+  }
+
+  // Below the lowest scratch page, itself below the program: RIP-relative operands stay in range
+  auto lowest = scratch_pages.empty() ? ram_start_address : scratch_pages.back();
+  auto hint = lowest > 2 * page_size ? (lowest & ~(page_size - 1)) - page_size : 0;
+  addr_t result = 0;
+  for (auto flags: {MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, MAP_PRIVATE | MAP_ANONYMOUS}) {
+    auto call = saved;
+    call.REGISTERS_IP = site;
+    call.rax = SYS_mmap;
+    call.rdi = (flags & MAP_FIXED_NOREPLACE) ? hint : 0;
+    call.rsi = page_size;
+    call.rdx = PROT_READ | PROT_EXEC;
+    call.r10 = flags;
+    call.r8 = -1;
+    call.r9 = 0;
+    setRegisters(call);
+    ptraceRawStep();
+    auto after = fetchRegisters();
+    if (after == nullptr) break; // the program died
+    result = after->rax;
+    if (result < -4095UL) break;
+    ExclusiveIO::debugError_f("TracedProgram::allocateScratchPage(): mmap(0x%016lX) = %ld\n", call.rdi, result);
+    result = 0;
+  }
+
+  writeMemory(site, code);
+  setRegisters(saved);
+  for (auto tid: stopped) resumeThread(tid, PTRACE_CONT);
+  if (result != 0) scratch_pages.push_back(result);
+  scratch_used = 0;
+  return result;
+}
+
+const TracedProgram::DisplacedInstruction &TracedProgram::getDisplaced(const Breakpoint &bp) {
+  auto it = displaced.find(bp.getAddress());
+  if (it != displaced.end()) return it->second;
+  auto &entry = displaced[bp.getAddress()];
+
+  // Original instruction (readCode hides the INT3), its addresses as in the program
+  auto code = readCode(bp.getAddress() - ram_start_address, disasm::max_instruction_length);
+  auto instruction = disasm::decode(code.data(), code.size(), bp.getAddress());
+  if (!instruction.isValid()) return entry;
+  entry.length = instruction.length;
+
+  // Relative branches & calls (bnd/notrack prefixes aside): emulated on the registers
+  std::size_t opcode = 0;
+  while (opcode + 1 < instruction.length && (instruction.bytes[opcode] == 0xF2 || instruction.bytes[opcode] == 0x3E))
+    opcode++;
+  auto op = instruction.bytes[opcode];
+  auto op2 = opcode + 1 < instruction.length ? instruction.bytes[opcode + 1] : 0;
+  if (instruction.target && (op == 0xE8 || op == 0xE9 || op == 0xEB || (op & 0xF0) == 0x70 ||
+                             (op == 0x0F && (op2 & 0xF0) == 0x80))) {
+    entry.emulation = op == 0xE8 ? Emulation::Call : op == 0xE9 || op == 0xEB ? Emulation::Jump
+                                                                                : Emulation::ConditionalJump;
+    entry.condition = (op == 0x0F ? op2 : op) & 0x0F;
+    entry.target = *instruction.target;
+    return entry;
+  }
+  if (runsInLine(instruction) || instruction.operands.find("%eip") != std::string::npos) {
+    ExclusiveIO::debug_f("TracedProgram::getDisplaced(0x%016lX): '%s' stays in line\n", bp.getAddress(),
+                         instruction.mnemonic.c_str());
+    return entry;
+  }
+
+  if (scratch_failed) return entry;
+  if (scratch_pages.empty() || scratch_used + slot_size > page_size) {
+    if (allocateScratchPage() == 0) {
+      scratch_failed = true;
+      return entry;
+    }
+  }
+  auto slot = scratch_pages.back() + scratch_used;
+
+  std::vector<std::uint8_t> trampoline(instruction.bytes.begin(), instruction.bytes.begin() + instruction.length);
+  if (instruction.ripDisplacementOffset != 0) {
+    std::int64_t displacement = *instruction.target - (slot + instruction.length);
+    if (!fitsInt32(displacement)) return entry;
+    auto value = static_cast<std::int32_t>(displacement);
+    std::memcpy(trampoline.data() + instruction.ripDisplacementOffset, &value, sizeof(value));
+  }
+  appendJump(trampoline, slot + instruction.length, bp.getAddress() + instruction.length);
+  if (!writeMemory(slot, trampoline).complete()) return entry;
+
+  scratch_used += slot_size;
+  entry.slot = slot;
+  displacedBySlot.emplace(slot, bp.getAddress());
+  ExclusiveIO::debug_f("TracedProgram::getDisplaced(0x%016lX): 0x%016lX\n", bp.getAddress(), slot);
+  return entry;
+}
+
+TracedProgram::Displaced TracedProgram::displaceBreakpoint() {
+  if (fetchRegisters() == nullptr) return Displaced::No;
+  const auto &instruction = getDisplaced(getHitBreakpoint());
+  // Fetched again: allocating the scratch page goes through the registers
+  auto regs = fetchRegisters();
+  if (regs == nullptr) return Displaced::No;
+  auto moved = *regs;
+  auto next = getIP() + instruction.length;
+
+  switch (instruction.emulation) {
+    case Emulation::Jump:
+      moved.REGISTERS_IP = instruction.target;
+      break;
+    case Emulation::ConditionalJump:
+      moved.REGISTERS_IP = disasm::conditionHolds(instruction.condition, moved.eflags) ? instruction.target : next;
+      break;
+    case Emulation::Call: {
+      std::array<std::uint8_t, sizeof(addr_t)> returnAddress{};
+      std::memcpy(returnAddress.data(), &next, sizeof(next));
+      if (!writeMemory(moved.rsp - sizeof(addr_t), returnAddress).complete()) return Displaced::No;
+      moved.rsp -= sizeof(addr_t);
+      moved.REGISTERS_IP = instruction.target;
+      break;
+    }
+    case Emulation::None:
+      if (instruction.slot == 0) return Displaced::No;
+      moved.REGISTERS_IP = instruction.slot;
+      setRegisters(moved);
+      return Displaced::Copy;
+  }
+  setRegisters(moved);
+  return Displaced::Emulated;
+}
+
+void TracedProgram::relocateFromScratch() {
+  if (displacedBySlot.empty()) return;
+  auto regs = fetchRegisters();
+  if (regs == nullptr) return;
+  auto ip = regs->REGISTERS_IP;
+  auto it = displacedBySlot.upper_bound(ip);
+  if (it == displacedBySlot.begin()) return;
+  it--;
+  // In the copy (faulting instruction) or right after it (step): same place in the original code
+  auto offset = ip - it->first;
+  if (offset > displaced.at(it->second).length) return; // in the jump back
+  auto moved = *regs;
+  moved.REGISTERS_IP = it->second + offset;
+  setRegisters(moved);
+}
+
+void TracedProgram::clearDisplaced() {
+  displaced.clear();
+  displacedBySlot.clear();
+  scratch_pages.clear();
+  scratch_used = 0;
+  scratch_failed = false;
+}
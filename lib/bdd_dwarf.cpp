@@ -0,0 +1,1078 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "bdd_dwarf.hpp"
+#include "bdd_exclusive_io.hpp"
+
+using namespace dwarf;
+
+namespace {
+
+    // Standard opcodes
+    constexpr std::uint8_t DW_LNS_copy = 1;
+    constexpr std::uint8_t DW_LNS_advance_pc = 2;
+    constexpr std::uint8_t DW_LNS_advance_line = 3;
+    constexpr std::uint8_t DW_LNS_set_file = 4;
+    constexpr std::uint8_t DW_LNS_set_column = 5;
+    constexpr std::uint8_t DW_LNS_negate_stmt = 6;
+    constexpr std::uint8_t DW_LNS_const_add_pc = 8;
+    constexpr std::uint8_t DW_LNS_fixed_advance_pc = 9;
+
+    // Extended opcodes
+    constexpr std::uint8_t DW_LNE_end_sequence = 1;
+    constexpr std::uint8_t DW_LNE_set_address = 2;
+    constexpr std::uint8_t DW_LNE_define_file = 3;
+
+    // DWARF 5 entry formats
+    constexpr std::uint64_t DW_LNCT_path = 1;
+    constexpr std::uint64_t DW_LNCT_directory_index = 2;
+
+    constexpr std::uint64_t DW_FORM_data2 = 0x05;
+    constexpr std::uint64_t DW_FORM_data4 = 0x06;
+    constexpr std::uint64_t DW_FORM_data8 = 0x07;
+    constexpr std::uint64_t DW_FORM_string = 0x08;
+    constexpr std::uint64_t DW_FORM_block = 0x09;
+    constexpr std::uint64_t DW_FORM_data1 = 0x0b;
+    constexpr std::uint64_t DW_FORM_sdata = 0x0d;
+    constexpr std::uint64_t DW_FORM_strp = 0x0e;
+    constexpr std::uint64_t DW_FORM_udata = 0x0f;
+    constexpr std::uint64_t DW_FORM_data16 = 0x1e;
+    constexpr std::uint64_t DW_FORM_line_strp = 0x1f;
+
+    /**
+     * Bounds-checked little-endian reader, every read past the end returns 0 and sets failed
+     */
+    class Reader {
+    private:
+        const std::uint8_t *current;
+        const std::uint8_t *end;
+
+    public:
+        bool failed = false;
+
+        explicit Reader(std::span<const std::uint8_t> data) : current(data.data()), end(data.data() + data.size()) {}
+
+        [[nodiscard]] std::size_t remaining() const { return end - current; }
+
+        [[nodiscard]] const std::uint8_t *position() const { return current; }
+
+        void skip(std::size_t size) {
+          if (size > remaining()) {
+            failed = true;
+            current = end;
+          } else
+            current += size;
+        }
+
+        std::uint64_t fixed(std::size_t size) {
+          if (size > remaining() || size > sizeof(std::uint64_t)) {
+            skip(size);
+            return 0;
+          }
+          std::uint64_t value = 0;
+          std::memcpy(&value, current, size);
+          current += size;
+          return value;
+        }
+
+        std::uint8_t u8() { return fixed(1); }
+
+        std::uint64_t uleb() {
+          std::uint64_t value = 0;
+          unsigned shift = 0;
+          std::uint8_t byte;
+          do {
+            byte = u8();
+            if (shift < 64) value |= std::uint64_t(byte & 0x7F) << shift;
+            shift += 7;
+          } while ((byte & 0x80) && !failed);
+          return value;
+        }
+
+        std::int64_t sleb() {
+          std::int64_t value = 0;
+          unsigned shift = 0;
+          std::uint8_t byte;
+          do {
+            byte = u8();
+            if (shift < 64) value |= std::int64_t(byte & 0x7F) << shift;
+            shift += 7;
+          } while ((byte & 0x80) && !failed);
+          if (shift < 64 && (byte & 0x40)) value |= -(std::int64_t(1) << shift);
+          return value;
+        }
+
+        std::string_view string() {
+          auto length = strnlen(reinterpret_cast<const char *>(current), remaining());
+          if (length == remaining()) {
+            skip(length + 1);
+            return {};
+          }
+          std::string_view text(reinterpret_cast<const char *>(current), length);
+          current += length + 1;
+          return text;
+        }
+    };
+
+    std::string_view stringAt(std::span<const std::uint8_t> table, std::uint64_t offset) {
+      if (offset >= table.size()) return {};
+      auto text = reinterpret_cast<const char *>(table.data()) + offset;
+      return {text, strnlen(text, table.size() - offset)};
+    }
+
+    /**
+     * Value of a DWARF 5 directory/file entry attribute (only numbers & strings are used)
+     */
+    struct FormValue {
+        std::uint64_t number = 0;
+        std::string_view text;
+    };
+
+    bool readForm(Reader &reader, std::uint64_t form, unsigned offsetSize, std::span<const std::uint8_t> lineStrings,
+                  std::span<const std::uint8_t> strings, FormValue &value) {
+      switch (form) {
+        case DW_FORM_string:
+          value.text = reader.string();
+          break;
+        case DW_FORM_line_strp:
+          value.text = stringAt(lineStrings, reader.fixed(offsetSize));
+          break;
+        case DW_FORM_strp:
+          value.text = stringAt(strings, reader.fixed(offsetSize));
+          break;
+        case DW_FORM_udata:
+          value.number = reader.uleb();
+          break;
+        case DW_FORM_sdata:
+          value.number = reader.sleb();
+          break;
+        case DW_FORM_data1:
+          value.number = reader.fixed(1);
+          break;
+        case DW_FORM_data2:
+          value.number = reader.fixed(2);
+          break;
+        case DW_FORM_data4:
+          value.number = reader.fixed(4);
+          break;
+        case DW_FORM_data8:
+          value.number = reader.fixed(8);
+          break;
+        case DW_FORM_data16:
+          reader.skip(16);
+          break;
+        case DW_FORM_block:
+          reader.skip(reader.uleb());
+          break;
+        default:
+          // strx forms need .debug_str_offsets & the unit DIE, not produced for line tables by GCC/Clang
+          return false;
+      }
+      return !reader.failed;
+    }
+
+    std::string joinPath(std::string_view directory, std::string_view name) {
+      if (directory.empty() || name.starts_with('/')) return std::string(name);
+      std::string path(directory);
+      if (!path.ends_with('/')) path += '/';
+      return path.append(name);
+    }
+
+    /**
+     * @return true if the query designates the path: same path, path suffix or same file name
+     */
+    bool matchesPath(std::string_view path, std::string_view query) {
+      if (path == query) return true;
+      return path.size() > query.size() && path.ends_with(query) && path[path.size() - query.size() - 1] == '/';
+    }
+
+} // namespace
+
+void LineTable::decode() const {
+  std::call_once(decoded, [this] {
+      if (elf_file == nullptr || load()) return;
+      auto lines = elf_file->getSectionData(".debug_line");
+      auto lineStrings = elf_file->getSectionData(".debug_line_str");
+      auto strings = elf_file->getSectionData(".debug_str");
+
+      while (!lines.empty()) {
+        auto size = decodeUnit(lines, lineStrings, strings);
+        if (size == 0) {
+          ExclusiveIO::debugError_f("LineTable::decode(): cannot decode a line number program, stopping there\n");
+          break;
+        }
+        lines = lines.subspan(std::min(size, lines.size()));
+      }
+
+      // end_sequence rows first, so a sequence starting where another one ends wins the lookup
+      std::stable_sort(entries.begin(), entries.end(), [](const LineEntry &a, const LineEntry &b) {
+          if (a.address != b.address) return a.address < b.address;
+          return a.endSequence && !b.endSequence;
+      });
+      for (std::uint32_t i = 0; i < entries.size(); i++)
+        if (entries[i].isStatement && !entries[i].endSequence) entriesByLocation.push_back(i);
+      std::sort(entriesByLocation.begin(), entriesByLocation.end(), [this](std::uint32_t a, std::uint32_t b) {
+          const auto &first = entries[a], &second = entries[b];
+          if (first.file != second.file) return first.file < second.file;
+          if (first.line != second.line) return first.line < second.line;
+          return first.address < second.address;
+      });
+      ExclusiveIO::debug_f("LineTable::decode(): %zu rows, %zu files\n", entries.size(), files.size());
+      store();
+  });
+}
+
+bool LineTable::load() const {
+  std::span<const char> payload;
+  auto file = cache::load(elf_file->getIndexKey(), "lines", payload);
+  if (file == nullptr) return false;
+
+  cache::Reader reader(payload);
+  auto fileCount = reader.get<std::uint64_t>();
+  if (!fileCount || *fileCount > payload.size()) return false;
+  std::vector<std::string> paths;
+  for (std::uint64_t i = 0; i < *fileCount; i++) {
+    auto path = reader.getString();
+    if (!path) return false;
+    paths.emplace_back(*path);
+  }
+  auto rows = reader.getArray<LineEntry>();
+  auto byLocation = reader.getArray<std::uint32_t>();
+  if (!rows || !byLocation || !reader.atEnd()) return false;
+
+  entries.resize(rows->size() / sizeof(LineEntry));
+  std::memcpy(entries.data(), rows->data(), rows->size());
+  entriesByLocation.resize(byLocation->size() / sizeof(std::uint32_t));
+  std::memcpy(entriesByLocation.data(), byLocation->data(), byLocation->size());
+  // Out of range indexes would be read unchecked by the lookups
+  bool valid = std::all_of(entries.cbegin(), entries.cend(),
+                           [&paths](const LineEntry &entry) { return entry.file < paths.size(); }) &&
+               std::all_of(entriesByLocation.cbegin(), entriesByLocation.cend(),
+                           [this](std::uint32_t index) { return index < entries.size(); });
+  if (!valid) {
+    entries.clear();
+    entriesByLocation.clear();
+    return false;
+  }
+  for (const auto &path: paths) addFile(path);
+  ExclusiveIO::debug_f("LineTable::load(): %zu rows, %zu files\n", entries.size(), files.size());
+  return true;
+}
+
+void LineTable::store() const {
+  if (elf_file->getIndexKey().empty()) return;
+  cache::Writer writer;
+  writer.put<std::uint64_t>(files.size());
+  for (const auto &path: files) writer.putString(path);
+  writer.putArray<LineEntry>(entries);
+  writer.putArray<std::uint32_t>(entriesByLocation);
+  cache::store(elf_file->getIndexKey(), "lines", writer);
+}
+
+std::uint32_t LineTable::addFile(const std::string &path) const {
+  auto [it, inserted] = filesByPath.try_emplace(path, files.size());
+  if (inserted) files.push_back(path);
+  return it->second;
+}
+
+std::size_t LineTable::decodeUnit(std::span<const std::uint8_t> unit, std::span<const std::uint8_t> lineStrings,
+                                  std::span<const std::uint8_t> strings) const {
+  Reader reader(unit);
+  std::uint64_t unitLength = reader.fixed(4);
+  unsigned offsetSize = 4;
+  if (unitLength == 0xFFFFFFFF) {
+    unitLength = reader.fixed(8);
+    offsetSize = 8;
+  }
+  auto unitStart = reader.position();
+  if (reader.failed || unitLength > reader.remaining()) return 0;
+  auto unitSize = (unitStart - unit.data()) + unitLength;
+  reader = Reader(unit.subspan(unitStart - unit.data(), unitLength));
+
+  auto version = reader.fixed(2);
+  if (version < 2 || version > 5) return unitSize; // Unknown: skipped
+  unsigned addressSize = sizeof(addr_t);
+  if (version >= 5) {
+    addressSize = reader.u8();
+    reader.u8(); // segment_selector_size
+  }
+  auto headerLength = reader.fixed(offsetSize);
+  auto programStart = reader.position() + headerLength;
+  unsigned minimumInstructionLength = reader.u8();
+  if (version >= 4) reader.u8(); // maximum_operations_per_instruction (VLIW only)
+  bool defaultIsStatement = reader.u8() != 0;
+  auto lineBase = static_cast<std::int8_t>(reader.u8());
+  unsigned lineRange = reader.u8();
+  unsigned opcodeBase = reader.u8();
+  std::vector<std::uint8_t> standardOpcodeLengths(opcodeBase > 0 ? opcodeBase - 1 : 0);
+  for (auto &length: standardOpcodeLengths) length = reader.u8();
+  if (reader.failed || lineRange == 0) return 0;
+
+  // Unit file index -> LineTable file index
+  std::vector<std::uint32_t> unitFiles;
+  std::vector<std::string> directories;
+  if (version >= 5) {
+    // Directories & files are described by (content type, form) lists
+    auto readEntries = [&](auto &&onEntry) {
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> format(reader.u8());
+        for (auto &[type, form]: format) {
+          type = reader.uleb();
+          form = reader.uleb();
+        }
+        auto count = reader.uleb();
+        for (std::uint64_t i = 0; i < count && !reader.failed; i++) {
+          std::string_view path;
+          std::uint64_t directory = 0;
+          for (const auto &[type, form]: format) {
+            FormValue value;
+            if (!readForm(reader, form, offsetSize, lineStrings, strings, value)) return false;
+            if (type == DW_LNCT_path) path = value.text;
+            else if (type == DW_LNCT_directory_index) directory = value.number;
+          }
+          onEntry(path, directory);
+        }
+        return !reader.failed;
+    };
+    if (!readEntries([&](std::string_view path, std::uint64_t) {
+        // Directory 0 is the compilation directory, the others may be relative to it
+        directories.push_back(directories.empty() ? std::string(path) : joinPath(directories.front(), path));
+    }))
+      return unitSize;
+    if (!readEntries([&](std::string_view path, std::uint64_t directory) {
+        auto base = directory < directories.size() ? std::string_view(directories[directory]) : std::string_view();
+        unitFiles.push_back(addFile(joinPath(base, path)));
+    }))
+      return unitSize;
+  } else {
+    // Index 0 is the (unknown here) compilation directory, the file indexes start at 1
+    directories.emplace_back();
+    for (auto directory = reader.string(); !directory.empty() && !reader.failed; directory = reader.string())
+      directories.emplace_back(directory);
+    unitFiles.push_back(addFile("??"));
+    for (auto name = reader.string(); !name.empty() && !reader.failed; name = reader.string()) {
+      auto directory = reader.uleb();
+      reader.uleb(); // modification time
+      reader.uleb(); // length
+      auto base = directory < directories.size() ? std::string_view(directories[directory]) : std::string_view();
+      unitFiles.push_back(addFile(joinPath(base, name)));
+    }
+  }
+  if (reader.failed || programStart < reader.position() || programStart > unitStart + unitLength) return unitSize;
+  reader.skip(programStart - reader.position());
+
+  // Line number program (state machine)
+  LineEntry state{};
+  bool skipSequence = false;
+  std::size_t sequenceStart = entries.size();
+  auto reset = [&]() {
+      state = LineEntry{0, 1, 1, 0, defaultIsStatement, false};
+      skipSequence = false;
+      sequenceStart = entries.size();
+  };
+  auto emit = [&]() {
+      // Sequences at address 0 belong to functions discarded by the linker
+      if (state.address == 0 && !state.endSequence) skipSequence = true;
+      if (skipSequence) return;
+      // Rows at the end address cover nothing
+      while (state.endSequence && entries.size() > sequenceStart && entries.back().address == state.address)
+        entries.pop_back();
+      auto row = state;
+      row.file = state.file < unitFiles.size() ? unitFiles[state.file] : addFile("??");
+      entries.push_back(row);
+  };
+  reset();
+  while (reader.remaining() > 0 && !reader.failed) {
+    auto opcode = reader.u8();
+    if (opcode >= opcodeBase) {
+      // Special opcode: advance address & line, then emit a row
+      unsigned adjusted = opcode - opcodeBase;
+      state.address += (adjusted / lineRange) * minimumInstructionLength;
+      state.line += lineBase + static_cast<int>(adjusted % lineRange);
+      emit();
+      continue;
+    }
+    switch (opcode) {
+      case 0: {
+        auto length = reader.uleb();
+        auto next = reader.position() + length;
+        if (length == 0 || length > reader.remaining()) return unitSize;
+        auto extended = reader.u8();
+        if (extended == DW_LNE_end_sequence) {
+          state.endSequence = true;
+          emit();
+          reset();
+        } else if (extended == DW_LNE_set_address) {
+          state.address = reader.fixed(std::min<std::size_t>(length - 1, addressSize));
+        } else if (extended == DW_LNE_define_file && version < 5) {
+          auto name = reader.string();
+          auto directory = reader.uleb();
+          auto base = directory < directories.size() ? std::string_view(directories[directory]) : std::string_view();
+          unitFiles.push_back(addFile(joinPath(base, name)));
+        }
+        reader.skip(next - reader.position());
+        break;
+      }
+      case DW_LNS_copy:
+        emit();
+        break;
+      case DW_LNS_advance_pc:
+        state.address += reader.uleb() * minimumInstructionLength;
+        break;
+      case DW_LNS_advance_line:
+        state.line += reader.sleb();
+        break;
+      case DW_LNS_set_file:
+        state.file = reader.uleb();
+        break;
+      case DW_LNS_set_column:
+        state.column = reader.uleb();
+        break;
+      case DW_LNS_negate_stmt:
+        state.isStatement = !state.isStatement;
+        break;
+      case DW_LNS_const_add_pc:
+        state.address += ((255 - opcodeBase) / lineRange) * minimumInstructionLength;
+        break;
+      case DW_LNS_fixed_advance_pc:
+        state.address += reader.fixed(2);
+        break;
+      default:
+        // Opcodes without effect on the table (basic_block, prologue_end, isa, ...): skip their operands
+        for (unsigned i = 0; i < standardOpcodeLengths[opcode - 1]; i++) reader.uleb();
+    }
+  }
+  return unitSize;
+}
+
+const LineEntry *LineTable::findByAddress(addr_t address) const {
+  decode();
+  auto it = std::upper_bound(entries.cbegin(), entries.cend(), address,
+                             [](addr_t addr, const LineEntry &entry) { return addr < entry.address; });
+  if (it == entries.cbegin()) return nullptr;
+  auto entry = std::prev(it);
+  if (entry->endSequence) return nullptr;
+  return &*entry;
+}
+
+const LineEntry *LineTable::findByLocation(std::string_view file, std::uint32_t line) const {
+  decode();
+  const LineEntry *best = nullptr;
+  for (std::uint32_t i = 0; i < files.size(); i++) {
+    if (!matchesPath(files[i], file)) continue;
+    // First statement of the file at this line, or the next line having some code
+    auto it = std::lower_bound(entriesByLocation.cbegin(), entriesByLocation.cend(), std::make_pair(i, line),
+                               [this](std::uint32_t index, const std::pair<std::uint32_t, std::uint32_t> &location) {
+                                   const auto &entry = entries[index];
+                                   if (entry.file != location.first) return entry.file < location.first;
+                                   return entry.line < location.second;
+                               });
+    if (it == entriesByLocation.cend() || entries[*it].file != i) continue;
+    const auto &candidate = entries[*it];
+    if (best == nullptr || candidate.line < best->line ||
+        (candidate.line == best->line && candidate.address < best->address))
+      best = &candidate;
+  }
+  return best;
+}
+
+std::string LineTable::getLocationString(addr_t address) const {
+  auto entry = findByAddress(address);
+  if (entry == nullptr) return "";
+  return files[entry->file] + ":" + std::to_string(entry->line);
+}
+
+
+namespace {
+
+    // Call frame instructions
+    constexpr std::uint8_t DW_CFA_advance_loc = 0x40;
+    constexpr std::uint8_t DW_CFA_offset = 0x80;
+    constexpr std::uint8_t DW_CFA_restore = 0xC0;
+    constexpr std::uint8_t DW_CFA_nop = 0x00;
+    constexpr std::uint8_t DW_CFA_set_loc = 0x01;
+    constexpr std::uint8_t DW_CFA_advance_loc1 = 0x02;
+    constexpr std::uint8_t DW_CFA_advance_loc2 = 0x03;
+    constexpr std::uint8_t DW_CFA_advance_loc4 = 0x04;
+    constexpr std::uint8_t DW_CFA_offset_extended = 0x05;
+    constexpr std::uint8_t DW_CFA_restore_extended = 0x06;
+    constexpr std::uint8_t DW_CFA_undefined = 0x07;
+    constexpr std::uint8_t DW_CFA_same_value = 0x08;
+    constexpr std::uint8_t DW_CFA_register = 0x09;
+    constexpr std::uint8_t DW_CFA_remember_state = 0x0A;
+    constexpr std::uint8_t DW_CFA_restore_state = 0x0B;
+    constexpr std::uint8_t DW_CFA_def_cfa = 0x0C;
+    constexpr std::uint8_t DW_CFA_def_cfa_register = 0x0D;
+    constexpr std::uint8_t DW_CFA_def_cfa_offset = 0x0E;
+    constexpr std::uint8_t DW_CFA_def_cfa_expression = 0x0F;
+    constexpr std::uint8_t DW_CFA_expression = 0x10;
+    constexpr std::uint8_t DW_CFA_offset_extended_sf = 0x11;
+    constexpr std::uint8_t DW_CFA_def_cfa_sf = 0x12;
+    constexpr std::uint8_t DW_CFA_def_cfa_offset_sf = 0x13;
+    constexpr std::uint8_t DW_CFA_val_offset = 0x14;
+    constexpr std::uint8_t DW_CFA_val_offset_sf = 0x15;
+    constexpr std::uint8_t DW_CFA_val_expression = 0x16;
+    constexpr std::uint8_t DW_CFA_GNU_args_size = 0x2E;
+    constexpr std::uint8_t DW_CFA_GNU_negative_offset_extended = 0x2F;
+
+    // .eh_frame pointer encodings
+    constexpr std::uint8_t DW_EH_PE_omit = 0xFF;
+    constexpr std::uint8_t DW_EH_PE_pcrel = 0x10;
+
+    // Expression operations
+    constexpr std::uint8_t DW_OP_addr = 0x03;
+    constexpr std::uint8_t DW_OP_deref = 0x06;
+    constexpr std::uint8_t DW_OP_const1u = 0x08;
+    constexpr std::uint8_t DW_OP_const1s = 0x09;
+    constexpr std::uint8_t DW_OP_const2u = 0x0A;
+    constexpr std::uint8_t DW_OP_const2s = 0x0B;
+    constexpr std::uint8_t DW_OP_const4u = 0x0C;
+    constexpr std::uint8_t DW_OP_const4s = 0x0D;
+    constexpr std::uint8_t DW_OP_const8u = 0x0E;
+    constexpr std::uint8_t DW_OP_const8s = 0x0F;
+    constexpr std::uint8_t DW_OP_constu = 0x10;
+    constexpr std::uint8_t DW_OP_consts = 0x11;
+    constexpr std::uint8_t DW_OP_dup = 0x12;
+    constexpr std::uint8_t DW_OP_drop = 0x13;
+    constexpr std::uint8_t DW_OP_over = 0x14;
+    constexpr std::uint8_t DW_OP_pick = 0x15;
+    constexpr std::uint8_t DW_OP_swap = 0x16;
+    constexpr std::uint8_t DW_OP_rot = 0x17;
+    constexpr std::uint8_t DW_OP_abs = 0x19;
+    constexpr std::uint8_t DW_OP_and = 0x1A;
+    constexpr std::uint8_t DW_OP_div = 0x1B;
+    constexpr std::uint8_t DW_OP_minus = 0x1C;
+    constexpr std::uint8_t DW_OP_mod = 0x1D;
+    constexpr std::uint8_t DW_OP_mul = 0x1E;
+    constexpr std::uint8_t DW_OP_neg = 0x1F;
+    constexpr std::uint8_t DW_OP_not = 0x20;
+    constexpr std::uint8_t DW_OP_or = 0x21;
+    constexpr std::uint8_t DW_OP_plus = 0x22;
+    constexpr std::uint8_t DW_OP_plus_uconst = 0x23;
+    constexpr std::uint8_t DW_OP_shl = 0x24;
+    constexpr std::uint8_t DW_OP_shr = 0x25;
+    constexpr std::uint8_t DW_OP_shra = 0x26;
+    constexpr std::uint8_t DW_OP_xor = 0x27;
+    constexpr std::uint8_t DW_OP_bra = 0x28;
+    constexpr std::uint8_t DW_OP_eq = 0x29;
+    constexpr std::uint8_t DW_OP_ge = 0x2A;
+    constexpr std::uint8_t DW_OP_gt = 0x2B;
+    constexpr std::uint8_t DW_OP_le = 0x2C;
+    constexpr std::uint8_t DW_OP_lt = 0x2D;
+    constexpr std::uint8_t DW_OP_ne = 0x2E;
+    constexpr std::uint8_t DW_OP_skip = 0x2F;
+    constexpr std::uint8_t DW_OP_lit0 = 0x30;
+    constexpr std::uint8_t DW_OP_lit31 = 0x4F;
+    constexpr std::uint8_t DW_OP_breg0 = 0x70;
+    constexpr std::uint8_t DW_OP_breg31 = 0x8F;
+    constexpr std::uint8_t DW_OP_bregx = 0x92;
+    constexpr std::uint8_t DW_OP_deref_size = 0x94;
+    constexpr std::uint8_t DW_OP_nop = 0x96;
+
+    // Bounds the work on a corrupted or looping expression
+    constexpr unsigned expression_max_steps = 1024;
+
+    std::span<const std::uint8_t> block(Reader &reader, std::uint64_t size) {
+      if (size > reader.remaining()) {
+        reader.skip(size);
+        return {};
+      }
+      std::span<const std::uint8_t> data(reader.position(), size);
+      reader.skip(size);
+      return data;
+    }
+
+    /**
+     * @param fieldAddress Elf address of the value, for the pc-relative ones
+     * @return nullopt if omitted or relative to something else than the field (text, data, function)
+     */
+    std::optional<std::uint64_t> readEncoded(Reader &reader, std::uint8_t encoding, addr_t fieldAddress) {
+      if (encoding == DW_EH_PE_omit) return std::nullopt;
+      std::uint64_t value;
+      switch (encoding & 0x0F) {
+        case 0x00:
+          value = reader.fixed(sizeof(addr_t));
+          break;
+        case 0x01:
+          value = reader.uleb();
+          break;
+        case 0x02:
+          value = reader.fixed(2);
+          break;
+        case 0x03:
+          value = reader.fixed(4);
+          break;
+        case 0x04:
+        case 0x0C:
+          value = reader.fixed(8);
+          break;
+        case 0x09:
+          value = reader.sleb();
+          break;
+        case 0x0A:
+          value = (std::int16_t) reader.fixed(2);
+          break;
+        case 0x0B:
+          value = (std::int32_t) reader.fixed(4);
+          break;
+        default:
+          return std::nullopt;
+      }
+      switch (encoding & 0x70) {
+        case 0:
+          return value;
+        case DW_EH_PE_pcrel:
+          return value + fieldAddress;
+        default:
+          return std::nullopt;
+      }
+    }
+}
+
+void FrameTable::index() const {
+  std::call_once(indexed, [this] {
+      if (elf_file == nullptr) return;
+      auto section = elf_file->getSectionData(".eh_frame");
+      if (!section.empty())
+        indexSection(section, elf_file->getSectionAddress(".eh_frame"), true);
+      else
+        indexSection(elf_file->getSectionData(".debug_frame"), 0, false);
+      std::sort(fdes.begin(), fdes.end(), [](const Fde &a, const Fde &b) { return a.begin < b.begin; });
+      ExclusiveIO::debug_f("FrameTable::index(): %zu FDEs, %zu CIEs\n", fdes.size(), cies.size());
+  });
+}
+
+void FrameTable::indexSection(std::span<const std::uint8_t> section, addr_t address, bool ehFrame) const {
+  std::unordered_map<std::size_t, std::uint32_t> ciesByOffset;
+  auto addressOf = [&section, address](const std::uint8_t *position) { return address + (position - section.data()); };
+
+  // Body of the entry at the offset, past its length & ID (at idOffset); nullopt past the end
+  auto entryAt = [&section, ehFrame](std::size_t offset, std::uint64_t &id, std::size_t &idOffset,
+                            std::size_t &size) -> std::optional<Reader> {
+      if (offset >= section.size()) return std::nullopt;
+      Reader reader(section.subspan(offset));
+      std::uint64_t length = reader.fixed(4);
+      unsigned idSize = 4;
+      if (length == 0xFFFFFFFF) {
+        length = reader.fixed(8);
+        idSize = 8;
+      }
+      if (reader.failed || length < idSize || length > reader.remaining()) return std::nullopt;
+      idOffset = reader.position() - section.data();
+      size = idOffset - offset + length;
+      Reader body(std::span<const std::uint8_t>(reader.position(), length));
+      id = body.fixed(idSize);
+      if (!ehFrame && idSize == 4 && id == 0xFFFFFFFF) id = ~0ull;
+      return body;
+  };
+
+  auto cieAt = [&](std::size_t offset) -> std::optional<std::uint32_t> {
+      if (auto known = ciesByOffset.find(offset); known != ciesByOffset.end()) return known->second;
+      std::uint64_t id;
+      std::size_t idOffset, size;
+      auto reader = entryAt(offset, id, idOffset, size);
+      if (!reader || id != (ehFrame ? 0 : ~0ull)) return std::nullopt;
+      Cie cie;
+      auto version = reader->u8();
+      auto augmentation = reader->string();
+      if (augmentation.find("eh") != std::string_view::npos) reader->skip(sizeof(addr_t));
+      if (!ehFrame && version >= 4) reader->skip(2); // address & segment selector sizes
+      cie.codeAlignment = reader->uleb();
+      cie.dataAlignment = reader->sleb();
+      cie.returnAddressRegister = version == 1 ? reader->u8() : reader->uleb();
+      if (augmentation.starts_with('z')) {
+        cie.augmented = true;
+        auto length = reader->uleb();
+        auto end = reader->position() + length;
+        for (auto c: augmentation.substr(1)) {
+          if (c == 'R')
+            cie.fdeEncoding = reader->u8();
+          else if (c == 'P') {
+            auto encoding = reader->u8();
+            (void) readEncoded(*reader, encoding & 0x7F, addressOf(reader->position()));
+          } else if (c == 'L')
+            reader->u8();
+          else if (c == 'S')
+            cie.signalFrame = true;
+          else if (c != 'B')
+            break;
+        }
+        if (end < reader->position() || (std::size_t) (end - reader->position()) > reader->remaining())
+          return std::nullopt;
+        reader->skip(end - reader->position());
+      } else if (!augmentation.empty() && augmentation != "eh")
+        return std::nullopt;
+      if (reader->failed) return std::nullopt;
+      cie.instructions = block(*reader, reader->remaining());
+      ciesByOffset[offset] = cies.size();
+      cies.push_back(cie);
+      return cies.size() - 1;
+  };
+
+  for (std::size_t offset = 0, size = 0; offset < section.size(); offset += size) {
+    std::uint64_t id;
+    std::size_t idOffset;
+    auto reader = entryAt(offset, id, idOffset, size);
+    if (!reader) break; // the zero terminator of .eh_frame, or a truncated entry
+    if (id == (ehFrame ? 0 : ~0ull)) continue;
+
+    // .eh_frame: backwards from the ID field, .debug_frame: from the start of the section
+    auto cieIndex = cieAt(ehFrame ? idOffset - id : id);
+    if (!cieIndex) continue;
+    const auto &cie = cies[*cieIndex];
+    Fde fde{};
+    fde.cie = *cieIndex;
+    if (ehFrame) {
+      auto begin = readEncoded(*reader, cie.fdeEncoding, addressOf(reader->position()));
+      auto range = readEncoded(*reader, cie.fdeEncoding & 0x0F, 0);
+      if (!begin || !range) continue;
+      fde.begin = *begin;
+      fde.end = *begin + *range;
+    } else {
+      fde.begin = reader->fixed(sizeof(addr_t));
+      fde.end = fde.begin + reader->fixed(sizeof(addr_t));
+    }
+    if (cie.augmented) reader->skip(reader->uleb());
+    // Discarded functions keep an empty FDE
+    if (reader->failed || fde.begin >= fde.end || fde.begin == 0) continue;
+    fde.instructions = block(*reader, reader->remaining());
+    fdes.push_back(fde);
+  }
+}
+
+bool FrameTable::execute(std::span<const std::uint8_t> instructions, const Cie &cie, addr_t location,
+                         addr_t target, FrameRow &row, const FrameRow *initial) {
+  Reader reader(instructions);
+  std::vector<FrameRow> remembered;
+  auto setRule = [&row](std::uint64_t reg, RegisterRule::Kind kind, std::int64_t value = 0,
+                         std::span<const std::uint8_t> expression = {}) {
+      // The others (vector registers, ...) don't matter to find the caller
+      if (reg < cfi_register_count) row.registers[reg] = {kind, value, expression};
+  };
+  auto restore = [&row, initial](std::uint64_t reg) {
+      if (reg < cfi_register_count) row.registers[reg] = initial != nullptr ? initial->registers[reg] : RegisterRule{};
+  };
+  auto advance = [&location, &cie, target](std::uint64_t delta) {
+      location += delta * cie.codeAlignment;
+      return location > target;
+  };
+
+  while (reader.remaining() > 0 && !reader.failed) {
+    auto opcode = reader.u8();
+    auto operand = opcode & 0x3F;
+    switch (opcode & 0xC0) {
+      case DW_CFA_advance_loc:
+        if (advance(operand)) return true;
+        continue;
+      case DW_CFA_offset:
+        setRule(operand, RegisterRule::Kind::Offset, (std::int64_t) reader.uleb() * cie.dataAlignment);
+        continue;
+      case DW_CFA_restore:
+        restore(operand);
+        continue;
+      default:
+        break;
+    }
+
+    std::uint64_t reg;
+    switch (opcode) {
+      case DW_CFA_nop:
+        break;
+      case DW_CFA_set_loc:
+        location = reader.fixed(sizeof(addr_t));
+        if (location > target) return true;
+        break;
+      case DW_CFA_advance_loc1:
+        if (advance(reader.u8())) return true;
+        break;
+      case DW_CFA_advance_loc2:
+        if (advance(reader.fixed(2))) return true;
+        break;
+      case DW_CFA_advance_loc4:
+        if (advance(reader.fixed(4))) return true;
+        break;
+      case DW_CFA_offset_extended:
+        reg = reader.uleb();
+        setRule(reg, RegisterRule::Kind::Offset, (std::int64_t) reader.uleb() * cie.dataAlignment);
+        break;
+      case DW_CFA_offset_extended_sf:
+        reg = reader.uleb();
+        setRule(reg, RegisterRule::Kind::Offset, reader.sleb() * cie.dataAlignment);
+        break;
+      case DW_CFA_GNU_negative_offset_extended:
+        reg = reader.uleb();
+        setRule(reg, RegisterRule::Kind::Offset, -(std::int64_t) reader.uleb() * cie.dataAlignment);
+        break;
+      case DW_CFA_val_offset:
+        reg = reader.uleb();
+        setRule(reg, RegisterRule::Kind::ValOffset, (std::int64_t) reader.uleb() * cie.dataAlignment);
+        break;
+      case DW_CFA_val_offset_sf:
+        reg = reader.uleb();
+        setRule(reg, RegisterRule::Kind::ValOffset, reader.sleb() * cie.dataAlignment);
+        break;
+      case DW_CFA_restore_extended:
+        restore(reader.uleb());
+        break;
+      case DW_CFA_undefined:
+        setRule(reader.uleb(), RegisterRule::Kind::Undefined);
+        break;
+      case DW_CFA_same_value:
+        setRule(reader.uleb(), RegisterRule::Kind::SameValue);
+        break;
+      case DW_CFA_register:
+        reg = reader.uleb();
+        setRule(reg, RegisterRule::Kind::Register, (std::int64_t) reader.uleb());
+        break;
+      case DW_CFA_expression:
+      case DW_CFA_val_expression: {
+        reg = reader.uleb();
+        auto kind = opcode == DW_CFA_expression ? RegisterRule::Kind::Expression : RegisterRule::Kind::ValExpression;
+        setRule(reg, kind, 0, block(reader, reader.uleb()));
+        break;
+      }
+      case DW_CFA_remember_state:
+        remembered.push_back(row);
+        break;
+      case DW_CFA_restore_state:
+        if (remembered.empty()) return false;
+        row = remembered.back();
+        remembered.pop_back();
+        break;
+      case DW_CFA_def_cfa:
+        row.cfaRegister = reader.uleb();
+        row.cfaOffset = (std::int64_t) reader.uleb();
+        row.cfaExpression = {};
+        break;
+      case DW_CFA_def_cfa_sf:
+        row.cfaRegister = reader.uleb();
+        row.cfaOffset = reader.sleb() * cie.dataAlignment;
+        row.cfaExpression = {};
+        break;
+      case DW_CFA_def_cfa_register:
+        row.cfaRegister = reader.uleb();
+        row.cfaExpression = {};
+        break;
+      case DW_CFA_def_cfa_offset:
+        row.cfaOffset = (std::int64_t) reader.uleb();
+        break;
+      case DW_CFA_def_cfa_offset_sf:
+        row.cfaOffset = reader.sleb() * cie.dataAlignment;
+        break;
+      case DW_CFA_def_cfa_expression:
+        row.cfaExpression = block(reader, reader.uleb());
+        break;
+      case DW_CFA_GNU_args_size:
+        reader.uleb();
+        break;
+      default:
+        ExclusiveIO::debugError_f("FrameTable::execute(): unknown instruction 0x%02x\n", opcode);
+        return false;
+    }
+  }
+  return !reader.failed;
+}
+
+bool FrameTable::findRow(addr_t address, FrameRow &row) const {
+  index();
+  auto it = std::upper_bound(fdes.cbegin(), fdes.cend(), address,
+                             [](addr_t value, const Fde &fde) { return value < fde.begin; });
+  if (it == fdes.cbegin()) return false;
+  const auto &fde = *--it;
+  if (address >= fde.end) return false;
+
+  const auto &cie = cies[fde.cie];
+  FrameRow initial;
+  initial.returnAddressRegister = cie.returnAddressRegister;
+  initial.signalFrame = cie.signalFrame;
+  if (!execute(cie.instructions, cie, fde.begin, ~(addr_t) 0, initial, nullptr)) return false;
+  row = initial;
+  return execute(fde.instructions, cie, fde.begin, address, row, &initial);
+}
+
+std::optional<std::uint64_t>
+dwarf::evaluate(std::span<const std::uint8_t> expression, std::optional<std::uint64_t> initial,
+                const std::function<std::optional<std::uint64_t>(unsigned)> &readRegister,
+                const std::function<std::optional<std::uint64_t>(addr_t)> &readMemory) {
+  std::vector<std::uint64_t> stack;
+  if (initial) stack.push_back(*initial);
+  Reader reader(expression);
+  auto pop = [&stack]() -> std::optional<std::uint64_t> {
+      if (stack.empty()) return std::nullopt;
+      auto value = stack.back();
+      stack.pop_back();
+      return value;
+  };
+
+  for (unsigned step = 0; reader.remaining() > 0; step++) {
+    if (step >= expression_max_steps || reader.failed) return std::nullopt;
+    auto opcode = reader.u8();
+    if (opcode >= DW_OP_lit0 && opcode <= DW_OP_lit31) {
+      stack.push_back(opcode - DW_OP_lit0);
+      continue;
+    }
+    if ((opcode >= DW_OP_breg0 && opcode <= DW_OP_breg31) || opcode == DW_OP_bregx) {
+      auto reg = opcode == DW_OP_bregx ? (unsigned) reader.uleb() : opcode - DW_OP_breg0;
+      auto value = readRegister(reg);
+      if (!value) return std::nullopt;
+      stack.push_back(*value + reader.sleb());
+      continue;
+    }
+    switch (opcode) {
+      case DW_OP_addr:
+        stack.push_back(reader.fixed(sizeof(addr_t)));
+        break;
+      case DW_OP_const1u:
+        stack.push_back(reader.u8());
+        break;
+      case DW_OP_const1s:
+        stack.push_back((std::int8_t) reader.u8());
+        break;
+      case DW_OP_const2u:
+        stack.push_back(reader.fixed(2));
+        break;
+      case DW_OP_const2s:
+        stack.push_back((std::int16_t) reader.fixed(2));
+        break;
+      case DW_OP_const4u:
+        stack.push_back(reader.fixed(4));
+        break;
+      case DW_OP_const4s:
+        stack.push_back((std::int32_t) reader.fixed(4));
+        break;
+      case DW_OP_const8u:
+      case DW_OP_const8s:
+        stack.push_back(reader.fixed(8));
+        break;
+      case DW_OP_constu:
+        stack.push_back(reader.uleb());
+        break;
+      case DW_OP_consts:
+        stack.push_back(reader.sleb());
+        break;
+      case DW_OP_dup:
+        if (stack.empty()) return std::nullopt;
+        stack.push_back(stack.back());
+        break;
+      case DW_OP_drop:
+        if (!pop()) return std::nullopt;
+        break;
+      case DW_OP_over:
+        if (stack.size() < 2) return std::nullopt;
+        stack.push_back(stack[stack.size() - 2]);
+        break;
+      case DW_OP_pick: {
+        auto index = reader.u8();
+        if (index >= stack.size()) return std::nullopt;
+        stack.push_back(stack[stack.size() - 1 - index]);
+        break;
+      }
+      case DW_OP_swap:
+        if (stack.size() < 2) return std::nullopt;
+        std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+        break;
+      case DW_OP_rot:
+        if (stack.size() < 3) return std::nullopt;
+        std::rotate(stack.end() - 3, stack.end() - 1, stack.end());
+        break;
+      case DW_OP_deref:
+      case DW_OP_deref_size: {
+        auto size = opcode == DW_OP_deref ? sizeof(addr_t) : reader.u8();
+        auto address = pop();
+        if (!address || size == 0 || size > sizeof(std::uint64_t)) return std::nullopt;
+        auto value = readMemory(*address);
+        if (!value) return std::nullopt;
+        stack.push_back(size == sizeof(std::uint64_t) ? *value : *value & ((std::uint64_t(1) << (size * 8)) - 1));
+        break;
+      }
+      case DW_OP_abs:
+      case DW_OP_neg:
+      case DW_OP_not:
+      case DW_OP_plus_uconst: {
+        auto value = pop();
+        if (!value) return std::nullopt;
+        auto signedValue = (std::int64_t) *value;
+        // Negated unsigned: INT64_MIN wraps to itself instead of overflowing
+        if (opcode == DW_OP_abs) stack.push_back(signedValue < 0 ? 0 - *value : *value);
+        else if (opcode == DW_OP_neg) stack.push_back(0 - *value);
+        else if (opcode == DW_OP_not) stack.push_back(~*value);
+        else stack.push_back(*value + reader.uleb());
+        break;
+      }
+      case DW_OP_and:
+      case DW_OP_div:
+      case DW_OP_minus:
+      case DW_OP_mod:
+      case DW_OP_mul:
+      case DW_OP_or:
+      case DW_OP_plus:
+      case DW_OP_shl:
+      case DW_OP_shr:
+      case DW_OP_shra:
+      case DW_OP_xor:
+      case DW_OP_eq:
+      case DW_OP_ge:
+      case DW_OP_gt:
+      case DW_OP_le:
+      case DW_OP_lt:
+      case DW_OP_ne: {
+        auto b = pop(), a = pop();
+        if (!a || !b) return std::nullopt;
+        auto sa = (std::int64_t) *a, sb = (std::int64_t) *b;
+        std::uint64_t result;
+        switch (opcode) {
+          case DW_OP_and: result = *a & *b; break;
+          case DW_OP_div:
+            // INT64_MIN / -1 overflows: SIGFPE on x86-64
+            if (sb == 0 || (sa == INT64_MIN && sb == -1)) return std::nullopt;
+            result = sa / sb;
+            break;
+          case DW_OP_minus: result = *a - *b; break;
+          case DW_OP_mod:
+            if (*b == 0) return std::nullopt;
+            result = *a % *b;
+            break;
+          case DW_OP_mul: result = *a * *b; break;
+          case DW_OP_or: result = *a | *b; break;
+          case DW_OP_plus: result = *a + *b; break;
+          case DW_OP_shl: result = *b < 64 ? *a << *b : 0; break;
+          case DW_OP_shr: result = *b < 64 ? *a >> *b : 0; break;
+          case DW_OP_shra: result = *b < 64 ? sa >> *b : (sa < 0 ? -1 : 0); break;
+          case DW_OP_xor: result = *a ^ *b; break;
+          case DW_OP_eq: result = sa == sb; break;
+          case DW_OP_ge: result = sa >= sb; break;
+          case DW_OP_gt: result = sa > sb; break;
+          case DW_OP_le: result = sa <= sb; break;
+          case DW_OP_lt: result = sa < sb; break;
+          default: result = sa != sb; break;
+        }
+        stack.push_back(result);
+        break;
+      }
+      case DW_OP_skip:
+      case DW_OP_bra: {
+        auto offset = (std::int16_t) reader.fixed(2);
+        if (opcode == DW_OP_bra) {
+          auto condition = pop();
+          if (!condition) return std::nullopt;
+          if (*condition == 0) break;
+        }
+        auto target = (reader.position() - expression.data()) + offset;
+        if (target < 0 || (std::size_t) target > expression.size()) return std::nullopt;
+        reader = Reader(expression.subspan(target));
+        break;
+      }
+      case DW_OP_nop:
+        break;
+      default:
+        // DW_OP_reg* (a register itself, not an address), calls, TLS, ...: not found in the CFI
+        ExclusiveIO::debugError_f("dwarf::evaluate(): unsupported operation 0x%02x\n", opcode);
+        return std::nullopt;
+    }
+  }
+  if (reader.failed) return std::nullopt;
+  return pop();
+}
@@ -7,11 +7,35 @@
 #include <iostream>
 #include <fstream>
 #include <execution>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cxxabi.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
 
 #include "bdd_elf.hpp"
 
 using namespace elf;
 
+namespace {
+    // Decoding unit of the symbol tables: big enough to amortize the scheduling, small enough to balance
+    constexpr unsigned symbols_per_chunk = 16384;
+}
+
+std::string elf::demangle(std::string_view name) {
+  if (!name.starts_with("_Z")) return std::string(name);
+  int status = 0;
+  auto demangled = abi::__cxa_demangle(std::string(name).c_str(), nullptr, nullptr, &status);
+  std::string result = status == 0 && demangled != nullptr ? demangled : std::string(name);
+  free(demangled);
+  return result;
+}
+
 void ElfFile::printHeader(FILE *fp) const {
   fprintf
       (fp,
@@ -46,7 +70,7 @@ void ElfFile::printHeader(FILE *fp) const {
 }
 
 
-bool elf::isElfFile(Elf_Ehdr &header) {
+bool elf::isElfFile(const Elf_Ehdr &header) {
   return header.e_ident[0] == ELFMAG0
          && header.e_ident[1] == ELFMAG1    /* E */
          && header.e_ident[2] == ELFMAG2    /* L */
@@ -65,7 +89,8 @@ std::string getFlagsAsString(unsigned int flags) {
 }
 
 void ElfFile::printProgramHeaderAt(int index, FILE *fp) const {
-  auto pHeader = programHeaders.at(index);
+  if (index < 0 || index >= programHeaders.size()) return;
+  const auto &pHeader = programHeaders[index];
   fprintf
       (fp,
        "\n\tProgram header [%d]:\n"
@@ -89,7 +114,7 @@ void ElfFile::printProgramHeaderAt(int index, FILE *fp) const {
       );
 }
 
-void ElfFile::printSymbolEntry(unsigned index, const Elf_SymRef &sym, const Elf_Shdr &sHdr, FILE *fp) {
+void ElfFile::printSymbolEntry(unsigned index, const Elf_SymRef &sym, const Elf_Shdr &sHdr, FILE *fp) const {
   fprintf
       (fp,
        "    ### Symbol (%u):\n"
@@ -104,7 +129,7 @@ void ElfFile::printSymbolEntry(unsigned index, const Elf_SymRef &sym, const Elf_
        "    \n",
        index,
        sym.st_name,
-       getSymbolName(sHdr, sym).c_str(),
+       getSymbolName(sHdr, sym),
        getSymbolTypeAsString(sym).c_str(),
        getSymbolBindingAsString(sym).c_str(),
        sym.st_shndx,
@@ -119,11 +144,11 @@ ElfFile::getSymbolSectionAt(unsigned int index, unsigned offset) const {
   return *((Elf_SymRef *) (getSectionDataPtrAt(index) + offset));
 }
 
-void ElfFile::printSymbolEntries(FILE *fp) {
+void ElfFile::printSymbolEntries(FILE *fp) const {
   auto headers = getSectionHeaderIndexesByType(Elf_SectionTypeLinkerSymbolTable);
   unsigned index = 0;
   std::for_each(headers.cbegin(), headers.cend(), [fp, &index, this](const unsigned &e) {
-      Elf_Shdr sHdr = sectionsHeaders.at(e);
+      const Elf_Shdr &sHdr = sectionsHeaders[e];
       for (unsigned i = 0; i < getSymbolCount(sHdr); i++)
         printSymbolEntry(i, getSymbolSectionAt(e, i * sHdr.sh_entsize), sHdr, fp);
       index += 1;
@@ -165,7 +190,7 @@ std::string ElfFile::getSectionTypeAsString(const Elf_Shdr &sHeader) {
 
 void ElfFile::printSectionHeaderAt(int index, FILE *fp) const {
   if (index < 0 || index >= sectionsHeaders.size()) return;
-  auto sHeader = sectionsHeaders.at(index);
+  const auto &sHeader = sectionsHeaders[index];
   fprintf
       (fp,
        "\n\tSection header (%d):\n"
@@ -180,7 +205,7 @@ void ElfFile::printSectionHeaderAt(int index, FILE *fp) const {
        "\t\t- Section alignment:                  %lu\n"
        "\t\t- Entry size if section holds table:  %lu\n",
        index,
-       sHeader.sh_name, getSectionName(sHeader).c_str(),
+       sHeader.sh_name, getSectionName(sHeader),
        sHeader.sh_type, getSectionTypeAsString(sHeader).c_str(),
        sHeader.sh_flags, getFlagsAsString(sHeader.sh_flags).c_str(),
        sHeader.sh_addr,
@@ -193,67 +218,173 @@ void ElfFile::printSectionHeaderAt(int index, FILE *fp) const {
       );
 }
 
-void ElfFile::printSectionsHeaders(FILE *fp) {
+void ElfFile::printSectionsHeaders(FILE *fp) const {
   for (int i = 0; i < sectionsHeaders.size(); i++)
     printSectionHeaderAt(i, fp);
 }
 
 
-ElfFile::ElfFile(const std::string &elf_filepath) {
-  std::ifstream input;
-  input.open(elf_filepath);
-  if (input.fail()) throw std::invalid_argument("Bad input: file.initialize() failed");
+ElfStorage::ElfStorage(const std::string &elf_filepath, LoadMode mode) {
+  fd = open(elf_filepath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw std::invalid_argument("Bad input: file.initialize() failed");
+  struct stat st{};
+  if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+    close(fd);
+    throw std::invalid_argument("Bad input: empty or unreadable file");
+  }
+  length = (std::size_t) st.st_size;
+  modification = st.st_mtim.tv_sec * 1000000000L + st.st_mtim.tv_nsec;
+  if (mode == LoadMode::Copied) return;
+
+  // Nothing is read here: pages come in on their first access
+  auto mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  fd = -1;
+  if (mapping == MAP_FAILED) throw std::invalid_argument("Bad input: mmap() failed");
+  bytes = (const char *) mapping;
+  mapped = true;
+}
+
+ElfStorage::~ElfStorage() {
+  if (mapped && bytes != nullptr)
+    munmap((void *) bytes, length);
+  if (fd >= 0) close(fd);
+}
+
+const char *ElfStorage::load(std::size_t offset, std::size_t size, std::vector<char> &buffer) const {
+  if (offset > length || size > length - offset) return nullptr;
+  if (mapped) return bytes + offset;
+
+  buffer.resize(size);
+  std::size_t done = 0;
+  while (done < size) {
+    auto rc = pread(fd, buffer.data() + done, size - done, (off_t) (offset + done));
+    if (rc < 0 && errno == EINTR) continue;
+    if (rc <= 0) {
+      buffer.clear();
+      return nullptr;
+    }
+    done += rc;
+  }
+  return buffer.data();
+}
+
+void ElfStorage::willNeed(std::size_t offset, std::size_t size) const {
+  if (offset > length || size > length - offset || size == 0) return;
+  if (!mapped) {
+    posix_fadvise(fd, (off_t) offset, (off_t) size, POSIX_FADV_WILLNEED);
+    return;
+  }
+  static const std::size_t page_size = sysconf(_SC_PAGESIZE);
+  auto first = offset & ~(page_size - 1);
+  madvise((void *) (bytes + first), size + offset - first, MADV_WILLNEED);
+}
+
+
+ElfFile::ElfFile(const std::string &elf_filepath, LoadMode mode) {
+  storage = std::make_unique<const ElfStorage>(elf_filepath, mode);
+  auto size = storage->size();
 
 #pragma region Elf Header
-  std::string header_data;
-  header_data.resize(64);
-  input.read(header_data.data(), (int) header_data.size());
-  auto headerPtr = (Elf_Ehdr *) ((addr_t) header_data.data());
-  if (headerPtr == nullptr) throw std::invalid_argument("Null pointer: Elf header");
-  header = *headerPtr;
-  header_data.clear();
+  std::vector<char> headerBytes;
+  auto headerData = storage->load(0, sizeof(Elf_Ehdr), headerBytes);
+  if (headerData == nullptr) throw std::invalid_argument("Null pointer: Elf header");
+  std::memcpy(&header, headerData, sizeof(Elf_Ehdr));
 #pragma endregion
 
   if (!isElfFile(header)) throw std::invalid_argument("Not an ELF file");
 
-#pragma region Program Deaders
-  std::string pHeaders_data;
-  pHeaders_data.resize(header.e_phentsize * header.e_phnum);
-  input.seekg((long) header.e_phoff, std::ifstream::beg);
-  input.read(pHeaders_data.data(), (int) pHeaders_data.size());
-  auto pHeadersPtr = (Elf_Phdr *) ((addr_t) pHeaders_data.data());
-  if (pHeadersPtr == nullptr) throw std::invalid_argument("Null pointer: Elf program-headers");
-  programHeaders = std::vector<Elf_Phdr>(pHeadersPtr, pHeadersPtr + header.e_phnum);
-  pHeaders_data.clear();
+#pragma region Program Headers
+  if (header.e_phnum > 0) {
+    const char *data = nullptr;
+    if (header.e_phentsize == sizeof(Elf_Phdr) && header.e_phoff + header.e_phnum * sizeof(Elf_Phdr) <= size)
+      data = storage->load(header.e_phoff, header.e_phnum * sizeof(Elf_Phdr), programHeadersBytes);
+    if (data == nullptr) throw std::invalid_argument("Null pointer: Elf program-headers");
+    programHeaders = {(const Elf_Phdr *) data, header.e_phnum};
+  }
 #pragma endregion
 
 #pragma region Section Headers
-  std::string sHeaders_data;
-  sHeaders_data.resize(header.e_shentsize * header.e_shnum);
-  input.seekg((long) header.e_shoff, std::ifstream::beg);
-  input.read(sHeaders_data.data(), (int) sHeaders_data.size());
-  auto sHeadersPtr = (Elf_Shdr *) ((addr_t) sHeaders_data.data());
-  if (sHeadersPtr == nullptr) throw std::invalid_argument("Null pointer: Elf sections-headers");
-  sectionsHeaders = std::vector<Elf_Shdr>(sHeadersPtr, sHeadersPtr + header.e_shnum);
-  sHeaders_data.clear();
+  if (header.e_shnum > 0) {
+    const char *data = nullptr;
+    if (header.e_shentsize == sizeof(Elf_Shdr) && header.e_shoff + header.e_shnum * sizeof(Elf_Shdr) <= size)
+      data = storage->load(header.e_shoff, header.e_shnum * sizeof(Elf_Shdr), sectionsHeadersBytes);
+    if (data == nullptr) throw std::invalid_argument("Null pointer: Elf sections-headers");
+    sectionsHeaders = {(const Elf_Shdr *) data, header.e_shnum};
+  }
 #pragma endregion
 
-#pragma region Sections data
-  std::vector<char> buffer;
-  std::for_each(sectionsHeaders.cbegin(), sectionsHeaders.cend(), [&buffer, &input, this](const Elf_Shdr &sHdr) {
-      buffer.resize(sHdr.sh_size);
-      input.seekg((long) sHdr.sh_offset, std::ifstream::beg);
-      input.read(buffer.data(), (int) buffer.size());
-      sectionsData.push_back(buffer);
-  });
-  buffer.clear();
-#pragma endregion
+  sections = std::make_unique<SectionData[]>(sectionsHeaders.size());
+
+  // Without a build-id, a rebuilt binary is told apart by its size & modification time
+  indexKey = getBuildId();
+  if (!indexKey.empty()) {
+    // strip keeps the build-id: the sizes of what the indexes are built from tell the copies apart
+    std::size_t symbolsSize = 0, linesSize = 0;
+    for (const auto &sHdr: sectionsHeaders) {
+      if (sHdr.sh_type == Elf_SectionTypeLinkerSymbolTable) symbolsSize += sHdr.sh_size;
+      else if (std::string_view(".debug_line") == getSectionName(sHdr)) linesSize += sHdr.sh_size;
+    }
+    char sizes[40];
+    snprintf(sizes, sizeof(sizes), "-%zx-%zx", symbolsSize, linesSize);
+    indexKey += sizes;
+  } else {
+    char fallback[64];
+    snprintf(fallback, sizeof(fallback), "path-%016zx-%zx-%lx", std::hash<std::string>{}(elf_filepath), size,
+             storage->getModificationTime());
+    indexKey = fallback;
+  }
+}
 
-  input.close();
+std::string ElfFile::getBuildId() const {
+  for (const auto &index: getSectionHeaderIndexesByType(Elf_SectionTypeNoteInformation)) {
+    const auto &sHdr = sectionsHeaders[index];
+    auto data = getSectionDataPtrAt(index);
+    if (data == nullptr) continue;
+    // Notes: header, name & description, each padded to 4 bytes
+    for (std::size_t offset = 0; offset + sizeof(Elf_Nhdr) <= sHdr.sh_size;) {
+      Elf_Nhdr note;
+      std::memcpy(&note, data + offset, sizeof(Elf_Nhdr));
+      auto name = offset + sizeof(Elf_Nhdr);
+      auto description = name + ((note.n_namesz + 3) & ~3UL);
+      auto next = description + ((note.n_descsz + 3) & ~3UL);
+      if (next > sHdr.sh_size) break;
+      if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 && std::memcmp(data + name, "GNU", 4) == 0) {
+        std::string result;
+        char digits[3];
+        for (unsigned i = 0; i < note.n_descsz; i++) {
+          snprintf(digits, sizeof(digits), "%02x", (unsigned char) data[description + i]);
+          result += digits;
+        }
+        return result;
+      }
+      offset = next;
+    }
+  }
+  return "";
+}
+
+void ElfFile::prefetch(const std::vector<std::string> &names, bool symbolIndex) const {
+  std::vector<unsigned> indexes;
+  for (unsigned i = 0; i < sectionsHeaders.size(); i++) {
+    const auto &sHdr = sectionsHeaders[i];
+    if (std::find(names.cbegin(), names.cend(), getSectionName(sHdr)) == names.cend()) continue;
+    if (sHdr.sh_type != SHT_NOBITS) storage->willNeed(sHdr.sh_offset, sHdr.sh_size);
+    indexes.push_back(i);
+  }
+
+  std::lock_guard lock(prefetchMutex);
+  prefetchers.emplace_back([this, indexes, symbolIndex](const std::stop_token &stop) {
+      for (auto index: indexes) {
+        if (stop.stop_requested()) return;
+        (void) getSectionDataPtrAt(index);
+      }
+      if (symbolIndex && !stop.stop_requested()) ensureSymbolIndex();
+  });
 }
 
 Elf_Shdr ElfFile::getSectionHeaderByType(Elf_SectionType type) const {
-  return *std::find_if(std::execution::par, sectionsHeaders.cbegin(), sectionsHeaders.cend(),
+  return *std::find_if(std::execution::par, sectionsHeaders.begin(), sectionsHeaders.end(),
                        [type](const Elf_Shdr &each) {
                            return each.sh_type == type;
                        });
@@ -262,7 +393,7 @@ Elf_Shdr ElfFile::getSectionHeaderByType(Elf_SectionType type) const {
 std::vector<unsigned> ElfFile::getSectionHeaderIndexesByType(Elf_SectionType type) const {
   std::vector<unsigned> headers;
   unsigned current = 0;
-  std::for_each(sectionsHeaders.cbegin(), sectionsHeaders.cend(), [&current, &headers, type](const Elf_Shdr &each) {
+  std::for_each(sectionsHeaders.begin(), sectionsHeaders.end(), [&current, &headers, type](const Elf_Shdr &each) {
       if (each.sh_type == type) headers.push_back(current);
       current++;
   });
@@ -271,7 +402,7 @@ std::vector<unsigned> ElfFile::getSectionHeaderIndexesByType(Elf_SectionType typ
 
 std::vector<Elf_Shdr> ElfFile::getSectionsHeaderByType(Elf_SectionType type) const {
   std::vector<Elf_Shdr> headers;
-  std::for_each(sectionsHeaders.cbegin(), sectionsHeaders.cend(), [&headers, type](const Elf_Shdr &each) {
+  std::for_each(sectionsHeaders.begin(), sectionsHeaders.end(), [&headers, type](const Elf_Shdr &each) {
       if (each.sh_type == type) headers.push_back(each);
   });
   return headers;
@@ -294,19 +425,18 @@ std::string ElfFile::getSymbolTypeAsString(const Elf_SymRef &sym) {
   }
 }
 
-std::string ElfFile::getNameFromStringTable(unsigned strTableIndex, unsigned offset) const {
+const char *ElfFile::getNameFromStringTable(unsigned strTableIndex, unsigned offset) const {
   auto data_ptr = getSectionDataPtrAt(strTableIndex);
-  if (data_ptr == nullptr) return "Unnamed";
+  if (data_ptr == nullptr || offset >= sectionsHeaders[strTableIndex].sh_size) return "Unnamed";
   return data_ptr + offset;
 }
 
-std::string ElfFile::getSectionName(const Elf_Shdr &sHeader) const {
+const char *ElfFile::getSectionName(const Elf_Shdr &sHeader) const {
   return getNameFromStringTable(header.e_shstrndx, sHeader.sh_name);
 }
 
-std::string ElfFile::getSymbolName(const Elf_Shdr &sHeader, const Elf_SymRef &sym) const {
-  auto raw_name = getNameFromStringTable(sHeader.sh_link, sym.st_name);
-  return raw_name.c_str();
+const char *ElfFile::getSymbolName(const Elf_Shdr &sHeader, const Elf_SymRef &sym) const {
+  return getNameFromStringTable(sHeader.sh_link, sym.st_name);
 }
 
 std::string ElfFile::getSymbolBindingAsString(const Elf_SymRef &sym) {
@@ -323,36 +453,214 @@ std::string ElfFile::getSymbolBindingAsString(const Elf_SymRef &sym) {
 }
 
 const char *ElfFile::getSectionDataPtrAt(unsigned int index) const {
-  if (index >= sectionsData.size()) return nullptr;
-  return sectionsData.at(index).data();
+  if (index >= sectionsHeaders.size()) return nullptr;
+  const auto &sHdr = sectionsHeaders[index];
+  if (sHdr.sh_type == SHT_NOBITS) return nullptr;
+  auto &section = sections[index];
+  std::call_once(section.loaded, [this, &sHdr, &section] {
+      section.data = storage->load(sHdr.sh_offset, sHdr.sh_size, section.owned);
+  });
+  return section.data;
 }
 
-std::vector<std::pair<addr_t, std::string>> ElfFile::getFunctionsList() const {
-  std::vector<std::pair<addr_t, std::string>> functions;
-  auto symbolHeaders = getSectionHeaderIndexesByType(Elf_SectionTypeLinkerSymbolTable);
-  for (const auto &e: symbolHeaders) {
-    Elf_Shdr sHdr = sectionsHeaders.at(e);
-    for (unsigned i = 0; i < getSymbolCount(sHdr); i++) {
-      Elf_SymRef symbolSectionData = getSymbolSectionAt(e, i * sHdr.sh_entsize);
-      if ((symbolSectionData.st_info & 0x0F) != Elf_SymbolTypeFunctionEntryPoint) continue;
-      auto address = symbolSectionData.st_value;
-      auto name = getSymbolName(sHdr, symbolSectionData);
-      if (!name.empty())
-        functions.emplace_back(address, name.substr(0, name.find('(')));
+std::vector<char> ElfFile::copySectionDataAt(unsigned index) const {
+  auto data_ptr = getSectionDataPtrAt(index);
+  if (data_ptr == nullptr) return {};
+  return {data_ptr, data_ptr + sectionsHeaders[index].sh_size};
+}
+
+std::span<const std::uint8_t> ElfFile::getCodeAt(addr_t address) const {
+  for (unsigned i = 0; i < sectionsHeaders.size(); i++) {
+    const Elf_Shdr &sHdr = sectionsHeaders[i];
+    if (!(sHdr.sh_flags & SHF_EXECINSTR) || address < sHdr.sh_addr || address >= sHdr.sh_addr + sHdr.sh_size)
+      continue;
+    auto data_ptr = getSectionDataPtrAt(i);
+    if (data_ptr == nullptr) return {};
+    auto offset = address - sHdr.sh_addr;
+    return {reinterpret_cast<const std::uint8_t *>(data_ptr) + offset, sHdr.sh_size - offset};
+  }
+  return {};
+}
+
+std::span<const std::uint8_t> ElfFile::getSectionData(std::string_view name) const {
+  for (unsigned i = 0; i < sectionsHeaders.size(); i++) {
+    const Elf_Shdr &sHdr = sectionsHeaders[i];
+    if (name != getSectionName(sHdr)) continue;
+    auto data_ptr = getSectionDataPtrAt(i);
+    if (data_ptr == nullptr || (sHdr.sh_flags & SHF_COMPRESSED)) return {};
+    return {reinterpret_cast<const std::uint8_t *>(data_ptr), sHdr.sh_size};
+  }
+  return {};
+}
+
+addr_t ElfFile::getSectionAddress(std::string_view name) const {
+  for (const auto &sHdr: sectionsHeaders)
+    if (name == getSectionName(sHdr)) return sHdr.sh_addr;
+  return 0;
+}
+
+addr_t ElfFile::getLoadAddress() const {
+  for (const auto &pHdr: programHeaders)
+    if (pHdr.p_type == PT_LOAD) return (pHdr.p_vaddr - pHdr.p_offset) & ~(addr_t) 0xFFF;
+  return 0;
+}
+
+void ElfFile::ensureSymbolIndex() const {
+  std::call_once(symbolIndexBuilt, [this] { buildSymbolIndex(); });
+}
+
+void ElfFile::buildSymbolIndex() const {
+  functionSymbols.clear();
+  functionSymbolsByName.clear();
+  if (!loadSymbols()) {
+    decodeSymbols();
+    storeSymbols();
+  }
+
+  functionSymbolsByName.reserve(functionSymbols.size());
+  for (std::size_t i = 0; i < functionSymbols.size(); i++) {
+    auto [it, inserted] = functionSymbolsByName.try_emplace(functionSymbols[i].name, i);
+    // Prefer the defined symbol over an undefined (imported) one
+    if (!inserted && functionSymbols[it->second].address == 0)
+      it->second = i;
+  }
+}
+
+namespace {
+    // Saved symbol: the name is a range of the saved names
+    struct SavedSymbol {
+        std::uint64_t address;
+        std::uint64_t size;
+        std::uint64_t nameOffset;
+        std::uint64_t nameLength;
+    };
+}
+
+bool ElfFile::loadSymbols() const {
+  std::span<const char> payload;
+  auto file = cache::load(indexKey, "symbols", payload);
+  if (file == nullptr) return false;
+
+  cache::Reader reader(payload);
+  auto saved = reader.getArray<SavedSymbol>();
+  auto names = reader.getString();
+  if (!saved || !names || !reader.atEnd()) return false;
+  functionSymbols.resize(saved->size() / sizeof(SavedSymbol));
+  for (std::size_t i = 0; i < functionSymbols.size(); i++) {
+    SavedSymbol symbol;
+    std::memcpy(&symbol, saved->data() + i * sizeof(SavedSymbol), sizeof(SavedSymbol));
+    if (symbol.nameOffset > names->size() || symbol.nameLength > names->size() - symbol.nameOffset) {
+      functionSymbols.clear();
+      return false;
+    }
+    functionSymbols[i] = {symbol.address, symbol.size, names->substr(symbol.nameOffset, symbol.nameLength)};
+  }
+  cachedSymbols = std::move(file);
+  return true;
+}
+
+void ElfFile::storeSymbols() const {
+  if (indexKey.empty()) return;
+  std::vector<SavedSymbol> saved;
+  saved.reserve(functionSymbols.size());
+  std::string names;
+  for (const auto &symbol: functionSymbols) {
+    saved.push_back({symbol.address, symbol.size, names.size(), symbol.name.size()});
+    names.append(symbol.name);
+  }
+  cache::Writer writer;
+  writer.putArray<SavedSymbol>(saved);
+  writer.putString(names);
+  cache::store(indexKey, "symbols", writer);
+}
+
+void ElfFile::decodeSymbols() const {
+  // Symbol ranges of every .symtab & .dynsym, decoded in parallel
+  struct Chunk {
+      unsigned section, first, last;
+  };
+  std::vector<Chunk> chunks;
+  for (const auto type: {Elf_SectionTypeLinkerSymbolTable, Elf_SectionTypeDynamicLoaderSymbolTable}) {
+    for (const auto &e: getSectionHeaderIndexesByType(type)) {
+      const Elf_Shdr &sHdr = sectionsHeaders[e];
+      // Loaded here: the workers would wait on each other otherwise
+      if (getSectionDataPtrAt(e) == nullptr) continue;
+      (void) getSectionDataPtrAt(sHdr.sh_link);
+      auto count = getSymbolCount(sHdr);
+      for (unsigned first = 0; first < count; first += symbols_per_chunk)
+        chunks.push_back({e, first, std::min(count, first + symbols_per_chunk)});
     }
   }
+
+  std::vector<std::vector<Symbol>> decoded(chunks.size());
+  tbb::parallel_for(std::size_t(0), chunks.size(), [this, &chunks, &decoded](std::size_t index) {
+      const auto &chunk = chunks[index];
+      const Elf_Shdr &sHdr = sectionsHeaders[chunk.section];
+      auto &symbols = decoded[index];
+      for (unsigned i = chunk.first; i < chunk.last; i++) {
+        Elf_SymRef sym = getSymbolSectionAt(chunk.section, i * sHdr.sh_entsize);
+        if ((sym.st_info & 0x0F) != Elf_SymbolTypeFunctionEntryPoint) continue;
+        std::string_view name = getSymbolName(sHdr, sym);
+        name = name.substr(0, name.find('('));
+        if (!name.empty())
+          symbols.push_back({sym.st_value, sym.st_size, name});
+      }
+  });
+  std::size_t total = 0;
+  for (const auto &symbols: decoded) total += symbols.size();
+  functionSymbols.reserve(total);
+  for (const auto &symbols: decoded) functionSymbols.insert(functionSymbols.end(), symbols.cbegin(), symbols.cend());
+
+  // .symtab & .dynsym share most of their entries
+  tbb::parallel_sort(functionSymbols.begin(), functionSymbols.end(), [](const Symbol &a, const Symbol &b) {
+      return a.address != b.address ? a.address < b.address : a.name < b.name;
+  });
+  functionSymbols.erase(std::unique(functionSymbols.begin(), functionSymbols.end(),
+                                    [](const Symbol &a, const Symbol &b) {
+                                        return a.address == b.address && a.name == b.name;
+                                    }), functionSymbols.end());
+}
+
+const Symbol *ElfFile::findFunctionByName(std::string_view fct_name) const {
+  ensureSymbolIndex();
+  auto it = functionSymbolsByName.find(fct_name);
+  if (it == functionSymbolsByName.end()) return nullptr;
+  return &functionSymbols[it->second];
+}
+
+const Symbol *ElfFile::findFunctionByAddress(addr_t address) const {
+  ensureSymbolIndex();
+  auto it = std::upper_bound(functionSymbols.cbegin(), functionSymbols.cend(), address,
+                             [](addr_t addr, const Symbol &sym) { return addr < sym.address; });
+  if (it == functionSymbols.cbegin()) return nullptr;
+  auto candidate = std::prev(it);
+  // Aliases share an address: keep the first one whose range covers the address
+  auto first = candidate;
+  while (first != functionSymbols.cbegin() && std::prev(first)->address == candidate->address) first--;
+  for (auto sym = first; sym != it; sym++)
+    if (sym->size > 0 && address < sym->address + sym->size) return &*sym;
+  if (candidate->address == 0 || candidate->size > 0) return nullptr;
+  // Sizeless symbols (ex: _init) extend up to the end of their section
+  if (address >= candidate->address + getCodeAt(candidate->address).size()) return nullptr;
+  return &*candidate;
+}
+
+std::vector<std::pair<addr_t, std::string>> ElfFile::getFunctionsList() const {
+  ensureSymbolIndex();
+  std::vector<std::pair<addr_t, std::string>> functions;
+  functions.reserve(functionSymbols.size());
+  for (const auto &sym: functionSymbols)
+    functions.emplace_back(sym.address, sym.name);
   return functions;
 }
 
-addr_t ElfFile::getFunctionAddress(const std::string &fct_name) const {
-  auto list = getFunctionsList();
-  return std::find_if(std::execution::par, list.cbegin(), list.cend(),
-                      [fct_name](const std::pair<addr_t, std::string> &e) {
-                          return e.second == fct_name;
-                      })->first;
+addr_t ElfFile::getFunctionAddress(std::string_view fct_name) const {
+  auto sym = findFunctionByName(fct_name);
+  return sym == nullptr ? 0 : sym->address;
 }
 
 unsigned ElfFile::getSymbolCount(const Elf_Shdr &sHdr) {
+  if (sHdr.sh_entsize == 0) return 0;
   return (unsigned) sHdr.sh_size / sHdr.sh_entsize;
 }
 
@@ -364,4 +672,18 @@ std::vector<std::pair<std::string, std::string>> ElfFile::getSymbolsNames() cons
   return names;
 }
 
-
+std::shared_ptr<const ElfFile>
+ElfRegistry::get(const std::string &elf_filepath, const std::vector<std::string> &prefetched) {
+  char canonical[PATH_MAX];
+  std::string key = realpath(elf_filepath.c_str(), canonical) != nullptr ? canonical : elf_filepath;
+  // Parsed under the lock: two threads asking for the same file share it
+  std::lock_guard lock(mutex);
+  auto &entry = files[key];
+  auto file = entry.lock();
+  if (file == nullptr) {
+    file = std::make_shared<const ElfFile>(key);
+    entry = file;
+    if (!prefetched.empty()) file->prefetch(prefetched);
+  }
+  return file;
+}
@@ -0,0 +1,184 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bdd_event_loop.hpp"
+#include "bdd_exclusive_io.hpp"
+
+EventLoop::EventLoop() {
+  // Blocked before any other thread exists: a thread accepting SIGCHLD would take it from the signalfd
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  if (sigprocmask(SIG_BLOCK, &mask, &previous_mask) < 0)
+    throw std::invalid_argument("EventLoop: sigprocmask failed");
+
+  signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (signal_fd < 0 || timer_fd < 0 || epoll_fd < 0)
+    throw std::invalid_argument("EventLoop: signalfd/timerfd/epoll_create1 failed");
+
+  for (auto fd: {signal_fd, timer_fd}) {
+    epoll_event event{EPOLLIN, {.fd = fd}};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+      throw std::invalid_argument("EventLoop: epoll_ctl failed");
+  }
+  // Not armed until a wait asks for it (level-triggered: pending input would wake every other wait up)
+  epoll_event event{0, {.fd = STDIN_FILENO}};
+  input_watched = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0;
+}
+
+EventLoop::~EventLoop() {
+  for (auto fd: {epoll_fd, signal_fd, timer_fd})
+    if (fd >= 0) close(fd);
+  restoreSignalMask();
+}
+
+void EventLoop::restoreSignalMask() const {
+  sigprocmask(SIG_SETMASK, &previous_mask, nullptr);
+}
+
+void EventLoop::readInput() {
+  std::array<char, 4096> buffer{};
+  auto size = read(STDIN_FILENO, buffer.data(), buffer.size());
+  if (size < 0 && (errno == EINTR || errno == EAGAIN)) return;
+  if (size <= 0) {
+    input_closed = true;
+    if (!input_buffer.empty()) lines.push_back(std::move(input_buffer));
+    input_buffer.clear();
+    if (input_watched) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);
+    input_watched = false;
+    input_armed = false;
+    return;
+  }
+  input_buffer.append(buffer.data(), size);
+  for (auto end = input_buffer.find('\n'); end != std::string::npos; end = input_buffer.find('\n')) {
+    lines.push_back(input_buffer.substr(0, end));
+    input_buffer.erase(0, end + 1);
+  }
+}
+
+void EventLoop::setInputArmed(bool armed) {
+  if (!input_watched || armed == input_armed) return;
+  epoll_event event{armed ? EPOLLIN : 0u, {.fd = STDIN_FILENO}};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, STDIN_FILENO, &event) == 0) input_armed = armed;
+}
+
+EventLoop::Event EventLoop::wait(std::optional<clock::time_point> deadline, bool input) {
+  if (deadline) {
+    if (clock::now() >= *deadline) return Event::Timeout;
+    auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline->time_since_epoch()).count();
+    itimerspec spec{{0, 0}, {since_epoch / 1000000000, since_epoch % 1000000000}};
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+  }
+  bool watch_input = input && input_watched;
+  setInputArmed(watch_input);
+  // Nothing logged is left behind while sleeping (the prompt, the last event)
+  ExclusiveIO::flush();
+
+  std::optional<Event> result;
+  while (!result) {
+    std::array<epoll_event, 4> events{};
+    auto count = epoll_wait(epoll_fd, events.data(), events.size(), -1);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      result = Event::Error;
+      break;
+    }
+    bool child = false, typed = false, expired = false;
+    for (int i = 0; i < count; i++) {
+      auto fd = events[i].data.fd;
+      if (fd == signal_fd) {
+        // Coalesced: one SIGCHLD can stand for several state changes, waitpid tells them all
+        std::array<signalfd_siginfo, 16> infos{};
+        while (read(signal_fd, infos.data(), sizeof(infos)) == sizeof(infos));
+        child = true;
+      } else if (fd == timer_fd) {
+        std::uint64_t expirations;
+        expired = read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations);
+      } else if (fd == STDIN_FILENO) {
+        // Unwatched, only a hang-up is reported: read to the end of the input, then it leaves the set
+        auto queued = lines.size();
+        readInput();
+        // The end of the input is news too: nothing else may ever wake this wait up
+        typed = watch_input && (lines.size() > queued || input_closed);
+      } else if (auto it = watched.find(fd); it != watched.end()) {
+        // A copy: the handler may unwatch itself
+        auto handler = it->second;
+        handler();
+      }
+    }
+    if (child) result = Event::Child;
+    else if (typed) result = Event::Input;
+    else if (expired || (deadline && clock::now() >= *deadline)) result = Event::Timeout;
+  }
+
+  if (deadline) {
+    itimerspec disarm{};
+    timerfd_settime(timer_fd, 0, &disarm, nullptr);
+  }
+  return *result;
+}
+
+void EventLoop::watch(int fd, std::function<void()> readable) {
+  epoll_event event{EPOLLIN, {.fd = fd}};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    throw std::invalid_argument("EventLoop::watch: epoll_ctl failed");
+  watched[fd] = std::move(readable);
+}
+
+void EventLoop::unwatch(int fd) {
+  if (watched.erase(fd) > 0) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void EventLoop::reapChildren() {
+  while (true) {
+    int status;
+    auto tid = waitpid(-1, &status, __WALL | WNOHANG);
+    if (tid < 0 && errno == EINTR) continue;
+    if (tid <= 0) return;
+    reaped.emplace_back(tid, status);
+  }
+}
+
+std::optional<std::pair<pid_t, int>> EventLoop::takeStatus(const std::function<bool(pid_t)> &owns) {
+  for (auto it = reaped.begin(); it != reaped.end(); it++) {
+    if (!owns(it->first)) continue;
+    auto status = *it;
+    reaped.erase(it);
+    return status;
+  }
+  return std::nullopt;
+}
+
+bool EventLoop::takeLine(const std::string &word) {
+  for (auto it = lines.begin(); it != lines.end(); it++) {
+    auto first = it->find_first_not_of(" \t\r");
+    auto last = it->find_last_not_of(" \t\r");
+    if (first == std::string::npos || it->compare(first, last - first + 1, word) != 0) continue;
+    lines.erase(it);
+    return true;
+  }
+  return false;
+}
+
+std::optional<std::string> EventLoop::nextLine() {
+  ExclusiveIO::flush();
+  while (lines.empty() && !input_closed) {
+    if (!input_watched || wait() == Event::Error) readInput();
+  }
+  if (lines.empty()) return std::nullopt;
+  auto line = std::move(lines.front());
+  lines.pop_front();
+  return line;
+}
@@ -5,23 +5,249 @@
 #include "bdd_exclusive_io.hpp"
 #include <string>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <execution>
 
 
+namespace {
+    // Bytes of each thread ring: a power of 2, records wrap around
+    constexpr std::size_t ring_capacity = 1 << 16;
+
+    // Larger records take the synchronous path, not to wait for the whole ring to be drained
+    constexpr std::size_t record_max_size = ring_capacity / 4;
+
+    // Written at once by the drain thread, one write() per batch
+    constexpr std::size_t batch_max_size = 1 << 16;
+
+    // Pause of the drain thread after a batch, before going to sleep (a flush() waits for it at worst)
+    constexpr auto drain_linger = std::chrono::microseconds(200);
+
+    struct RecordHeader {
+        std::uint64_t sequence;
+        void (*render)(const char *payload, std::string &out); // nullptr: padding up to the end of the ring
+        std::uint32_t size; // of the whole record, header included, multiple of record_alignment
+        std::int32_t color;
+        bool error;         // written to stderr
+    };
+
+    // Any space left at the end of a ring holds at least a padding header
+    constexpr std::size_t record_alignment = 32;
+    static_assert(sizeof(RecordHeader) <= record_alignment && ring_capacity % record_alignment == 0);
+
+    std::size_t alignRecord(std::size_t size) {
+      return (size + record_alignment - 1) & ~(record_alignment - 1);
+    }
+
+    /**
+     * Written by one thread only, read by the drain thread only: head & tail are the total number of bytes
+     * written & consumed, each on its own cache line
+     */
+    struct Ring {
+        std::unique_ptr<char[]> bytes = std::make_unique<char[]>(ring_capacity);
+        alignas(64) std::atomic<std::size_t> head{0};
+        alignas(64) std::atomic<std::size_t> tail{0};
+        std::size_t reserved = 0;          // producer: record being encoded, padding included
+        RecordHeader *pending = nullptr;   // producer: its header
+        std::atomic<bool> orphaned{false}; // its thread has exited: freed once drained
+    };
+
+    std::mutex rings_mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::atomic<unsigned> rings_generation{0}; // bumped by terminate(): the rings of the threads are gone
+
+    std::atomic<std::uint64_t> next_sequence{0}; // records committed
+    std::atomic<std::uint64_t> written{0};       // records written to their file descriptor
+
+    std::atomic<std::uint32_t> wake{0};
+    std::atomic<bool> sleeping{false};
+    std::atomic<bool> stopping{false};
+    std::thread *drain_thread = nullptr; // never destroyed joinable, even at exit
+
+    struct LocalRing {
+        Ring *ring = nullptr;
+        unsigned generation = 0;
+
+        ~LocalRing() {
+          if (ring != nullptr && generation == rings_generation.load()) ring->orphaned.store(true);
+        }
+    };
+
+    thread_local LocalRing local_ring;
+
+    Ring *getLocalRing() {
+      auto generation = rings_generation.load(std::memory_order_relaxed);
+      if (local_ring.ring != nullptr && local_ring.generation == generation) return local_ring.ring;
+      std::lock_guard lock(rings_mutex);
+      local_ring.ring = rings.emplace_back(std::make_unique<Ring>()).get();
+      local_ring.generation = generation;
+      return local_ring.ring;
+    }
+
+    void wakeDrain() {
+      if (!sleeping.load(std::memory_order_relaxed) || !sleeping.exchange(false)) return;
+      wake.fetch_add(1);
+      wake.notify_one();
+    }
+
+    /**
+     * @return the oldest record of the ring (padding skipped), nullptr if empty
+     */
+    const RecordHeader *peek(Ring &ring) {
+      while (true) {
+        auto tail = ring.tail.load(std::memory_order_relaxed);
+        if (tail == ring.head.load(std::memory_order_acquire)) return nullptr;
+        auto record = (const RecordHeader *) (ring.bytes.get() + (tail & (ring_capacity - 1)));
+        if (record->render != nullptr) return record;
+        ring.tail.store(tail + record->size, std::memory_order_release);
+      }
+    }
+
+    void writeAll(int fd, std::string &batch) {
+      std::string_view rest(batch);
+      while (!rest.empty()) {
+        auto size = write(fd, rest.data(), rest.size());
+        if (size < 0 && errno == EINTR) continue;
+        if (size <= 0) break;
+        rest.remove_prefix(size);
+      }
+      batch.clear();
+    }
+}
+
+
 #pragma region Private API
 
 void ExclusiveIO::mmapExclusionStructure() {
-  unlink(EXCLUSIVE_IO_MMAP_NAME);
-  auto fd = open(EXCLUSIVE_IO_MMAP_NAME, O_CREAT | O_RDWR, 00600);
-  ftruncate(fd, sizeof(synchronisation_mutex_t));
-  synchronisation_map = (synchronisation_mutex_t *) mmap(nullptr,
-                                                         sizeof(synchronisation_mutex_t),
-                                                         PROT_READ | PROT_WRITE,
-                                                         MAP_SHARED,
-                                                         fd,
-                                                         0);
+  // No file: inherited by the forked children only, another debugger on the host has its own
+  auto mapping = mmap(nullptr, sizeof(synchronisation_mutex_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                      -1, 0);
+  if (mapping == MAP_FAILED) throw std::invalid_argument("mmap for print_mutex");
+  synchronisation_map = (synchronisation_mutex_t *) mapping;
+}
+
+void ExclusiveIO::writeRedirected(color_t color, std::string_view text) {
+  thread_local std::string line;
+  line.clear();
+  fmt::format_to(std::back_inserter(line), FMT_COMPILE("\033[{}m[Child]: {}\033[0m"), (int) color, text);
+  writeAll(redirect_fd, line);
+}
+
+char *ExclusiveIO::reserveRecord(std::size_t payload_size) {
+  auto size = alignRecord(sizeof(RecordHeader) + payload_size);
+  if (size > record_max_size) {
+    // Synchronous, but still after everything logged before
+    flush();
+    return nullptr;
+  }
+  auto &ring = *getLocalRing();
+  auto head = ring.head.load(std::memory_order_relaxed);
+  auto offset = head & (ring_capacity - 1);
+  // A record is never split: the end of the ring is skipped when it doesn't fit
+  auto padding = offset + size > ring_capacity ? ring_capacity - offset : 0;
+  while (ring_capacity - (head - ring.tail.load(std::memory_order_acquire)) < padding + size) {
+    wakeDrain();
+    std::this_thread::yield();
+  }
+  if (padding > 0) {
+    auto record = (RecordHeader *) (ring.bytes.get() + offset);
+    record->render = nullptr;
+    record->size = padding;
+    offset = 0;
+  }
+  auto record = (RecordHeader *) (ring.bytes.get() + offset);
+  record->size = size;
+  ring.reserved = padding + size;
+  ring.pending = record;
+  return (char *) (record + 1);
+}
+
+void ExclusiveIO::commitRecord(RenderFunction render, color_t color, bool error) {
+  auto &ring = *local_ring.ring;
+  auto record = ring.pending;
+  record->render = render;
+  record->color = color;
+  record->error = error;
+  record->sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+  ring.head.store(ring.head.load(std::memory_order_relaxed) + ring.reserved, std::memory_order_release);
+  // Pairs with the drain thread going to sleep: either it sees the record, or the record sees it asleep
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  wakeDrain();
+}
+
+void ExclusiveIO::drain() {
+  std::string batch;
+  int batch_fd = STDOUT_FILENO;
+  std::uint64_t batched = 0;
+  auto writeBatch = [&batch, &batch_fd, &batched] {
+      if (batch.empty()) return;
+      lockPrint();
+      writeAll(batch_fd, batch);
+      unlockPrint();
+      written.fetch_add(batched);
+      written.notify_all();
+      batched = 0;
+  };
+  // Every record at hand, oldest first across the rings
+  auto drainOnce = [&] {
+      std::vector<Ring *> current;
+      {
+        std::lock_guard lock(rings_mutex);
+        std::erase_if(rings, [](const std::unique_ptr<Ring> &ring) {
+            return ring->orphaned.load() && ring->tail.load() == ring->head.load();
+        });
+        for (auto &ring: rings) current.push_back(ring.get());
+      }
+      std::uint64_t drained = 0;
+      while (true) {
+        Ring *oldest = nullptr;
+        const RecordHeader *record = nullptr;
+        for (auto ring: current) {
+          auto candidate = peek(*ring);
+          if (candidate != nullptr && (record == nullptr || candidate->sequence < record->sequence))
+            oldest = ring, record = candidate;
+        }
+        if (record == nullptr) break;
+
+        int fd = record->error ? STDERR_FILENO : STDOUT_FILENO;
+        if (fd != batch_fd || batch.size() >= batch_max_size) writeBatch();
+        batch_fd = fd;
+        if (record->color == color_t::FG_NONE) {
+          record->render((const char *) (record + 1), batch);
+        } else {
+          fmt::format_to(std::back_inserter(batch), FMT_COMPILE("\033[{}m[BDD]: "), record->color);
+          record->render((const char *) (record + 1), batch);
+          batch.append("\033[0m");
+        }
+        oldest->tail.store(oldest->tail.load(std::memory_order_relaxed) + record->size, std::memory_order_release);
+        batched++;
+        drained++;
+      }
+      writeBatch();
+      return drained;
+  };
+
+  while (true) {
+    if (drainOnce() > 0) {
+      // Bursts: the next records are batched without waking this thread up for each of them
+      std::this_thread::sleep_for(drain_linger);
+      continue;
+    }
+    if (stopping.load()) return;
+    auto ticket = wake.load();
+    sleeping.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (drainOnce() > 0 || stopping.load()) {
+      sleeping.store(false);
+      continue;
+    }
+    wake.wait(ticket);
+    sleeping.store(false);
+  }
 }
 
 #pragma endregion
@@ -31,6 +257,7 @@ void ExclusiveIO::mmapExclusionStructure() {
 
 void ExclusiveIO::initialize(pid_t parentPid) {
   parent_pid = parentPid;
+  is_parent = getpid() == parent_pid;
 
   mmapExclusionStructure();
 
@@ -39,18 +266,60 @@ void ExclusiveIO::initialize(pid_t parentPid) {
     throw std::invalid_argument("pthread_mutexattr_init");
   if (pthread_mutexattr_setpshared(&mutexattr, PTHREAD_PROCESS_SHARED))
     throw std::invalid_argument("pthread_mutexattr_setpshared");
+  if (pthread_mutexattr_setrobust(&mutexattr, PTHREAD_MUTEX_ROBUST))
+    throw std::invalid_argument("pthread_mutexattr_setrobust");
 
   if (pthread_mutex_init(&synchronisation_map->print_mutex, &mutexattr))
     throw std::invalid_argument("pthread_mutex_init for print_mutex");
+
+  if (drain_thread != nullptr) return;
+  static std::once_flag hooked;
+  std::call_once(hooked, [] {
+      // The child of a fork has no drain thread: back to the synchronous path
+      pthread_atfork(nullptr, nullptr, [] {
+          is_parent = getpid() == parent_pid;
+          asynchronous.store(false);
+      });
+      // Whatever is still queued when the debugger exits without terminate()
+      std::atexit([] { flush(); });
+  });
+  std::cout << std::flush;
+  stopping.store(false);
+  drain_thread = new std::thread(&ExclusiveIO::drain);
+  asynchronous.store(true);
 }
 
 void ExclusiveIO::terminate() {
+  if (drain_thread != nullptr && asynchronous.load()) {
+    flush();
+    // The drain thread writes whatever comes meanwhile before leaving
+    asynchronous.store(false);
+    stopping.store(true);
+    wake.fetch_add(1);
+    wake.notify_one();
+    drain_thread->join();
+    delete drain_thread;
+    drain_thread = nullptr;
+    rings_generation.fetch_add(1);
+    std::lock_guard lock(rings_mutex);
+    rings.clear();
+  }
   std::cout << std::flush;
   munmap(synchronisation_map, sizeof(synchronisation_mutex_t));
+  synchronisation_map = nullptr;
 }
 
-
-#pragma endregion
-
+void ExclusiveIO::flush() {
+  if (drain_thread == nullptr || !asynchronous.load(std::memory_order_relaxed)) {
+    std::cout << std::flush;
+    return;
+  }
+  auto target = next_sequence.load();
+  auto done = written.load();
+  if (done >= target) return;
+  wakeDrain();
+  for (; done < target; done = written.load()) written.wait(done);
+}
 
 
+#pragma endregion
@@ -0,0 +1,109 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <array>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bdd_exclusive_io.hpp"
+#include "bdd_index_cache.hpp"
+
+namespace {
+    constexpr char magic[8] = {'C', '_', 'B', 'D', 'D', 'I', 'D', 'X'};
+
+    // To bump whenever the layout of any index changes: the files of the former layout are then rebuilt
+    constexpr std::uint32_t format_version = 1;
+
+    std::string getPath(const std::string &directory, const std::string &key, std::string_view kind) {
+      return directory + "/" + key + "." + std::string(kind);
+    }
+}
+
+cache::MappedFile::MappedFile(const std::string &path) {
+  auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw std::invalid_argument("cache::MappedFile: cannot open " + path);
+  struct stat st{};
+  if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+    close(fd);
+    throw std::invalid_argument("cache::MappedFile: empty or unreadable " + path);
+  }
+  length = (std::size_t) st.st_size;
+  auto mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) throw std::invalid_argument("cache::MappedFile: mmap() failed on " + path);
+  bytes = (const char *) mapping;
+}
+
+cache::MappedFile::~MappedFile() {
+  if (bytes != nullptr) munmap((void *) bytes, length);
+}
+
+std::string cache::getDirectory() {
+  if (std::getenv("C_BDD_NO_INDEX_CACHE") != nullptr) return "";
+  auto xdg = std::getenv("XDG_CACHE_HOME");
+  if (xdg != nullptr && xdg[0] == '/') return std::string(xdg) + "/c_bdd";
+  auto home = std::getenv("HOME");
+  if (home != nullptr && home[0] == '/') return std::string(home) + "/.cache/c_bdd";
+  return "";
+}
+
+std::shared_ptr<const cache::MappedFile>
+cache::load(const std::string &key, std::string_view kind, std::span<const char> &payload) {
+  auto directory = getDirectory();
+  if (directory.empty() || key.empty()) return nullptr;
+  auto path = getPath(directory, key, kind);
+  if (access(path.c_str(), R_OK) != 0) return nullptr;
+
+  std::shared_ptr<const MappedFile> file;
+  try {
+    file = std::make_shared<const MappedFile>(path);
+  } catch (const std::invalid_argument &e) {
+    ExclusiveIO::debugError_f("cache::load(): %s\n", e.what());
+    return nullptr;
+  }
+  Reader reader(file->data());
+  auto fileMagic = reader.get<std::array<char, sizeof(magic)>>();
+  auto version = reader.get<std::uint32_t>();
+  if (!fileMagic || std::memcmp(fileMagic->data(), magic, sizeof(magic)) != 0 || version != format_version) {
+    ExclusiveIO::debug_f("cache::load(): %s is of another format, ignored\n", path.c_str());
+    return nullptr;
+  }
+  payload = file->data().subspan(sizeof(magic) + sizeof(std::uint32_t));
+  ExclusiveIO::debug_f("cache::load(): %s (%zu bytes)\n", path.c_str(), payload.size());
+  return file;
+}
+
+bool cache::store(const std::string &key, std::string_view kind, const Writer &index) {
+  auto directory = getDirectory();
+  if (directory.empty() || key.empty()) return false;
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (error) return false;
+
+  auto path = getPath(directory, key, kind);
+  auto temporary = path + ".tmp." + std::to_string(getpid());
+  auto fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return false;
+  bool written = true;
+  for (auto part: {std::span<const char>(magic, sizeof(magic)),
+                   std::span<const char>((const char *) &format_version, sizeof(format_version)), index.data()}) {
+    while (written && !part.empty()) {
+      auto size = write(fd, part.data(), part.size());
+      if (size < 0 && errno == EINTR) continue;
+      written = size > 0;
+      if (written) part = part.subspan(size);
+    }
+  }
+  written = close(fd) == 0 && written;
+  if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+    unlink(temporary.c_str());
+    return false;
+  }
+  ExclusiveIO::debug_f("cache::store(): %s (%zu bytes)\n", path.c_str(), index.data().size());
+  return true;
+}
@@ -0,0 +1,136 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <sys/uio.h>
+#include <climits>
+#include <cstring>
+#include "bdd_ptrace.hpp"
+
+namespace {
+    const std::size_t page_size = sysconf(_SC_PAGESIZE);
+
+    /**
+     * Splits a remote range on page boundaries, so a failing page stops the transfer exactly at its start
+     * @return at most IOV_MAX iovecs, covering the beginning of the range
+     */
+    std::vector<iovec> splitByPage(addr_t address, std::size_t size) {
+      std::vector<iovec> remote;
+      while (size > 0 && remote.size() < IOV_MAX) {
+        auto length = std::min(size, page_size - (address % page_size));
+        remote.push_back({reinterpret_cast<void *>(address), length});
+        address += length;
+        size -= length;
+      }
+      return remote;
+    }
+
+    /**
+     * Transfer loop shared by reads & writes
+     * @param direct process_vm_readv/writev(local, remote), returns the bytes transferred or -1
+     * @param fallback pread/pwrite on /proc/<pid>/mem(local, address), returns the bytes transferred or -1
+     */
+    template<typename Direct, typename Fallback>
+    MemoryAccess transfer(addr_t address, std::uint8_t *local, std::size_t size, Direct direct, Fallback fallback) {
+      MemoryAccess access;
+      bool directAvailable = true;
+      while (access.transferred < size) {
+        auto current = address + access.transferred;
+        auto remote = splitByPage(current, size - access.transferred);
+        std::size_t requested = 0;
+        for (const auto &iov: remote) requested += iov.iov_len;
+
+        if (directAvailable) {
+          iovec localIov{local + access.transferred, requested};
+          auto count = direct(localIov, remote);
+          if (count > 0) {
+            access.transferred += count;
+            continue;
+          }
+          // Anything but a bad page means the syscall itself is unusable here (kernel, seccomp, ...)
+          directAvailable = errno == EFAULT;
+        }
+
+        // Page by page through /proc/<pid>/mem, back to direct accesses after a page
+        auto length = directAvailable ? remote.front().iov_len : requested;
+        auto done = std::size_t(0);
+        while (done < length) {
+          auto count = fallback(local + access.transferred + done, length - done, current + done);
+          if (count <= 0) break;
+          done += count;
+        }
+        access.transferred += done;
+        if (done < length) {
+          access.failedAt = current + done;
+          access.error = errno;
+          break;
+        }
+      }
+      return access;
+    }
+}
+
+int TracedProgram::getMemoryFile() const {
+  if (memory_fd >= 0) return memory_fd;
+  std::string path = "/proc/" + std::to_string(traced_pid) + "/mem";
+  memory_fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (memory_fd < 0)
+    ExclusiveIO::debugError_f("TracedProgram::getMemoryFile(): cannot open %s\n", path.c_str());
+  return memory_fd;
+}
+
+void TracedProgram::closeMemoryFile() const {
+  if (memory_fd >= 0) close(memory_fd);
+  memory_fd = -1;
+}
+
+MemoryAccess TracedProgram::readMemory(addr_t address, std::span<std::uint8_t> buffer) const {
+  ExclusiveIO::debug_f("TracedProgram::readMemory(0x%016lX, %zu)\n", address, buffer.size());
+  auto access = transfer(
+      address, buffer.data(), buffer.size(),
+      [this](const iovec &local, const std::vector<iovec> &remote) {
+          return process_vm_readv(traced_pid, &local, 1, remote.data(), remote.size(), 0);
+      },
+      [this](std::uint8_t *local, std::size_t size, addr_t remote) -> ssize_t {
+          auto fd = getMemoryFile();
+          return fd < 0 ? -1 : pread(fd, local, size, static_cast<off_t>(remote));
+      });
+  if (!access.complete())
+    ExclusiveIO::debugError_f("TracedProgram::readMemory(): stopped at 0x%016lX (%s)\n", *access.failedAt,
+                              strerror(access.error));
+  return access;
+}
+
+MemoryAccess TracedProgram::writeMemory(addr_t address, std::span<const std::uint8_t> data) {
+  ExclusiveIO::debug_f("TracedProgram::writeMemory(0x%016lX, %zu)\n", address, data.size());
+  // Only read from: the transfer loop takes a single buffer type for both directions
+  auto local = const_cast<std::uint8_t *>(data.data());
+  auto access = transfer(
+      address, local, data.size(),
+      [this](const iovec &localIov, const std::vector<iovec> &remote) {
+          return process_vm_writev(traced_pid, &localIov, 1, remote.data(), remote.size(), 0);
+      },
+      [this](std::uint8_t *bytes, std::size_t size, addr_t remote) -> ssize_t {
+          auto fd = getMemoryFile();
+          return fd < 0 ? -1 : pwrite(fd, bytes, size, static_cast<off_t>(remote));
+      });
+  if (access.transferred > 0) stop_generation++;
+  if (access.transferred > 0 && address >= ram_start_address)
+    invalidateDisassembly(address - ram_start_address, access.transferred);
+  if (!access.complete())
+    ExclusiveIO::debugError_f("TracedProgram::writeMemory(): stopped at 0x%016lX (%s)\n", *access.failedAt,
+                              strerror(access.error));
+  return access;
+}
+
+bool TracedProgram::writeByte(addr_t address, std::uint8_t value) {
+  auto fd = getMemoryFile();
+  if (fd >= 0 && pwrite(fd, &value, 1, static_cast<off_t>(address)) == 1) return true;
+  errno = 0;
+  instr_t word = ptrace(PTRACE_PEEKTEXT, current_tid, address);
+  if (errno != 0 || ptrace(PTRACE_POKETEXT, current_tid, address, (word & TRAP_MASK) | value) == -1) {
+    ExclusiveIO::debugError_f("TracedProgram::writeByte(0x%016lX): %s\n", address, strerror(errno));
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,211 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "bdd_exclusive_io.hpp"
+#include "bdd_output.hpp"
+
+namespace {
+    // Asked for the capture pipes (the default is 64 KiB): a chatty program blocks less often on a full pipe.
+    // Above /proc/sys/fs/pipe-max-size, the default stays.
+    constexpr int pipe_capacity = 1 << 20;
+
+    /**
+     * @return false if pipe2() failed (fds untouched)
+     */
+    bool makePipe(int (&fds)[2]) {
+      if (pipe2(fds, O_CLOEXEC) < 0) return false;
+      fcntl(fds[1], F_SETPIPE_SZ, pipe_capacity);
+      return true;
+    }
+
+    /**
+     * Drops bytes that can't be written anywhere: the pipe must not jam
+     */
+    void discard(int from, std::size_t size) {
+      std::array<char, 4096> buffer{};
+      while (size > 0) {
+        auto dropped = read(from, buffer.data(), std::min(size, buffer.size()));
+        if (dropped < 0 && errno == EINTR) continue;
+        if (dropped <= 0) return;
+        size -= dropped;
+      }
+    }
+}
+
+std::string_view output::getModeName(Mode mode) {
+  switch (mode) {
+    case Mode::Inherit:
+      return "inherit";
+    case Mode::Pipe:
+      return "pipe";
+    case Mode::Pty:
+      return "pty";
+  }
+  return "unknown";
+}
+
+output::Capture::Capture(const Options &options) : pty(options.mode == Mode::Pty), console(options.console) {
+  auto fail = [this](const std::string &what) {
+      closeAll();
+      throw std::invalid_argument("output::Capture: " + what);
+  };
+  if (pty) {
+    source_fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    std::array<char, 128> name{};
+    if (source_fd < 0 || grantpt(source_fd) < 0 || unlockpt(source_fd) < 0 ||
+        ptsname_r(source_fd, name.data(), name.size()) != 0)
+      fail("no pseudo-terminal available");
+    child_fd = open(name.data(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (child_fd < 0) fail(std::string("cannot open ") + name.data());
+    // "\n" stays "\n" in the log, the terminal of the debugger adds its own "\r"
+    termios attributes{};
+    if (tcgetattr(child_fd, &attributes) == 0) {
+      attributes.c_oflag &= ~OPOST;
+      tcsetattr(child_fd, TCSANOW, &attributes);
+    }
+    winsize size{};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0) ioctl(child_fd, TIOCSWINSZ, &size);
+    if (!makePipe(staging)) fail(std::string("pipe2() failed: ") + strerror(errno));
+  } else {
+    int fds[2];
+    if (!makePipe(fds)) fail(std::string("pipe2() failed: ") + strerror(errno));
+    source_fd = fds[0], child_fd = fds[1];
+  }
+  fcntl(source_fd, F_SETFL, fcntl(source_fd, F_GETFL) | O_NONBLOCK);
+
+  if (!options.log_path.empty() || !console) {
+    auto path = options.log_path.empty() ? std::string("/dev/null") : options.log_path;
+    // Not O_APPEND (splice() refuses it): positioned at the end instead, the runs follow each other
+    log_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (log_fd < 0) fail("cannot open " + path + ": " + strerror(errno));
+    lseek(log_fd, 0, SEEK_END);
+  }
+  if (console && log_fd >= 0 && !makePipe(copy)) fail(std::string("pipe2() failed: ") + strerror(errno));
+}
+
+output::Capture::~Capture() {
+  closeAll();
+}
+
+void output::Capture::closeAll() {
+  for (auto &fd: {&source_fd, &child_fd, &staging[0], &staging[1], &copy[0], &copy[1], &log_fd}) {
+    if (*fd >= 0) close(*fd);
+    *fd = -1;
+  }
+}
+
+void output::Capture::attachChild() const {
+  if (pty) {
+    // Its own session, the pty being its controlling terminal: isatty() holds, ^C of the debugger doesn't reach it
+    setsid();
+    ioctl(child_fd, TIOCSCTTY, 0);
+  }
+  dup2(child_fd, STDOUT_FILENO);
+  dup2(child_fd, STDERR_FILENO);
+}
+
+void output::Capture::detachChild() {
+  if (child_fd >= 0) close(child_fd);
+  child_fd = -1;
+}
+
+void output::Capture::moveAll(int from, int to, std::size_t size) {
+  while (size > 0) {
+    ssize_t moved;
+    if (to == STDOUT_FILENO && !console_splice) {
+      std::array<char, 4096> buffer{};
+      moved = read(from, buffer.data(), std::min(size, buffer.size()));
+      std::string_view rest(buffer.data(), std::max<ssize_t>(moved, 0));
+      while (!rest.empty()) {
+        auto written = write(to, rest.data(), rest.size());
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) break;
+        rest.remove_prefix(written);
+      }
+    } else {
+      moved = splice(from, nullptr, to, nullptr, size, SPLICE_F_MOVE);
+      // A terminal without splice_write (or stdout opened in append mode)
+      if (moved < 0 && errno == EINVAL && to == STDOUT_FILENO) {
+        console_splice = false;
+        continue;
+      }
+    }
+    if (moved < 0 && errno == EINTR) continue;
+    if (moved <= 0) return discard(from, size);
+    size -= moved;
+  }
+}
+
+long output::Capture::pumpOnce() {
+  int available = 0;
+  if (ioctl(source_fd, FIONREAD, &available) < 0 || available <= 0) {
+    // Empty: over once every writer has closed its end
+    pollfd poll_fd{source_fd, POLLIN, 0};
+    if (poll(&poll_fd, 1, 0) < 0) return -1;
+    return poll_fd.revents & (POLLHUP | POLLERR) ? 0 : -1;
+  }
+  auto size = (std::size_t) std::min(available, pipe_capacity);
+  int pipe_fd = source_fd;
+  if (pty) {
+    auto moved = splice(source_fd, nullptr, staging[1], nullptr, size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    // EIO: the last writer of the slave has gone
+    if (moved == 0 || (moved < 0 && errno == EIO)) return 0;
+    if (moved < 0) return -1;
+    size = moved;
+    pipe_fd = staging[0];
+  }
+
+  for (auto left = size; left > 0;) {
+    auto chunk = left;
+    if (console && log_fd >= 0) {
+      // Duplicated, not consumed: the same pages go to both
+      auto teed = tee(pipe_fd, copy[1], left, 0);
+      if (teed <= 0) {
+        if (teed < 0 && errno == EINTR) continue;
+        discard(pipe_fd, left);
+        break;
+      }
+      chunk = teed;
+      moveAll(copy[0], log_fd, chunk);
+    }
+    if (console)
+      ExclusiveIO::writeDirect([this, pipe_fd, chunk] { moveAll(pipe_fd, STDOUT_FILENO, chunk); });
+    else
+      moveAll(pipe_fd, log_fd, chunk);
+    left -= chunk;
+  }
+  captured += size;
+  return (long) size;
+}
+
+bool output::Capture::pump() {
+  while (true) {
+    auto moved = pumpOnce();
+    if (moved == 0) return false;
+    if (moved < 0) return true;
+  }
+}
+
+void output::Capture::markStop(std::string_view event) {
+  pump();
+  stops++;
+  if (log_fd < 0) return;
+  auto marker = fmt::format("[c_bdd] ---- stop #{}: {} ({} bytes of output so far) ----\n", stops, event, captured);
+  std::string_view rest(marker);
+  while (!rest.empty()) {
+    auto size = write(log_fd, rest.data(), rest.size());
+    if (size < 0 && errno == EINTR) continue;
+    if (size <= 0) break;
+    rest.remove_prefix(size);
+  }
+}
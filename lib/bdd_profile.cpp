@@ -0,0 +1,172 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <algorithm>
+#include <map>
+#include "bdd_ptrace.hpp"
+
+namespace {
+    // Functions listed by the report, the folded stacks have them all
+    constexpr std::size_t hottest_shown = 15;
+
+    std::uint64_t toNanoseconds(profile::clock::duration duration) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+}
+
+#pragma region Report
+
+void profile::StackTrie::add(std::span<const addr_t> frames) {
+  std::uint32_t node = 0;
+  for (auto it = frames.rbegin(); it != frames.rend(); it++) {
+    auto [child, inserted] = children.try_emplace({node, *it}, (std::uint32_t) nodes.size());
+    if (inserted) nodes.push_back({*it, node, 0});
+    node = child->second;
+  }
+  nodes[node].samples++;
+}
+
+std::vector<addr_t> profile::StackTrie::getAddresses() const {
+  std::vector<addr_t> addresses;
+  addresses.reserve(nodes.size());
+  for (auto it = nodes.cbegin() + 1; it != nodes.cend(); it++) addresses.push_back(it->address);
+  std::sort(addresses.begin(), addresses.end());
+  addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+  return addresses;
+}
+
+std::string profile::StackTrie::fold(const std::unordered_map<addr_t, std::string> &names) const {
+  std::map<std::string, std::uint64_t> stacks;
+  std::vector<std::uint32_t> path;
+  for (std::uint32_t i = 1; i < nodes.size(); i++) {
+    if (nodes[i].samples == 0) continue;
+    path.clear();
+    for (auto node = i; node != 0; node = nodes[node].parent) path.push_back(node);
+    std::string line;
+    for (auto it = path.rbegin(); it != path.rend(); it++) {
+      if (!line.empty()) line.push_back(';');
+      line.append(names.at(nodes[*it].address));
+    }
+    stacks[line] += nodes[i].samples;
+  }
+
+  std::string folded;
+  for (const auto &[line, samples]: stacks) fmt::format_to(std::back_inserter(folded), "{} {}\n", line, samples);
+  return folded;
+}
+
+std::vector<std::pair<std::string, std::uint64_t>>
+profile::StackTrie::getSelfSamples(const std::unordered_map<addr_t, std::string> &names) const {
+  std::unordered_map<std::string, std::uint64_t> functions;
+  for (auto it = nodes.cbegin() + 1; it != nodes.cend(); it++)
+    if (it->samples > 0) functions[names.at(it->address)] += it->samples;
+  std::vector<std::pair<std::string, std::uint64_t>> sorted(functions.begin(), functions.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+      return a.second != b.second ? a.second > b.second : a.first < b.first;
+  });
+  return sorted;
+}
+
+std::string profile::Report::toString() const {
+  std::string result;
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  fmt::format_to(std::back_inserter(result),
+                 "{} samples ({} distinct frames) in {:.3f}s: {} ticks at {} Hz ({:.0f} Hz achieved, {} missed)\n",
+                 samples, stacks.size(), seconds, ticks, frequency, seconds > 0 ? ticks / seconds : 0.0, missed);
+  if (failed > 0) fmt::format_to(std::back_inserter(result), "{} stacks couldn't be walked (IP only)\n", failed);
+
+  auto stoppedSeconds = std::chrono::duration<double>(stopped).count();
+  fmt::format_to(std::back_inserter(result), "Program stopped {:.1f}% of the time",
+                 seconds > 0 ? 100 * stoppedSeconds / seconds : 0.0);
+  if (overhead.getCount() > 0)
+    fmt::format_to(std::back_inserter(result), " (at most {:.0f} Hz at this cost)",
+                   overhead.getCount() / std::max(stoppedSeconds, 1e-9));
+  fmt::format_to(std::back_inserter(result), ", names resolved in {:.1f}ms\n",
+                 std::chrono::duration<double, std::milli>(symbolization).count());
+
+  result.append("Stopped per tick:\n").append(overhead.toString());
+  result.append("Most sampled functions (self):\n");
+  for (std::size_t i = 0; i < hottest.size() && i < hottest_shown; i++)
+    fmt::format_to(std::back_inserter(result), "{:10} {:5.1f}%  {}\n", hottest[i].second,
+                   100.0 * hottest[i].second / std::max<std::uint64_t>(samples, 1), hottest[i].first);
+  return result;
+}
+
+#pragma endregion Report
+
+
+profile::Report TracedProgram::profile(unsigned frequency, std::optional<profile::clock::duration> duration) {
+  ExclusiveIO::debug_f("TracedProgram::profile(%u)\n", frequency);
+  profile::Report report;
+  report.frequency = frequency;
+  if (frequency == 0 || !hasStarted() || !isAlive() || isExiting()) return report;
+
+  // Read once here, not by the first tick
+  loadUnwindModules();
+  auto period = std::chrono::duration_cast<profile::clock::duration>(std::chrono::seconds(1)) / frequency;
+  auto start = profile::clock::now();
+  auto end = duration ? start + *duration : profile::clock::time_point::max();
+  resume();
+  // Only the threads stopped by a tick are resumed by it, the others keep running
+  auto mode = stop_mode;
+  stop_mode = StopMode::NonStop;
+  // Nothing would resume the forked processes meanwhile
+  follow_forks = false;
+
+  std::vector<addr_t> stack;
+  auto tick = start + period;
+  auto now = start;
+  while (isAlive()) {
+    // Anything else than the timer (breakpoint, signal, exit, "interrupt" typed) ends the profile
+    if (waitForEvent(-1, std::min(tick, end))) break;
+    now = profile::clock::now();
+    if (now >= end) break;
+
+    report.ticks++;
+    auto current = current_tid;
+    auto stopped = stopThreads(0);
+    for (auto tid: stopped) {
+      current_tid = tid;
+      walkStack(unwound_frames);
+      stack.clear();
+      for (const auto &frame: unwound_frames) stack.push_back(frame.lookup);
+      if (stack.empty()) {
+        report.failed++;
+        if (auto ip = getThreadIP(tid)) stack.push_back(*ip);
+      }
+      report.stacks.add(stack);
+      report.samples++;
+    }
+    current_tid = current;
+    for (auto tid: stopped) resumeThread(tid, PTRACE_CONT);
+
+    auto resumed = profile::clock::now();
+    report.overhead.add(toNanoseconds(resumed - now));
+    report.stopped += resumed - now;
+    // Late: the ticks gone meanwhile are skipped, not taken in a burst
+    tick += period;
+    if (tick <= resumed) {
+      auto late = (resumed - tick) / period + 1;
+      report.missed += late;
+      tick += late * period;
+    }
+  }
+  report.elapsed = profile::clock::now() - start;
+  // Over by the time limit: stopped as after an interrupt
+  if (isAlive() && currentThread().running) {
+    interrupt();
+    waitAndUpdateStatus();
+  }
+  setStopMode(mode);
+  follow_forks = true;
+
+  // The addresses are named once, after the run
+  auto naming = profile::clock::now();
+  std::unordered_map<addr_t, std::string> names;
+  for (auto address: report.stacks.getAddresses()) names.emplace(address, getFunctionAt(address));
+  report.folded = report.stacks.fold(names);
+  report.hottest = report.stacks.getSelfSamples(names);
+  report.symbolization = profile::clock::now() - naming;
+  return report;
+}
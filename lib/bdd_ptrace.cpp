@@ -3,13 +3,28 @@
 //
 
 #include <sys/user.h>
+#include <climits>
+#include <cstring>
 #include "bdd_ptrace.hpp"
+#include "bdd_disassembler.hpp"
 
-void TracedProgram::initChild(std::vector<char *> &parameters) {
-  usleep(50000); // 50 ms wait, so the BDD (parent process) can attach.
+namespace {
+    // Read ahead while the user types the first commands: symbols (bp, bt, ...) & source lines (stops)
+    const std::vector<std::string> prefetched_sections = {".symtab", ".strtab", ".dynsym", ".dynstr", ".debug_line",
+                                                          ".debug_line_str", ".debug_str"};
+}
+
+void TracedProgram::initChild(std::vector<char *> &parameters, int go_fd, int output_fd, int error_fd) {
+  // Relayed by the parent, never interleaved with what it prints meanwhile
+  ExclusiveIO::redirect(output_fd);
   ExclusiveIO::debug_f("TracedProgram::initChild()\n");
-  int status;
-  ptrace(PTRACE_TRACEME, &status, 0);
+  if (output_capture) output_capture->attachChild();
+  // Seized by the parent once this returns: nothing of the program runs untraced
+  char go;
+  while (read(go_fd, &go, 1) < 0 && errno == EINTR);
+  close(go_fd);
+  event_loop->restoreSignalMask();
+
   char *args[32];
   args[0] = elf_file_path.data();
   args[parameters.size() + 1] = nullptr;
@@ -18,81 +33,177 @@ void TracedProgram::initChild(std::vector<char *> &parameters) {
     args[i + 1] = parameters.at(i);
     ExclusiveIO::debug_f("%s ", args[i + 1]);
   }
-  std::cerr << std::endl;
-  ExclusiveIO::info_f("ready, pid=%u\n", getpid());
+  ExclusiveIO::debug_f("ready, pid=%u\n", getpid());
   execv(elf_file_path.c_str(), args);
-  ExclusiveIO::info_f("exit.\n");
+  // Only reached on failure, the parent reads why (its end of the output first: the exit stops traced)
+  int error = errno;
+  close(output_fd);
+  write(error_fd, &error, sizeof(error));
+  _exit(127);
 }
 
-void TracedProgram::initBDD() {
+bool TracedProgram::initBDD(int go_fd, int output_fd, int error_fd) {
   ExclusiveIO::debug_f("TracedProgram::initBDD()\n");
-  int status;
-  attachPtrace(status);
+  if (!attachPtrace(go_fd, output_fd, error_fd)) return false;
   ram_start_address = getTracedRAMAddress();
+  invalidateDisassembly();
   placeEveryPendingBreakpoints();
   ExclusiveIO::info_f("ready.\n");
+  return true;
 }
 
 
-void TracedProgram::attachPtrace(int &status) {
+bool TracedProgram::attachPtrace(int go_fd, int output_fd, int error_fd) {
   ExclusiveIO::debug_f("TracedProgram::attachPtrace()\n");
-  ptrace(PTRACE_ATTACH, traced_pid);
-  waitpid(traced_pid, &status, 0);
-  ptrace(PTRACE_SETOPTIONS, traced_pid, 0, PTRACE_O_TRACEEXIT);
-  ptraceContinue(false);
+  // Seized while it waits on the pipe: the options hold from its first instruction, the exec stops it
+  auto options = PTRACE_O_TRACEEXEC | PTRACE_O_TRACEEXIT | PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK |
+                 PTRACE_O_TRACEVFORK | PTRACE_O_EXITKILL;
+  auto seized = ptrace(PTRACE_SEIZE, traced_pid, 0, options) == 0;
+  auto seize_error = errno;
+  if (seized) {
+    threads[traced_pid].running = true;
+    current_tid = traced_pid;
+    write(go_fd, "g", 1);
+  } else
+    kill(traced_pid, SIGKILL);
+  close(go_fd);
+
+  // What the child printed before its exec (or its failure), up to the end of the pipe
+  char output[4096];
+  ssize_t size;
+  while ((size = read(output_fd, output, sizeof(output))) != 0) {
+    if (size < 0 && errno == EINTR) continue;
+    if (size < 0) break;
+    ExclusiveIO::relay(std::string_view(output, size));
+  }
+  close(output_fd);
+
+  // Closed on exec (O_CLOEXEC): nothing to read means the program is there
+  int exec_error = 0;
+  while ((size = read(error_fd, &exec_error, sizeof(exec_error))) < 0 && errno == EINTR);
+  close(error_fd);
+  if (seized && size <= 0) {
+    waitForEvent(traced_pid);
+    if (isStopped()) return true;
+  }
+
+  if (!seized)
+    ExclusiveIO::error_f("Cannot trace %s: %s\n", elf_file_path.c_str(), strerror(seize_error));
+  else if (size > 0)
+    ExclusiveIO::error_f("Cannot execute %s: %s\n", elf_file_path.c_str(), strerror(exec_error));
+  // Reaped (past its PTRACE_EVENT_EXIT stop), the debugger is back to 'not started'
+  kill(traced_pid, SIGKILL);
+  while (true) {
+    int status;
+    auto waited = waitpid(traced_pid, &status, __WALL);
+    if (waited < 0 && errno == EINTR) continue;
+    if (waited < 0 || WIFEXITED(status) || WIFSIGNALED(status)) break;
+  }
+  threads.clear();
+  current_tid = 0;
+  traced_pid = 0;
+  releaseUnwind();
+  return false;
 }
 
-TracedProgram::TracedProgram(const std::string &exec_path) {
+TracedProgram::TracedProgram(const std::string &exec_path, std::shared_ptr<EventLoop> loop,
+                             std::shared_ptr<elf::ElfRegistry> registry) {
+  event_loop = loop != nullptr ? std::move(loop) : std::make_shared<EventLoop>();
+  elf_registry = registry != nullptr ? std::move(registry) : std::make_shared<elf::ElfRegistry>();
   elf_file_path = exec_path;
-  elf_file = elf::ElfFile(elf_file_path);
-  ExclusiveIO::initialize(getpid());
+  elf_file = elf_registry->get(elf_file_path, prefetched_sections);
+  line_table = std::make_shared<const dwarf::LineTable>(elf_file);
+}
+
+TracedProgram::TracedProgram(const TracedProgram &parent, pid_t child) {
+  event_loop = parent.event_loop;
+  elf_registry = parent.elf_registry;
+  elf_file_path = parent.elf_file_path;
+  elf_file = parent.elf_file;
+  line_table = parent.line_table;
+  ram_start_address = parent.ram_start_address;
+  stop_mode = parent.stop_mode;
+  output_options = parent.output_options;
+  output_capture = parent.output_capture;
+  traced_pid = child;
+  current_tid = child;
+
+  breakpointsMap = parent.breakpointsMap;
+  for (auto &[address, bp]: breakpointsMap) bp.setProgram(child);
+  displaced = parent.displaced;
+  displacedBySlot = parent.displacedBySlot;
+  scratch_pages = parent.scratch_pages;
+  scratch_used = parent.scratch_used;
+  scratch_failed = parent.scratch_failed;
+
+  auto &thread = threads[child];
+  thread.running = true;
+  thread.stopRequested = true;
 }
 
 
 void TracedProgram::resumeBreakpoint() {
-  auto bp = getHitBreakpoint();
-  bp.disable();
+  auto &bp = getHitBreakpoint();
+  // Without the INT3, the other threads would run through the breakpoint unnoticed
+  auto stopped = stop_mode == StopMode::NonStop ? stopOthers() : std::vector<pid_t>();
+  // The original byte is only back for the step: the breakpoint stays enabled
+  writeByte(bp.getAddress(), bp.getOriginal());
   ptraceBackwardStep();
   ptraceRawStep();
-  bp.enable();
+  if (isStopped()) writeByte(bp.getAddress(), INT3);
+  for (auto tid: stopped) resumeThread(tid, PTRACE_CONT);
 }
 
-void TracedProgram::ptraceContinue(bool lock) {
-  if (isTrappedAtBreakpoint())
-    resumeBreakpoint();
+void TracedProgram::resumeTraced(int signal) {
+  if (stop_mode == StopMode::NonStop) return resumeThread(current_tid, PTRACE_CONT, signal);
+  for (auto &[tid, thread]: threads)
+    if (!thread.running && !thread.pending) resumeThread(tid, PTRACE_CONT, tid == current_tid ? signal : 0);
+}
 
-  ExclusiveIO::debug_f("TracedProgram::ptraceContinue(): locking.\n");
-  if (lock)
-    ExclusiveIO::lockPrint();
-  ptrace(PTRACE_CONT, traced_pid, 0, 0);
+void TracedProgram::ptraceContinue() {
+  // The user can still type meanwhile: "interrupt" stops the program, anything else waits for the prompt
+  resume();
   waitAndUpdateStatus();
-  if (lock)
-    ExclusiveIO::unlockPrint();
-  ExclusiveIO::debug_f("TracedProgram::ptraceContinue(): unlocking.\n");
+}
+
+void TracedProgram::resume() {
+  if (currentThread().running) return;
+  if (isTrappedAtBreakpoint() && displaceBreakpoint() == Displaced::No)
+    resumeBreakpoint();
+  if (isStopped()) resumeTraced();
+}
+
+bool TracedProgram::pollEvent() {
+  return isRunning() && waitForEvent(-1, EventLoop::clock::now());
 }
 
 
-void TracedProgram::ptraceBackwardStep() const {
-  long rc = ptrace(PTRACE_POKEUSER, traced_pid, sizeof(addr_t) * RIP, getIP());
-  ExclusiveIO::debug_f("TracedProgram::ptraceBackwardStep(): %d\n", rc);
+void TracedProgram::ptraceBackwardStep() {
+  auto regs = fetchRegisters();
+  if (regs == nullptr) return;
+  auto rewound = *regs;
+  rewound.REGISTERS_IP = getIP();
+  setRegisters(rewound);
+  ExclusiveIO::debug_f("TracedProgram::ptraceBackwardStep(): 0x%016lX\n", rewound.REGISTERS_IP);
 }
 
 void TracedProgram::ptraceStep() {
   ExclusiveIO::debug_f("TracedProgram::ptraceStep()\n");
-  if (isTrappedAtBreakpoint())
+  auto displacement = isTrappedAtBreakpoint() ? displaceBreakpoint() : Displaced::Copy;
+  if (displacement == Displaced::No)
     resumeBreakpoint();
-  else
+  else if (displacement == Displaced::Copy)
     ptraceRawStep();
+  markStop("step");
   showStatus();
 }
 
 addr_t TracedProgram::ptraceRawStep() {
   ExclusiveIO::debug_f("TracedProgram::ptraceRawStep()\n");
-  ExclusiveIO::lockPrint();
-  addr_t rc = ptrace(PTRACE_SINGLESTEP, traced_pid, 0, 0);
-  waitAndUpdateStatus();
-  ExclusiveIO::unlockPrint();
-  return rc;
+  resumeThread(current_tid, PTRACE_SINGLESTEP);
+  waitForEvent(current_tid);
+  auto regs = fetchRegisters();
+  return regs ? regs->REGISTERS_IP : 0;
 }
 
 void TracedProgram::showStatus() const {
@@ -105,10 +216,6 @@ void TracedProgram::showStatus() const {
   }
 }
 
-void TracedProgram::waitAndUpdateStatus() {
-  waitpid(traced_pid, &cached_status, 0);
-}
-
 void TracedProgram::stopTraced() const {
   if (isDead()) return;
   ExclusiveIO::debug_f("Stopping the program.\n");
@@ -121,11 +228,64 @@ void TracedProgram::killTraced() const {
   kill(traced_pid, SIGKILL);
 }
 
-void TracedProgram::run(std::vector<char *> &parameters) {
+void TracedProgram::interrupt() const {
+  if (isDead()) return;
+  ExclusiveIO::debug_f("Interrupting the program.\n");
+  // No signal involved: the stop (PTRACE_EVENT_STOP) leaves nothing pending in the program
+  auto tid = threads.contains(current_tid) && threads.at(current_tid).running ? current_tid : traced_pid;
+  ptrace(PTRACE_INTERRUPT, tid, 0, 0);
+}
+
+bool TracedProgram::waitForExit(std::chrono::milliseconds timeout) {
+  auto deadline = EventLoop::clock::now() + timeout;
+  while (hasStarted() && isAlive()) {
+    if (currentThread().running) {
+      if (waitForEvent(-1, deadline)) continue;
+      // Still running: stopped again, as the caller found it
+      interrupt();
+      waitAndUpdateStatus();
+      return false;
+    }
+    // Plain signals are delivered, breakpoints & ptrace events only resumed
+    auto status = currentThread().status;
+    auto signal = isStopped() && (status >> 16) == 0 && WSTOPSIG(status) != SIGTRAP &&
+                  WSTOPSIG(status) != SIGSTOP ? WSTOPSIG(status) : 0;
+    if (isTrappedAtBreakpoint() && displaceBreakpoint() == Displaced::No) resumeBreakpoint();
+    if (!isStopped()) continue;
+    resumeTraced(signal);
+  }
+  return true;
+}
+
+bool TracedProgram::run(std::vector<char *> &parameters) {
   if (isAlive()) {
     std::cerr << " isAlive()" << std::endl;
     clearCurrentProcess();
   }
+  releaseUnwind();
+  // go: the child execs once seized, output: what the child prints until then, error: errno of a failed exec
+  int go[2], output[2], error[2];
+  if (pipe2(go, O_CLOEXEC) < 0) return false;
+  if (pipe2(output, O_CLOEXEC) < 0) {
+    close(go[0]), close(go[1]);
+    return false;
+  }
+  if (pipe2(error, O_CLOEXEC) < 0) {
+    close(go[0]), close(go[1]), close(output[0]), close(output[1]);
+    return false;
+  }
+  output_capture.reset();
+  if (output_options.mode != output::Mode::Inherit) {
+    try {
+      output_capture = std::make_shared<output::Capture>(output_options);
+    } catch (const std::invalid_argument &e) {
+      ExclusiveIO::error_f("Cannot capture the output: %s\n", e.what());
+      for (auto fd: {go[0], go[1], output[0], output[1], error[0], error[1]}) close(fd);
+      return false;
+    }
+  }
+  // The child prints synchronously: what the debugger logged before comes first
+  ExclusiveIO::flush();
   do {
     traced_pid = fork();
     switch (traced_pid) {
@@ -133,29 +293,99 @@ void TracedProgram::run(std::vector<char *> &parameters) {
         std::cerr << "fork_error" << std::endl;
         break;
       case 0:
-        initChild(parameters);
+        close(go[1]), close(output[0]), close(error[0]);
+        initChild(parameters, go[0], output[1], error[1]);
         break;
       default:
-        initBDD();
-        break;
+        close(go[0]), close(output[1]), close(error[1]);
+        if (output_capture) watchOutput();
+        return initBDD(go[1], output[0], error[0]);
     }
   } while (traced_pid == -1 && errno == EAGAIN);
+  traced_pid = 0;
+  for (auto fd: {go[0], go[1], output[0], output[1], error[0], error[1]}) close(fd);
+  return false;
+}
+
+void TracedProgram::watchOutput() {
+  output_capture->detachChild();
+  // Until the end of the output, past this run if the program outlives it (the loop keeps the capture)
+  event_loop->watch(output_capture->getFd(), [capture = output_capture, loop = event_loop.get()] {
+      if (!capture->pump()) loop->unwatch(capture->getFd());
+  });
+}
+
+std::string TracedProgram::describeStop() const {
+  if (isExiting() || isDead()) return "exit";
+  if (isTrappedAtBreakpoint()) return "breakpoint";
+  if (isInterrupted()) return "interrupt";
+  if (hasExeced()) return "exec of " + elf_file_path;
+  if (isSegfault()) return "segfault";
+  return fmt::format("signal {}", strsignal(WSTOPSIG(currentThread().status)));
+}
+
+void TracedProgram::markStop(std::string_view reason) const {
+  if (!output_capture) return;
+  auto event = reason.empty() ? describeStop() : std::string(reason);
+  if (!isDead() && fetchRegisters() != nullptr) {
+    auto ip = getIP();
+    event += fmt::format(" at 0x{:016X}", ip);
+    if (auto symbol = symbolize(getElfIP()); !symbol.empty()) event += " " + symbol;
+  }
+  output_capture->markStop(fmt::format("{}, pid {} tid {}", event, traced_pid, current_tid));
 }
 
-void TracedProgram::run() {
+bool TracedProgram::run() {
   std::vector<char *> args_empty;
-  run(args_empty);
+  return run(args_empty);
 }
 
 void TracedProgram::clearCurrentProcess() {
-  stopTraced();
-  usleep(200000); // 200 ms
-  if (isAlive())
-    killTraced();
+  // Reaped before going on, no zombie left behind
+  killTraced();
+  if (!waitForExit(std::chrono::milliseconds(200)))
+    ExclusiveIO::debugError_f("TracedProgram::clearCurrentProcess(): the program is still there.\n");
   breakpointsMap.clear();
+  invalidateDisassembly();
+  closeMemoryFile();
+  clearDisplaced();
   ram_start_address = 0;
   traced_pid = 0;
-  cached_status = 0;
+  threads.clear();
+  current_tid = 0;
+  releaseUnwind();
+}
+
+void TracedProgram::reloadAfterExec() {
+  char path[PATH_MAX];
+  auto link = "/proc/" + std::to_string(traced_pid) + "/exe";
+  auto length = readlink(link.c_str(), path, sizeof(path) - 1);
+  if (length > 0) elf_file_path.assign(path, length);
+  try {
+    elf_file = elf_registry->get(elf_file_path, prefetched_sections);
+  } catch (const std::invalid_argument &e) {
+    ExclusiveIO::debugError_f("TracedProgram::reloadAfterExec(%s): %s\n", elf_file_path.c_str(), e.what());
+    elf_file = std::make_shared<const elf::ElfFile>();
+  }
+  line_table = std::make_shared<const dwarf::LineTable>(elf_file);
+  // Another address space: the unwind info found so far is about the former executable
+  releaseUnwind();
+
+  for (const auto &[address, bp]: breakpointsMap) {
+    auto function = elf_file->findFunctionByName(bp.getName());
+    if (function != nullptr) pendingBreakpointsMap.emplace_back(traced_pid, function->address, bp.getName());
+  }
+  breakpointsMap.clear();
+  invalidateDisassembly();
+  closeMemoryFile();
+  clearDisplaced();
+  // The other threads are killed by the exec, their exits follow
+  for (auto &[tid, thread]: threads)
+    if (tid != traced_pid) thread.running = true;
+  current_tid = traced_pid;
+  ram_start_address = 0;
+  ram_start_address = getTracedRAMAddress();
+  placeEveryPendingBreakpoints();
 }
 
 addr_t TracedProgram::getTracedRAMAddress() const {
@@ -175,42 +405,129 @@ addr_t TracedProgram::getTracedRAMAddress() const {
   return strtoul(buffer.c_str(), (char **) nullptr, 0);
 }
 
-std::string getOutputFromExec(const char *cmd) {
-  ExclusiveIO::debug_nf("::getOutputFromExec: ", cmd, "\n");
-  std::string result;
-  char buffer[256];
-  char *read_data;
-  std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd, "r"), pclose);
-  if (!pipe)
-    throw std::runtime_error("popen() failed!");
-  do {
-    read_data = fgets(buffer, 256, pipe.get());
-    if (read_data != nullptr)
-      result.append(std::string(read_data));
-  } while (read_data != nullptr);
-  return result;
+std::vector<std::uint8_t> TracedProgram::readCode(addr_t address, std::size_t size) const {
+  auto code = elf_file->getCodeAt(address);
+  std::vector<std::uint8_t> bytes(code.begin(), code.begin() + std::min(size, code.size()));
+  if (!hasStarted() || bytes.empty()) return bytes;
+
+  // Live text, in case it differs from the file
+  auto physical = ram_start_address + address;
+  std::vector<std::uint8_t> live(bytes.size());
+  if (!readMemory(physical, live).complete()) {
+    ExclusiveIO::debugError_f("TracedProgram::readCode(0x%016lX): cannot read the memory, using the file.\n", address);
+    return bytes;
+  }
+
+  // Hide our own breakpoints
+  for (auto it = breakpointsMap.lower_bound(physical); it != breakpointsMap.end(); it++) {
+    if (it->first >= physical + live.size()) break;
+    if (it->second.isEnabled())
+      live[it->first - physical] = it->second.getOriginal();
+  }
+  return live;
 }
 
+std::string TracedProgram::symbolize(addr_t address) const {
+  auto function = elf_file->findFunctionByAddress(address);
+  if (function == nullptr) return "";
+  std::string symbol = "<" + std::string(function->name);
+  if (address != function->address) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "+0x%lx", address - function->address);
+    symbol += buffer;
+  }
+  return symbol + ">";
+}
 
-std::string TracedProgram::dumpAt(addr_t address, addr_t offset) const {
-  std::string cmd;
-  cmd.resize(256);
-  auto size = sprintf(cmd.data(), objdump_cmd_format, address - 2, address + offset,
-                      elf_file_path.c_str());
-  cmd.resize(size);
-  return getOutputFromExec(cmd.c_str());
+const std::vector<disasm::Instruction> &TracedProgram::disassemble(addr_t start, addr_t end) const {
+  auto cached = disassemblyCache.find(start);
+  if (cached != disassemblyCache.end() && cached->second.end >= end) return cached->second.instructions;
+
+  // Decode the whole function at once, so the next dumps inside it are served from the cache
+  auto function = elf_file->findFunctionByAddress(start);
+  if (function != nullptr && function->address == start) end = std::max(end, start + function->size);
+  auto code = readCode(start, end - start + disasm::max_instruction_length);
+  static const std::vector<disasm::Instruction> empty;
+  if (code.empty()) return empty;
+
+  DisassembledRange range;
+  range.end = std::min(end, start + code.size());
+  for (auto &ins: disasm::decodeAll(code.data(), code.size(), start)) {
+    if (ins.address >= range.end) break;
+    range.instructions.push_back(std::move(ins));
+  }
+  ExclusiveIO::debug_f("TracedProgram::disassemble(0x%016lX): %zu instructions cached\n", start,
+                       range.instructions.size());
+  return disassemblyCache.insert_or_assign(start, std::move(range)).first->second.instructions;
 }
 
-std::string TracedProgram::dumpAtCurrent(addr_t offset) const {
-  return dumpAt(getElfIP(), offset);
+void TracedProgram::invalidateDisassembly(addr_t address, std::size_t size) {
+  // Ranges don't overlap much (one per function), a linear scan of the preceding ones is enough
+  for (auto it = disassemblyCache.begin(); it != disassemblyCache.end() && it->first < address + size;) {
+    if (address < it->second.end) it = disassemblyCache.erase(it);
+    else it++;
+  }
 }
 
+void TracedProgram::invalidateDisassembly() {
+  disassemblyCache.clear();
+}
+
+std::string TracedProgram::dumpAt(addr_t address, addr_t offset) const {
+  ExclusiveIO::debug_f("TracedProgram::dumpAt(0x%016lX)\n", address);
+  // Decode from the function start, so the instruction boundaries are the right ones
+  auto function = elf_file->findFunctionByAddress(address);
+  auto start = function != nullptr ? function->address : address;
+  const auto *instructions = &disassemble(start, address + offset);
+  if (instructions->empty() || instructions->back().address + instructions->back().length <= address) {
+    // The symbol doesn't belong to the same section (ex: _init has no size)
+    start = address;
+    instructions = &disassemble(start, address + offset);
+  }
+  // Padding between sections: start at the next code byte
+  while (instructions->empty() && ++start < address + offset)
+    instructions = &disassemble(start, address + offset);
+  if (instructions->empty()) return "No code at this address.\n";
+
+  std::string result;
+  bool first = true;
+  const dwarf::LineEntry *source = nullptr;
+  for (const auto &ins: *instructions) {
+    if (ins.address + ins.length <= address) continue;
+    if (ins.address >= address + offset) break;
 
-std::optional<user_regs_struct> TracedProgram::getRegisters() const {
-  user_regs_struct regs{};
-  auto pc = ptrace(PTRACE_GETREGS, traced_pid, nullptr, &regs);
-  if (pc < 0) return std::nullopt;
-  return regs;
+    auto owner = elf_file->findFunctionByAddress(ins.address);
+    if (first || (owner != nullptr && owner->address == ins.address)) {
+      char header[32];
+      snprintf(header, sizeof(header), "%s%016lx ", first ? "" : "\n", ins.address);
+      result += header + symbolize(ins.address) + ":\n";
+      first = false;
+    }
+
+    // Source line, when it changes (as objdump -l)
+    auto entry = line_table->findByAddress(ins.address);
+    if (entry != nullptr && (source == nullptr || entry->file != source->file || entry->line != source->line))
+      result += line_table->getFiles()[entry->file] + ":" + std::to_string(entry->line) + "\n";
+    source = entry;
+
+    result += disasm::formatInstruction(ins);
+    if (ins.target) {
+      auto symbol = symbolize(*ins.target);
+      if (ins.operands.find("(%rip)") != std::string::npos) {
+        char comment[32];
+        snprintf(comment, sizeof(comment), "        # %lx", *ins.target);
+        result += comment;
+        if (!symbol.empty()) result += " " + symbol;
+      } else if (!symbol.empty())
+        result += " " + symbol;
+    }
+    result += "\n";
+  }
+  return result;
+}
+
+std::string TracedProgram::dumpAtCurrent(addr_t offset) const {
+  return dumpAt(getElfIP(), offset);
 }
 
 
@@ -1,32 +1,76 @@
 #include <cassert>
+#include <algorithm>
+#include <unistd.h>
 #include "bdd_ptrace.hpp"
 
 Breakpoint::Breakpoint(pid_t pid, addr_t const &addr, const std::string &func_name) {
   program_pid = pid;
   address = addr;
   name = func_name;
-  original = 0;
   ExclusiveIO::debug_f("Breakpoint::Breakpoint(%d, 0x%016lX)\n", program_pid, address);
 }
 
-bool Breakpoint::enable() {
-  ExclusiveIO::debug_f("Breakpoint[0x%016lX]::enable()\n", address);
-  original = ptrace(PTRACE_PEEKTEXT, program_pid, address);
-  ExclusiveIO::debug_f("Breakpoint[0x%016lX]::enable(): original = 0x%016lX\n", address, original);
-  if (ptrace(PTRACE_POKETEXT, program_pid, address, (original & TRAP_MASK) | INT3) == -1) {
-    ExclusiveIO::debugError_f("Breakpoint[0x%016lX]::enable(): ptrace error.\n", address);
-    return false;
-  }
-  enabled = true;
-  return true;
+std::size_t TracedProgram::armBreakpoints(const std::vector<addr_t> &addresses) {
+  return patchBreakpoints(addresses, true);
 }
 
-void Breakpoint::disable() {
-  ExclusiveIO::debug_f("Breakpoint[0x%016lX]::disable()\n", address);
-  if (ptrace(PTRACE_POKETEXT, program_pid, address, original) == -1) {
-    ExclusiveIO::debugError_f("Breakpoint[0x%016lX]::disable(): ptrace error.\n", address);
-    enabled = false;
+std::size_t TracedProgram::disarmBreakpoints(const std::vector<addr_t> &addresses) {
+  return patchBreakpoints(addresses, false);
+}
+
+std::size_t TracedProgram::disarmBreakpoints() {
+  std::vector<addr_t> addresses;
+  addresses.reserve(breakpointsMap.size());
+  for (const auto &kv: breakpointsMap) addresses.push_back(kv.first);
+  return disarmBreakpoints(addresses);
+}
+
+std::size_t TracedProgram::patchBreakpoints(const std::vector<addr_t> &addresses, bool arm) {
+  static const addr_t page_size = sysconf(_SC_PAGESIZE);
+  ExclusiveIO::debug_f("TracedProgram::patchBreakpoints(%zu, %d)\n", addresses.size(), arm);
+
+  // Sites to patch, sorted so that each page is a contiguous run
+  std::vector<Breakpoint *> sites;
+  for (auto address: addresses) {
+    auto it = breakpointsMap.find(address);
+    if (it != breakpointsMap.end() && it->second.isEnabled() != arm) sites.push_back(&it->second);
   }
+  std::sort(sites.begin(), sites.end(), [](const Breakpoint *a, const Breakpoint *b) {
+      return a->getAddress() < b->getAddress();
+  });
+  if (sites.empty()) return 0;
+
+  std::size_t patched = 0;
+  std::vector<std::uint8_t> buffer;
+  for (std::size_t first = 0, last; first < sites.size(); first = last) {
+    // [first, last): the sites of one page, read & written back as the range covering them
+    auto page = sites[first]->getAddress() / page_size;
+    for (last = first + 1; last < sites.size() && sites[last]->getAddress() / page_size == page; last++);
+    auto start = sites[first]->getAddress();
+    buffer.resize(sites[last - 1]->getAddress() - start + 1);
+    if (!readMemory(start, buffer).complete()) continue;
+
+    for (auto i = first; i < last; i++) {
+      auto &byte = buffer[sites[i]->getAddress() - start];
+      if (arm) {
+        sites[i]->setArmed(byte);
+        byte = INT3;
+      } else
+        byte = sites[i]->getOriginal();
+    }
+    auto access = writeMemory(start, buffer);
+    for (auto i = first; i < last; i++) {
+      if (sites[i]->getAddress() - start >= access.transferred) {
+        // Not written: back to the previous state
+        if (arm) sites[i]->setDisarmed();
+        continue;
+      }
+      if (!arm) sites[i]->setDisarmed();
+      patched++;
+    }
+  }
+  ExclusiveIO::debug_f("TracedProgram::patchBreakpoints(): %zu/%zu patched\n", patched, sites.size());
+  return patched;
 }
 
 
@@ -43,9 +87,13 @@ bool TracedProgram::breakpointAtAddress(addr_t address, std::optional<std::strin
                   Breakpoint(traced_pid, address, func_name.value()) :
                   Breakpoint(traced_pid, address);
 
-  if (hasStarted() && !bp.enable()) return false;
   setBreakpoint(bp);
-  return true;
+  if (!hasStarted()) return true;
+  // Through the memory, not PTRACE_POKETEXT: the main thread may be running (non-stop)
+  armBreakpoints({address});
+  if (breakpointsMap.at(address).isEnabled()) return true;
+  breakpointsMap.erase(address);
+  return false;
 }
 
 bool TracedProgram::breakpointAtAddress(const std::string &strAddress) {
@@ -60,7 +108,9 @@ addr_t TracedProgram::strAddr_tToHex(const std::string &strAddress) {
 bool TracedProgram::breakpointAtFunction(const std::string &fctName) {
   ExclusiveIO::debug_f("TracedProgram::breakpointAtFunction(%s)\n", fctName.c_str());
   if (!hasStarted()) {
-    auto pc = breakpointAtAddress(elf_file.getFunctionAddress(fctName), fctName);
+    addr_t elf_addr = elf_file->getFunctionAddress(fctName);
+    if (elf_addr == 0) return false;
+    auto pc = breakpointAtAddress(elf_addr, fctName);
     ExclusiveIO::debug_f("TracedProgram::breakpointAtFunction(%s): pending bp, ret code = %d\n", fctName.c_str(), pc);
     return true;
   }
@@ -69,17 +119,36 @@ bool TracedProgram::breakpointAtFunction(const std::string &fctName) {
   return breakpointAtAddress(func_addr, fctName);
 }
 
+const dwarf::LineEntry *TracedProgram::findLine(const std::string &location) const {
+  auto separator = location.rfind(':');
+  if (separator == std::string::npos || separator == 0) return nullptr;
+  auto line = strtoul(location.c_str() + separator + 1, (char **) nullptr, 10);
+  if (line == 0) return nullptr;
+  return line_table->findByLocation(std::string_view(location).substr(0, separator), line);
+}
+
+bool TracedProgram::breakpointAtLine(const std::string &location) {
+  ExclusiveIO::debug_f("TracedProgram::breakpointAtLine(%s)\n", location.c_str());
+  auto entry = findLine(location);
+  if (entry == nullptr) return false;
+
+  auto name = line_table->getFiles()[entry->file] + ":" + std::to_string(entry->line);
+  if (!hasStarted()) return breakpointAtAddress(entry->address, name);
+  return breakpointAtAddress(ram_start_address + entry->address, name);
+}
+
 addr_t TracedProgram::getFunctionPhysicalAddress(const std::string &fctName) const {
   assert(isAlive());
-  addr_t programAddress = getTracedRAMAddress();
-  addr_t elfAddress = elf_file.getFunctionAddress(fctName);
-  return programAddress + elfAddress;
+  addr_t elfAddress = elf_file->getFunctionAddress(fctName);
+  if (elfAddress == 0) return 0;
+  return getTracedRAMAddress() + elfAddress;
 }
 
 
 addr_t TracedProgram::getIP() const {
-  auto v = ptrace(PTRACE_PEEKUSER, traced_pid, sizeof(addr_t) * REGISTER_IP);
-  auto ip = v - 1;
+  auto regs = fetchRegisters();
+  // Without registers (not stopped, dead), behaves as the failing PTRACE_PEEKUSER did
+  addr_t ip = (regs ? regs->REGISTERS_IP : addr_t(-1)) - 1;
   ExclusiveIO::debug_f("TracedProgram::getIP(): 0x%016lX\n", ip);
   return ip;
 }
@@ -99,19 +168,21 @@ void TracedProgram::printBreakpointsMap() const {
   for (const auto &kv: breakpointsMap) {
     std::string buffer;
     buffer.resize(256);
-    snprintf(buffer.data(), buffer.size(), "[%s]: %s (0x%016lX)\n",
+    auto size = snprintf(buffer.data(), buffer.size(), "[%s]: %s (0x%016lX)\n",
              (kv.second.isEnabled() ? "X " : " "),
              kv.second.getName().c_str(),
              kv.second.getAddress());
+    buffer.resize(std::min<std::size_t>(size, buffer.size() - 1));
     message.append(buffer);
   }
   for (const auto &bp: pendingBreakpointsMap) {
     std::string buffer;
     buffer.resize(256);
-    snprintf(buffer.data(), buffer.size(), "[%s]: %s (0x%016lX)\n",
+    auto size = snprintf(buffer.data(), buffer.size(), "[%s]: %s (0x%016lX)\n",
              ("PENDING"),
              bp.getName().c_str(),
              bp.getAddress());
+    buffer.resize(std::min<std::size_t>(size, buffer.size() - 1));
     message.append(buffer);
   }
   ExclusiveIO::hint_f("== Breakpoints ==\n%s", message.c_str());
@@ -129,6 +200,11 @@ Breakpoint &TracedProgram::getHitBreakpoint() {
 
 
 bool TracedProgram::isTrappedAtBreakpoint() const {
+  // After a single-step, the IP follows the instruction run: an INT3 has not been hit
+  if (currentThread().resumedWith == PTRACE_SINGLESTEP) return false;
+  // Only a trap stop: interrupted, stopped with the others or back from a displaced copy, a thread may lie past an
+  // INT3 without having run it
+  if (!isTrapped() || (currentThread().status >> 16) != 0) return false;
   auto ip = getIP();
   return breakpointsMap.contains(ip);
 }
@@ -136,16 +212,30 @@ bool TracedProgram::isTrappedAtBreakpoint() const {
 bool TracedProgram::disableBreakpointAtFunction(const std::string &func_name) {
   addr_t func_addr = getFunctionPhysicalAddress(func_name);
   if (func_addr == 0 || !breakpointsMap.contains(func_addr)) return false;
-  auto bp = breakpointsMap.at(func_addr);
-  bp.disable();
+  disarmBreakpoints({func_addr});
   return true;
 }
 
 bool TracedProgram::disableBreakpointAtAddress(const std::string &hex_addr_as_str) {
   addr_t parsed_addr = strAddr_tToHex(hex_addr_as_str);
   if (!breakpointsMap.contains(parsed_addr)) return false;
-  auto bp = breakpointsMap.at(parsed_addr);
-  bp.disable();
+  disarmBreakpoints({parsed_addr});
+  return true;
+}
+
+bool TracedProgram::disableBreakpointAtLine(const std::string &location) {
+  ExclusiveIO::debug_f("TracedProgram::disableBreakpointAtLine(%s)\n", location.c_str());
+  auto entry = findLine(location);
+  if (entry == nullptr) return false;
+  if (!hasStarted()) { // Pending ones were never written to the program: no disabled state to keep them in
+    return std::erase_if(pendingBreakpointsMap, [entry](const Breakpoint &bp) {
+        return bp.getAddress() == entry->address;
+    }) > 0;
+  }
+  // As by function or address: disarmed, still listed
+  addr_t address = ram_start_address + entry->address;
+  if (!breakpointsMap.contains(address)) return false;
+  disarmBreakpoints({address});
   return true;
 }
 
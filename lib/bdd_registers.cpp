@@ -0,0 +1,75 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <cstring>
+#include "bdd_ptrace.hpp"
+
+const user_regs_struct *TracedProgram::fetchRegisters(pid_t tid) const {
+  auto it = threads.find(tid);
+  if (it == threads.end()) return nullptr;
+  auto &thread = it->second;
+  if (thread.registers) return &*thread.registers;
+  if (thread.running || !WIFSTOPPED(thread.status)) return nullptr;
+  user_regs_struct regs{};
+  if (ptrace(PTRACE_GETREGS, tid, nullptr, &regs) < 0) {
+    ExclusiveIO::debugError_f("TracedProgram::fetchRegisters(%d): %s\n", tid, strerror(errno));
+    return nullptr;
+  }
+  thread.registers = regs;
+  return &*thread.registers;
+}
+
+const user_regs_struct *TracedProgram::fetchRegisters() const {
+  return fetchRegisters(current_tid);
+}
+
+void TracedProgram::flushRegisters(pid_t tid) {
+  auto it = threads.find(tid);
+  if (it == threads.end()) return;
+  auto &thread = it->second;
+  if (!thread.registersDirty || !thread.registers) return;
+  auto rc = ptrace(PTRACE_SETREGS, tid, nullptr, &*thread.registers);
+  if (rc < 0)
+    ExclusiveIO::debugError_f("TracedProgram::flushRegisters(%d): %s\n", tid, strerror(errno));
+  thread.registersDirty = false;
+}
+
+void TracedProgram::flushRegisters() {
+  for (const auto &thread: threads) flushRegisters(thread.first);
+}
+
+void TracedProgram::invalidateRegisters(pid_t tid) {
+  auto it = threads.find(tid);
+  if (it == threads.end()) return;
+  it->second.registers.reset();
+  it->second.fpRegisters.reset();
+  it->second.registersDirty = false;
+  stop_generation++;
+}
+
+std::optional<user_regs_struct> TracedProgram::getRegisters() const {
+  auto regs = fetchRegisters();
+  if (regs == nullptr) return std::nullopt;
+  return *regs;
+}
+
+std::optional<user_fpregs_struct> TracedProgram::getFPRegisters() const {
+  auto &thread = currentThread();
+  if (thread.fpRegisters) return thread.fpRegisters;
+  if (current_tid <= 0 || thread.running || !isStopped()) return std::nullopt;
+  user_fpregs_struct regs{};
+  if (ptrace(PTRACE_GETFPREGS, current_tid, nullptr, &regs) < 0) {
+    ExclusiveIO::debugError_f("TracedProgram::getFPRegisters(): %s\n", strerror(errno));
+    return std::nullopt;
+  }
+  thread.fpRegisters = regs;
+  return thread.fpRegisters;
+}
+
+void TracedProgram::setRegisters(const user_regs_struct &regs) {
+  auto &thread = currentThread();
+  thread.registers = regs;
+  thread.registersDirty = true;
+  stop_generation++;
+}
@@ -0,0 +1,102 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include "bdd_session.hpp"
+
+DebugSession::DebugSession(const std::string &exec_path) : event_loop(std::make_shared<EventLoop>()),
+                                                           elf_registry(std::make_shared<elf::ElfRegistry>()),
+                                                           exec_path(exec_path) {
+  ExclusiveIO::initialize(getpid());
+  current_id = next_id++;
+  inferiors.emplace(current_id, std::make_unique<TracedProgram>(exec_path, event_loop, elf_registry));
+}
+
+DebugSession::~DebugSession() {
+  inferiors.clear();
+  ExclusiveIO::terminate();
+}
+
+bool DebugSession::select(int id) {
+  if (!inferiors.contains(id)) return false;
+  current_id = id;
+  return true;
+}
+
+int DebugSession::spawn(std::vector<char *> &parameters) {
+  ExclusiveIO::debug_f("DebugSession::spawn()\n");
+  auto inferior = std::make_unique<TracedProgram>(exec_path, event_loop, elf_registry);
+  inferior->setOutput(current().getOutput());
+  if (!inferior->run(parameters)) return 0;
+  auto id = next_id++;
+  ExclusiveIO::info_f("[New inferior %d (pid %d)]\n", id, inferior->getPid());
+  inferiors.emplace(id, std::move(inferior));
+  current_id = id;
+  return id;
+}
+
+void DebugSession::adoptForks() {
+  std::vector<std::unique_ptr<TracedProgram>> adopted;
+  for (auto &[id, inferior]: inferiors)
+    for (auto pid: inferior->takeForks())
+      adopted.push_back(std::make_unique<TracedProgram>(*inferior, pid));
+  for (auto &inferior: adopted) {
+    auto id = next_id++;
+    ExclusiveIO::info_f("[New inferior %d (pid %d)]\n", id, inferior->getPid());
+    forked.insert(id);
+    inferiors.emplace(id, std::move(inferior));
+  }
+}
+
+void DebugSession::interrupt() {
+  if (current().isRunning()) return current().interrupt();
+  for (auto &[id, inferior]: inferiors)
+    if (inferior->isRunning()) return inferior->interrupt();
+}
+
+void DebugSession::continueCurrent() {
+  auto &inferior = current();
+  if (isForked(current_id) && (inferior.isExiting() || inferior.isDead())) {
+    ExclusiveIO::info_f("[Inferior %d (pid %d) exited]\n", current_id, inferior.getPid());
+    forked.erase(current_id);
+    inferiors.erase(current_id);
+    current_id = inferiors.begin()->first;
+    ExclusiveIO::info_f("[Switching to inferior %d (pid %d)]\n", current_id, current().getPid());
+  }
+  current().resume();
+  waitAny();
+}
+
+void DebugSession::waitAny() {
+  while (true) {
+    adoptForks();
+    // The current inferior first: its events are the expected ones
+    std::vector<int> order{current_id};
+    for (const auto &[id, inferior]: inferiors)
+      if (id != current_id) order.push_back(id);
+
+    bool running = false;
+    for (auto id: order) {
+      auto &inferior = *inferiors.at(id);
+      if (!inferior.pollEvent()) {
+        running = running || inferior.isRunning();
+        continue;
+      }
+      if (id != current_id && (inferior.isExiting() || inferior.isDead())) {
+        ExclusiveIO::info_f("[Inferior %d (pid %d) exited]\n", id, inferior.getPid());
+        // Detached at its exit stop: its parent reaps it
+        if (forked.erase(id) > 0) inferiors.erase(id);
+        continue;
+      }
+      if (id != current_id) {
+        ExclusiveIO::info_f("[Switching to inferior %d (pid %d)]\n", id, inferior.getPid());
+        current_id = id;
+      }
+      inferior.markStop();
+      return;
+    }
+    if (!running) return;
+
+    if (event_loop->wait() == EventLoop::Event::Input && event_loop->takeLine("interrupt")) interrupt();
+  }
+}
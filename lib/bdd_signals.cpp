@@ -7,7 +7,8 @@
 
 
 bool TracedProgram::isDead() const {
-  return WIFEXITED(cached_status);
+  auto status = currentThread().status;
+  return WIFEXITED(status) || WIFSIGNALED(status);
 }
 
 
@@ -16,25 +17,37 @@ bool TracedProgram::isAlive() const {
 }
 
 bool TracedProgram::isStopped() const {
-  return WIFSTOPPED(cached_status);
+  return WIFSTOPPED(currentThread().status);
 }
 
 bool TracedProgram::isSegfault() const {
   if (!isStopped()) return false;
-  return WSTOPSIG(cached_status) == SIGSEGV;
+  return WSTOPSIG(currentThread().status) == SIGSEGV;
 }
 
 bool TracedProgram::isTrapped() const {
   if (!isStopped()) return false;
-  return WSTOPSIG(cached_status) == SIGTRAP;
+  return WSTOPSIG(currentThread().status) == SIGTRAP;
 }
 
 bool TracedProgram::isExiting() const {
   if (!isTrapped()) return false;
-  auto event = (cached_status >> 16) & 0xffff;
+  auto event = (currentThread().status >> 16) & 0xffff;
   return event == PTRACE_EVENT_EXIT;
 }
 
+bool TracedProgram::isInterrupted() const {
+  if (!isStopped()) return false;
+  auto event = currentThread().status >> 16;
+  return event == PTRACE_EVENT_STOP || (event == 0 && WSTOPSIG(currentThread().status) == SIGSTOP);
+}
+
+bool TracedProgram::hasExeced() const {
+  if (!isTrapped()) return false;
+  auto event = (currentThread().status >> 16) & 0xffff;
+  return event == PTRACE_EVENT_EXEC;
+}
+
 
 void TracedProgram::printSiginfo_t(const siginfo_t &info) {
   ExclusiveIO::debug_f("TracedProgram::printSiginfo_t():\n- code: \t%d\n- errno: \t%d\n- signo: \t%d\n", info.si_code,
@@ -45,7 +58,7 @@ void TracedProgram::printSiginfo_t(const siginfo_t &info) {
 std::pair<std::string, addr_t> TracedProgram::getSegfaultData() const {
   ExclusiveIO::debug_f("TracedProgram::getSegfaultData()\n");
   siginfo_t info;
-  auto pc = ptrace(PTRACE_GETSIGINFO, traced_pid, nullptr, &info);
+  auto pc = ptrace(PTRACE_GETSIGINFO, current_tid, nullptr, &info);
   if (pc < 0) return std::make_pair("Error fetching signal information", 0);
   ExclusiveIO::debug_f("TracedProgram::getSegfaultData(): ptrace(PTRACE_GETSIGINFO, ...) => %d\n", pc);
   printSiginfo_t(info);
@@ -135,13 +148,22 @@ std::string TracedProgram::getSegfaultCodeAsString(siginfo_t &info) {
 std::vector<std::pair<Breakpoint, bool>> TracedProgram::placeEveryPendingBreakpoints() {
   assert(isAlive());
   std::vector<std::pair<Breakpoint, bool>> status;
+  std::vector<addr_t> addresses;
+  addresses.reserve(pendingBreakpointsMap.size());
   for (Breakpoint &bp: pendingBreakpointsMap) {
     addr_t real_addr =
         bp.getAddress() < getTracedRAMAddress() ? bp.getAddress() + getTracedRAMAddress() : bp.getAddress();
-
-    status.emplace_back(bp, breakpointAtAddress(real_addr, bp.getName()));
+    breakpointsMap.try_emplace(real_addr, Breakpoint(traced_pid, real_addr, bp.getName()));
+    addresses.push_back(real_addr);
   }
   pendingBreakpointsMap.clear();
+
+  // Every INT3 written at once
+  armBreakpoints(addresses);
+  for (auto address: addresses) {
+    const auto &bp = breakpointsMap.at(address);
+    status.emplace_back(bp, bp.isEnabled());
+  }
   return status;
 }
 
@@ -0,0 +1,220 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <algorithm>
+#include <cstring>
+#include "bdd_ptrace.hpp"
+
+TracedThread &TracedProgram::currentThread() const {
+  auto it = threads.find(current_tid);
+  return it != threads.end() ? it->second : no_thread;
+}
+
+void TracedProgram::resumeThread(pid_t tid, __ptrace_request request, int signal) {
+  flushRegisters(tid);
+  invalidateRegisters(tid);
+  auto &thread = threads[tid];
+  if (ptrace(request, tid, 0, signal) < 0) {
+    ExclusiveIO::debugError_f("TracedProgram::resumeThread(%d): %s\n", tid, strerror(errno));
+    return;
+  }
+  thread.running = true;
+  thread.resumedWith = request;
+}
+
+bool TracedProgram::handleEvent(pid_t tid, int status, bool resumeStopped) {
+  ExclusiveIO::debug_f("TracedProgram::handleEvent(%d, 0x%x)\n", tid, status);
+  bool known = threads.contains(tid);
+  auto &thread = threads[tid];
+  thread.running = false;
+
+  if (WIFEXITED(status) || WIFSIGNALED(status)) {
+    if (tid == traced_pid) {
+      thread.status = status;
+      return true;
+    }
+    threads.erase(tid);
+    return false;
+  }
+  if (!WIFSTOPPED(status)) return false;
+
+  auto event = status >> 16;
+  if (event == PTRACE_EVENT_CLONE) {
+    unsigned long created = 0;
+    ptrace(PTRACE_GETEVENTMSG, tid, 0, &created);
+    // Its initial stop is taken once the thread is known
+    auto &created_thread = threads[(pid_t) created];
+    created_thread.stopRequested = true;
+    created_thread.running = true;
+    ExclusiveIO::debug_f("TracedProgram::handleEvent(): new thread %lu\n", created);
+    resumeThread(tid, thread.resumedWith);
+    return false;
+  }
+  if (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK) {
+    unsigned long child = 0;
+    ptrace(PTRACE_GETEVENTMSG, tid, 0, &child);
+    // Traced from its birth, stopped until adopted
+    if (follow_forks) forked.push_back((pid_t) child);
+    else detachFork((pid_t) child);
+    ExclusiveIO::debug_f("TracedProgram::handleEvent(): new process %lu\n", child);
+    resumeThread(tid, thread.resumedWith);
+    return false;
+  }
+  if (event == PTRACE_EVENT_EXEC && hasStarted()) {
+    // An exec from a secondary thread: its TID vanishes without any exit reported
+    unsigned long former = 0;
+    ptrace(PTRACE_GETEVENTMSG, tid, 0, &former);
+    if ((pid_t) former != tid) threads.erase((pid_t) former);
+    thread.status = status;
+    reloadAfterExec();
+    return true;
+  }
+  if (event == PTRACE_EVENT_EXIT && tid != traced_pid) {
+    resumeThread(tid, PTRACE_CONT);
+    return false;
+  }
+  // Passed silently: every child of a forking program would stop it
+  if (event == 0 && WSTOPSIG(status) == SIGCHLD) {
+    resumeThread(tid, thread.resumedWith, SIGCHLD);
+    return false;
+  }
+  // PTRACE_INTERRUPT or initial stop of a new thread (seized: no SIGSTOP involved)
+  if (event == PTRACE_EVENT_STOP && (!known || thread.stopRequested)) {
+    thread.stopRequested = false;
+    thread.status = status;
+    if (resumeStopped) resumeThread(tid, PTRACE_CONT);
+    return false;
+  }
+
+  thread.status = status;
+  return true;
+}
+
+void TracedProgram::detachFork(pid_t child) {
+  ExclusiveIO::debug_f("TracedProgram::detachFork(%d)\n", child);
+  // A running tracee can't be detached: its initial stop first
+  auto owns = [child](pid_t id) { return id == child; };
+  while (true) {
+    event_loop->reapChildren();
+    auto status = event_loop->takeStatus(owns);
+    if (status && (WIFEXITED(status->second) || WIFSIGNALED(status->second))) return;
+    if (status) break;
+    if (event_loop->wait(std::nullopt, false) == EventLoop::Event::Error) return;
+  }
+
+  auto path = "/proc/" + std::to_string(child) + "/mem";
+  auto fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd >= 0) {
+    for (const auto &[address, bp]: breakpointsMap) {
+      auto original = bp.getOriginal();
+      if (bp.isEnabled() && pwrite(fd, &original, 1, address) != 1)
+        ExclusiveIO::debugError_f("TracedProgram::detachFork(%d): 0x%016lX: %s\n", child, address, strerror(errno));
+    }
+    close(fd);
+  }
+  ptrace(PTRACE_DETACH, child, 0, 0);
+}
+
+void TracedProgram::waitAndUpdateStatus() {
+  waitForEvent(-1);
+}
+
+bool TracedProgram::waitForEvent(pid_t tid, std::optional<EventLoop::clock::time_point> deadline) {
+  pid_t reported = 0;
+  // Events seen while stopping the threads come first
+  if (tid < 0) {
+    for (auto &[id, thread]: threads) {
+      if (!thread.pending) continue;
+      thread.pending = false;
+      reported = id;
+      break;
+    }
+  }
+  while (reported == 0) {
+    auto next = nextStatus(tid, deadline, tid < 0);
+    if (!next) {
+      if (deadline && EventLoop::clock::now() >= *deadline) return false;
+      break; // nothing running anymore
+    }
+    if (handleEvent(next->first, next->second, tid < 0)) reported = next->first;
+  }
+
+  if (reported != 0) current_tid = reported;
+  else if (!threads.contains(current_tid)) current_tid = traced_pid;
+  if (reported != 0 && stop_mode == StopMode::AllStop) stopOthers();
+
+  // Every accessor of this stop reads from here
+  invalidateRegisters(current_tid);
+  fetchRegisters();
+  relocateFromScratch();
+  return true;
+}
+
+std::optional<std::pair<pid_t, int>>
+TracedProgram::nextStatus(pid_t tid, std::optional<EventLoop::clock::time_point> deadline, bool input) {
+  auto owns = [this, tid](pid_t id) { return tid > 0 ? id == tid : threads.contains(id); };
+  while (true) {
+    event_loop->reapChildren();
+    if (auto status = event_loop->takeStatus(owns)) return status;
+    // Stopped or gone threads have nothing more to tell
+    if (tid > 0 ? !threads.contains(tid) || !threads.at(tid).running : !isRunning()) return std::nullopt;
+
+    // Nothing reaped: sleep until the next SIGCHLD, line typed or the deadline
+    auto woken = event_loop->wait(deadline, input);
+    if (woken == EventLoop::Event::Timeout || woken == EventLoop::Event::Error) return std::nullopt;
+    if (woken == EventLoop::Event::Input && event_loop->takeLine("interrupt")) interrupt();
+  }
+}
+
+std::vector<pid_t> TracedProgram::stopOthers() {
+  return stopThreads(current_tid);
+}
+
+std::vector<pid_t> TracedProgram::stopThreads(pid_t except) {
+  std::vector<pid_t> stopping;
+  for (auto &[tid, thread]: threads) {
+    if (tid == except || !thread.running) continue;
+    ptrace(PTRACE_INTERRUPT, tid, 0, 0);
+    thread.stopRequested = true;
+    stopping.push_back(tid);
+  }
+
+  std::vector<pid_t> stopped;
+  for (auto tid: stopping) {
+    while (threads.contains(tid) && threads.at(tid).running) {
+      auto next = nextStatus(tid, std::nullopt, false);
+      if (!next) {
+        threads.erase(tid);
+        break;
+      }
+      // Anything else than our stop is kept for later, the stop will be swallowed then
+      if (handleEvent(tid, next->second, false)) threads.at(tid).pending = true;
+    }
+    if (threads.contains(tid) && !threads.at(tid).pending) stopped.push_back(tid);
+  }
+  ExclusiveIO::debug_f("TracedProgram::stopThreads(%d): %zu/%zu stopped\n", except, stopped.size(), stopping.size());
+  return stopped;
+}
+
+bool TracedProgram::isRunning() const {
+  return std::any_of(threads.cbegin(), threads.cend(), [](const auto &thread) { return thread.second.running; });
+}
+
+bool TracedProgram::selectThread(pid_t tid) {
+  auto it = threads.find(tid);
+  if (it == threads.end() || it->second.running) return false;
+  current_tid = tid;
+  return true;
+}
+
+std::optional<addr_t> TracedProgram::getThreadIP(pid_t tid) const {
+  auto regs = fetchRegisters(tid);
+  if (regs == nullptr) return std::nullopt;
+  return regs->REGISTERS_IP;
+}
+
+void TracedProgram::setStopMode(StopMode mode) {
+  stop_mode = mode;
+  if (mode == StopMode::AllStop && hasStarted() && isAlive() && !currentThread().running) stopOthers();
+}
@@ -0,0 +1,183 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <algorithm>
+#include <bit>
+#include <fnmatch.h>
+#include <set>
+#include "bdd_ptrace.hpp"
+
+namespace {
+    /**
+     * @return "512ns", "8.19us", "16.4ms", "2s": 3 significant digits in the largest fitting unit
+     */
+    std::string formatDuration(std::uint64_t nanoseconds) {
+      static const std::array<std::pair<double, const char *>, 3> units = {
+          {{1e9, "s"}, {1e6, "ms"}, {1e3, "us"}}};
+      char buffer[32];
+      for (const auto &[scale, unit]: units) {
+        if (nanoseconds < scale) continue;
+        snprintf(buffer, sizeof(buffer), "%.3g%s", nanoseconds / scale, unit);
+        return buffer;
+      }
+      return std::to_string(nanoseconds) + "ns";
+    }
+
+    std::uint64_t toNanoseconds(trace::clock::duration duration) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+}
+
+#pragma region Report
+
+void trace::Histogram::add(std::uint64_t nanoseconds) {
+  buckets[nanoseconds == 0 ? 0 : std::bit_width(nanoseconds) - 1]++;
+  count++;
+  total += nanoseconds;
+  min = std::min(min, nanoseconds);
+  max = std::max(max, nanoseconds);
+}
+
+std::string trace::Histogram::toString() const {
+  if (count == 0) return "(empty)\n";
+  std::string result;
+  char row[128];
+  snprintf(row, sizeof(row), "min %s, mean %s, max %s\n", formatDuration(min).c_str(),
+           formatDuration(total / count).c_str(), formatDuration(max).c_str());
+  result.append(row);
+
+  auto highest = *std::max_element(buckets.cbegin(), buckets.cend());
+  for (unsigned i = 0; i < buckets.size(); i++) {
+    if (buckets[i] == 0) continue;
+    auto bar = std::string(std::max<std::uint64_t>(1, buckets[i] * 40 / highest), '#');
+    snprintf(row, sizeof(row), "[%6s, %6s): %10lu %s\n", formatDuration(1UL << i).c_str(),
+             formatDuration(i + 1 < 64 ? 1UL << (i + 1) : UINT64_MAX).c_str(), buckets[i], bar.c_str());
+    result.append(row);
+  }
+  return result;
+}
+
+std::uint64_t trace::Report::totalHits() const {
+  std::uint64_t total = 0;
+  for (const auto &function: functions) total += function.hits;
+  return total;
+}
+
+std::string trace::Report::toString() const {
+  std::vector<const FunctionHits *> sorted;
+  for (const auto &function: functions)
+    if (function.hits > 0) sorted.push_back(&function);
+  std::sort(sorted.begin(), sorted.end(), [](const FunctionHits *a, const FunctionHits *b) {
+      return a->hits > b->hits;
+  });
+
+  std::string result;
+  char row[512];
+  auto total = totalHits();
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  snprintf(row, sizeof(row), "%lu hits on %zu/%zu functions in %.3fs (%.0f hits/sec)\n", total, sorted.size(),
+           functions.size(), seconds, seconds > 0 ? total / seconds : 0.0);
+  result.append(row);
+
+  for (const auto *function: sorted) {
+    auto length = snprintf(row, sizeof(row), "[0x%016lX]: %10lu %5.1f%%  %s", function->address, function->hits,
+                           100.0 * function->hits / total, elf::demangle(function->name).c_str());
+    if (function->timestamps.size() > 1) {
+      auto span = function->timestamps.back() - function->timestamps.front();
+      snprintf(row + length, sizeof(row) - length, " (first +%s, mean interval %s)",
+               formatDuration(function->timestamps.front()).c_str(),
+               formatDuration(span / (function->timestamps.size() - 1)).c_str());
+    }
+    result.append(row).append("\n");
+  }
+
+  result.append("Round trip per hit:\n").append(roundTrip.toString());
+  return result;
+}
+
+trace::FunctionFilter::FunctionFilter(const std::vector<std::string> &patterns) {
+  for (const auto &pattern: patterns) {
+    if (pattern.size() > 2 && pattern.front() == '/' && pattern.back() == '/') {
+      try {
+        regexes.emplace_back(pattern.substr(1, pattern.size() - 2), std::regex::ECMAScript | std::regex::optimize);
+      } catch (const std::regex_error &e) {
+        throw std::invalid_argument("trace::FunctionFilter: malformed regex " + pattern + ": " + e.what());
+      }
+    } else
+      globs.push_back(pattern);
+  }
+}
+
+bool trace::FunctionFilter::matches(const std::string &name) const {
+  return std::any_of(globs.cbegin(), globs.cend(), [&name](const std::string &glob) {
+      return fnmatch(glob.c_str(), name.c_str(), 0) == 0;
+  }) || std::any_of(regexes.cbegin(), regexes.cend(), [&name](const std::regex &regex) {
+      return std::regex_search(name, regex);
+  });
+}
+
+#pragma endregion Report
+
+
+trace::Report TracedProgram::trace(const std::vector<std::string> &patterns, bool timestamps) {
+  ExclusiveIO::debug_f("TracedProgram::trace(%zu, %d)\n", patterns.size(), timestamps);
+  trace::Report report;
+  if (!hasStarted() || !isAlive() || isExiting()) return report;
+
+  // Functions already holding a breakpoint keep stopping the program: they are left out
+  trace::FunctionFilter filter(patterns);
+  std::set<addr_t> seen;
+  for (const auto &[elf_address, name]: elf_file->getFunctionsList()) {
+    auto address = ram_start_address + elf_address;
+    if (elf_address == 0 || breakpointsMap.contains(address) || !filter.matches(name) || !seen.insert(address).second)
+      continue;
+    report.functions.push_back({name, address, 0, {}});
+  }
+  if (report.functions.empty()) return report;
+
+  // Hit lookup by address, the counters vector never grows from here
+  std::unordered_map<addr_t, trace::FunctionHits *> counters;
+  std::vector<addr_t> addresses;
+  for (auto &function: report.functions) {
+    breakpointsMap.try_emplace(function.address, traced_pid, function.address, function.name);
+    counters.emplace(function.address, &function);
+    addresses.push_back(function.address);
+  }
+  armBreakpoints(addresses);
+
+  // Hit -> count -> resume, until the program stops for anything else
+  auto start = trace::clock::now();
+  if (isTrappedAtBreakpoint() && displaceBreakpoint() == Displaced::No) resumeBreakpoint();
+  if (isStopped() && !isExiting()) resumeTraced();
+  // Each hit only stops its own thread, the others keep running
+  auto mode = stop_mode;
+  stop_mode = StopMode::NonStop;
+  // Nothing would resume the forked processes meanwhile
+  follow_forks = false;
+  while (isAlive()) {
+    waitAndUpdateStatus();
+    auto stopped = trace::clock::now();
+    if (!isTrappedAtBreakpoint()) break;
+    auto it = counters.find(getIP());
+    if (it == counters.end()) break;
+
+    it->second->hits++;
+    if (timestamps) it->second->timestamps.push_back(toNanoseconds(stopped - start));
+    if (displaceBreakpoint() == Displaced::No) {
+      resumeBreakpoint();
+      if (!isStopped()) break;
+    }
+    resumeTraced();
+    report.roundTrip.add(toNanoseconds(trace::clock::now() - stopped));
+  }
+  report.elapsed = trace::clock::now() - start;
+  setStopMode(mode);
+  follow_forks = true;
+
+  // Back to the user breakpoints only
+  if (isAlive()) disarmBreakpoints(addresses);
+  for (auto address: addresses)
+    if (!isAlive() || !breakpointsMap.at(address).isEnabled()) breakpointsMap.erase(address);
+  return report;
+}
@@ -2,20 +2,276 @@
 // Created by byjtew on 18/03/2022.
 //
 
+#include <fstream>
+#include <sstream>
 #include "bdd_ptrace.hpp"
 
+namespace {
+    // Read from the stack pointer: the frames of most stops lie within the first chunk, the snapshot doubles when a
+    // frame lies deeper, up to its size (then the deeper words are read one by one)
+    constexpr std::size_t stack_snapshot_chunk = 4 * 1024;
+    constexpr std::size_t stack_snapshot_size = 64 * 1024;
+
+    // DWARF numbers of the x86-64 registers
+    constexpr unsigned dwarf_rbp = 6;
+    constexpr unsigned dwarf_rsp = 7;
+    constexpr unsigned dwarf_rip = 16;
+}
+
 void TracedProgram::attachUnwind() {
   ExclusiveIO::debug_f("TracedProgram::attachUnwind()\n");
-  auto as = unw_create_addr_space(&_UPT_accessors, 0);
-  auto context = _UPT_create(traced_pid);
-  if (unw_init_remote(&unwind_cursor, as, context) != 0) {
+  // Libunwind reads the registers from the kernel, not from the cache
+  flushRegisters();
+  if (unwind_space == nullptr) {
+    unwind_space = unw_create_addr_space(&_UPT_accessors, 0);
+    if (unwind_space == nullptr)
+      throw std::invalid_argument("TracedProgram::attachUnwind(): cannot create the address space\n");
+    unw_set_caching_policy(unwind_space, UNW_CACHE_PER_THREAD);
+  }
+  // The contexts of the threads gone meanwhile (their TID may come back for another thread)
+  std::erase_if(unwind_contexts, [this](const std::pair<const pid_t, void *> &entry) {
+      if (threads.contains(entry.first)) return false;
+      _UPT_destroy(entry.second);
+      return true;
+  });
+  auto &context = unwind_contexts[current_tid];
+  if (context == nullptr) context = _UPT_create(current_tid);
+  if (context == nullptr || unw_init_remote(&unwind_cursor, unwind_space, context) != 0) {
     ExclusiveIO::debugError_f("TracedProgram::attachUnwind(): cannot initialize cursor for remote unwinding\n");
     throw std::invalid_argument("TracedProgram::attachUnwind(): cannot initialize cursor for remote unwinding\n");
   }
 }
 
+void TracedProgram::releaseUnwind() {
+  for (auto &[tid, context]: unwind_contexts) _UPT_destroy(context);
+  unwind_contexts.clear();
+  if (unwind_space != nullptr) unw_destroy_addr_space(unwind_space);
+  unwind_space = nullptr;
+  cached_backtrace.reset();
+  unwind_modules.clear();
+  frame_tables.clear();
+}
+
+void TracedProgram::loadUnwindModules() {
+  unwind_modules.clear();
+  // The mappings changed (dlopen, dlclose): libunwind's cached unwind info may describe what was there before
+  if (unwind_space != nullptr) unw_flush_cache(unwind_space, 0, 0);
+  std::ifstream input("/proc/" + std::to_string(traced_pid) + "/maps");
+  if (input.fail()) {
+    ExclusiveIO::debugError_f("TracedProgram::loadUnwindModules(): cannot read the mappings of %d\n", traced_pid);
+    return;
+  }
+  // First address of each file (mapped at offset 0), its Elf load address lies there
+  std::map<std::string, addr_t> firsts;
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream fields(line);
+    std::string range, permissions, device, path;
+    addr_t offset;
+    unsigned long inode;
+    fields >> range >> permissions >> std::hex >> offset >> device >> std::dec >> inode;
+    std::getline(fields >> std::ws, path);
+    auto separator = range.find('-');
+    auto start = (addr_t) strtoul(range.substr(0, separator).c_str(), nullptr, 16);
+    auto end = (addr_t) strtoul(range.substr(separator + 1).c_str(), nullptr, 16);
+    bool executable = permissions.size() >= 3 && permissions[2] == 'x';
+    if (path.empty() || path.front() != '/') {
+      // [vdso], JIT code: no file to read, only known not to reload the mappings for them
+      if (executable)
+        unwind_modules.push_back({start, end, 0, false, path.empty() ? "[anonymous]" : path, nullptr, nullptr});
+      continue;
+    }
+    if (offset == 0) firsts.try_emplace(path, start);
+    if (!executable || !firsts.contains(path)) continue;
+
+    UnwindModule module{start, end, 0, firsts[path] == ram_start_address, path.substr(path.rfind('/') + 1), nullptr,
+                        nullptr};
+    try {
+      module.file = module.main ? elf_file : elf_registry->get(path);
+    } catch (const std::invalid_argument &e) {
+      ExclusiveIO::debugError_f("TracedProgram::loadUnwindModules(%s): %s\n", path.c_str(), e.what());
+      continue;
+    }
+    module.bias = firsts[path] - module.file->getLoadAddress();
+    auto &frames = frame_tables[path];
+    if (frames == nullptr) frames = std::make_shared<const dwarf::FrameTable>(module.file);
+    module.frames = frames;
+    unwind_modules.push_back(std::move(module));
+  }
+  ExclusiveIO::debug_f("TracedProgram::loadUnwindModules(): %zu modules\n", unwind_modules.size());
+}
+
+const TracedProgram::UnwindModule *TracedProgram::findUnwindModule(addr_t address, bool &reload) {
+  while (true) {
+    for (const auto &module: unwind_modules)
+      if (address >= module.start && address < module.end) return &module;
+    // A library loaded since (dlopen): once per backtrace
+    if (!reload) return nullptr;
+    reload = false;
+    loadUnwindModules();
+  }
+}
+
+void TracedProgram::walkStack(std::vector<UnwoundFrame> &frames) {
+  frames.clear();
+#if INTPTR_MAX == INT64_MAX
+  auto regs = fetchRegisters();
+  if (regs == nullptr) return;
+  std::array<std::optional<std::uint64_t>, dwarf::cfi_register_count> registers{
+      regs->rax, regs->rdx, regs->rcx, regs->rbx, regs->rsi, regs->rdi, regs->rbp, regs->rsp,
+      regs->r8, regs->r9, regs->r10, regs->r11, regs->r12, regs->r13, regs->r14, regs->r15, regs->rip};
+  // On an INT3, the rip is past it: the instruction replaced is the one not run yet (a 1 byte function ends there)
+  if (isTrappedAtBreakpoint()) registers[dwarf_rip] = regs->rip - 1;
+
+  addr_t sp = regs->rsp;
+  stack_snapshot.resize(stack_snapshot_size);
+  std::size_t snapshot = 0;
+  bool exhausted = false; // the end of the stack mapping has been reached
+  auto readWord = [this, sp, &snapshot, &exhausted](addr_t address) -> std::optional<std::uint64_t> {
+      std::uint64_t value;
+      auto within = address >= sp && address - sp <= stack_snapshot_size - sizeof(value);
+      auto needed = address - sp + sizeof(value);
+      if (within && !exhausted && needed > snapshot) {
+        auto size = std::max(snapshot, stack_snapshot_chunk);
+        while (size < needed) size *= 2;
+        size = std::min(size, stack_snapshot_size);
+        auto read = readMemory(sp + snapshot, std::span(stack_snapshot).subspan(snapshot, size - snapshot)).transferred;
+        exhausted = read < size - snapshot;
+        snapshot += read;
+      }
+      if (within && needed <= snapshot) {
+        std::memcpy(&value, stack_snapshot.data() + (address - sp), sizeof(value));
+        return value;
+      }
+      std::array<std::uint8_t, sizeof(value)> bytes{};
+      if (!readMemory(address, bytes).complete()) return std::nullopt;
+      std::memcpy(&value, bytes.data(), sizeof(value));
+      return value;
+  };
+
+  bool reload = true;
+  bool interrupted = true; // the pc of the frame is the instruction itself, not a return address
+  for (unsigned depth = 0; depth < max_stack_size; depth++) {
+    addr_t pc = *registers[dwarf_rip];
+    // Return addresses point after the call: look the call itself up
+    auto lookup = interrupted ? pc : pc - 1;
+    auto module = findUnwindModule(lookup, reload);
+    // Nothing to go by for the first frame (no module, or no file to read its CFI from)
+    if (depth == 0 && (module == nullptr || module->file == nullptr)) return;
+    // A return address outside every executable mapping: the frame before was misread
+    if (module == nullptr) break;
+    frames.push_back({pc, lookup});
+
+    // Registers of the caller
+    std::array<std::optional<std::uint64_t>, dwarf::cfi_register_count> caller{};
+    dwarf::FrameRow row;
+    if (module != nullptr && module->frames != nullptr && module->frames->findRow(lookup - module->bias, row)) {
+      auto readRegister = [&registers](unsigned reg) {
+          return reg < registers.size() ? registers[reg] : std::nullopt;
+      };
+      std::optional<std::uint64_t> cfa;
+      if (!row.cfaExpression.empty())
+        cfa = dwarf::evaluate(row.cfaExpression, std::nullopt, readRegister, readWord);
+      else if (auto base = readRegister(row.cfaRegister))
+        cfa = *base + row.cfaOffset;
+      if (!cfa) break;
+
+      for (unsigned reg = 0; reg < caller.size(); reg++) {
+        const auto &rule = row.registers[reg];
+        switch (rule.kind) {
+          case dwarf::RegisterRule::Kind::Unspecified:
+          case dwarf::RegisterRule::Kind::SameValue:
+            caller[reg] = registers[reg];
+            break;
+          case dwarf::RegisterRule::Kind::Undefined:
+            break;
+          case dwarf::RegisterRule::Kind::Offset:
+            caller[reg] = readWord(*cfa + rule.value);
+            break;
+          case dwarf::RegisterRule::Kind::ValOffset:
+            caller[reg] = *cfa + rule.value;
+            break;
+          case dwarf::RegisterRule::Kind::Register:
+            caller[reg] = readRegister(rule.value);
+            break;
+          case dwarf::RegisterRule::Kind::Expression:
+            if (auto address = dwarf::evaluate(rule.expression, cfa, readRegister, readWord))
+              caller[reg] = readWord(*address);
+            break;
+          case dwarf::RegisterRule::Kind::ValExpression:
+            caller[reg] = dwarf::evaluate(rule.expression, cfa, readRegister, readWord);
+            break;
+        }
+      }
+      // The stack pointer of the caller is the CFA, unless saved somewhere else
+      if (row.registers[dwarf_rsp].kind == dwarf::RegisterRule::Kind::Unspecified) caller[dwarf_rsp] = cfa;
+      // The outermost frame (_start, clone) has its return address undefined
+      if (row.returnAddressRegister >= caller.size()) break;
+      caller[dwarf_rip] = caller[row.returnAddressRegister];
+      interrupted = row.signalFrame;
+    } else {
+      // No CFI: the frame pointer chain (rbp -> saved rbp, return address above it)
+      auto frame = registers[dwarf_rbp];
+      if (!frame || *frame == 0) break;
+      caller = registers;
+      caller[dwarf_rbp] = readWord(*frame);
+      caller[dwarf_rip] = readWord(*frame + sizeof(addr_t));
+      caller[dwarf_rsp] = *frame + 2 * sizeof(addr_t);
+      interrupted = false;
+    }
+
+    if (!caller[dwarf_rip] || *caller[dwarf_rip] == 0) break;
+    // A corrupted stack would loop: the stack only grows back (but a signal frame may switch stacks)
+    if (!interrupted && (!caller[dwarf_rsp] || !registers[dwarf_rsp] || *caller[dwarf_rsp] <= *registers[dwarf_rsp]))
+      break;
+    registers = caller;
+  }
+#endif
+}
+
+std::queue<std::pair<addr_t, std::string>> TracedProgram::unwindStack() {
+  std::queue<std::pair<addr_t, std::string>> queue;
+  walkStack(unwound_frames);
+  bool reload = false;
+  for (const auto &[pc, lookup]: unwound_frames) {
+    auto module = findUnwindModule(lookup, reload);
+    auto function = module != nullptr && module->file != nullptr ?
+                    module->file->findFunctionByAddress(lookup - module->bias) : nullptr;
+    if (function != nullptr) {
+      auto name = elf::demangle(function->name);
+      auto location = module->main ? getSourceLocation(lookup - module->bias) : std::string();
+      queue.emplace(pc - module->bias - function->address, location.empty() ? name : name + " at " + location);
+    } else if (module != nullptr) {
+      // Static function of a stripped library, vdso: its address in the module at least
+      queue.emplace(pc - module->bias, "?? (" + module->name + ")");
+    }
+  }
+  return queue;
+}
+
+std::string TracedProgram::getFunctionAt(addr_t address) {
+  bool reload = false;
+  auto module = findUnwindModule(address, reload);
+  if (module == nullptr) return fmt::format("0x{:x}", address);
+  auto function = module->file != nullptr ? module->file->findFunctionByAddress(address - module->bias) : nullptr;
+  return function != nullptr ? elf::demangle(function->name) : "[" + module->name + "]";
+}
+
 std::queue<std::pair<addr_t, std::string>> TracedProgram::backtrace() {
   ExclusiveIO::debug_f("TracedProgram::backtrace()\n");
+  if (cached_backtrace && cached_backtrace->tid == current_tid && cached_backtrace->generation == stop_generation)
+    return cached_backtrace->frames;
+  auto queue = unwindStack();
+  if (queue.empty()) queue = unwindLibunwind();
+  cached_backtrace = CachedBacktrace{current_tid, stop_generation, queue};
+  return queue;
+}
+
+std::queue<std::pair<addr_t, std::string>> TracedProgram::backtrace(Unwinder unwinder) {
+  return unwinder == Unwinder::Own ? unwindStack() : unwindLibunwind();
+}
+
+std::queue<std::pair<addr_t, std::string>> TracedProgram::unwindLibunwind() {
   std::queue<std::pair<addr_t, std::string>> queue;
   unw_word_t offset, pc;
   char sym[256];
@@ -24,17 +280,18 @@ std::queue<std::pair<addr_t, std::string>> TracedProgram::backtrace() {
 
   do {
     if (unw_get_reg(&unwind_cursor, UNW_REG_IP, &pc)) {
-      ExclusiveIO::debugError_f("TracedProgram::backtrace(): cannot read program counter\n");
+      ExclusiveIO::debugError_f("TracedProgram::unwindLibunwind(): cannot read program counter\n");
       return queue;
     }
 
     if (unw_get_proc_name(&unwind_cursor, sym, sizeof(sym), &offset) == 0) {
-      ExclusiveIO::debug_f("TracedProgram::backtrace(): (%s+0x%016lx)\n", sym, offset);
-      queue.push(std::make_pair(offset, sym));
+      ExclusiveIO::debug_f("TracedProgram::unwindLibunwind(): (%s+0x%016lx)\n", sym, offset);
+      // Return addresses point after the call: look the call itself up
+      auto location = getSourceLocation(pc - ram_start_address - (queue.empty() ? 0 : 1));
+      queue.push(std::make_pair(offset, location.empty() ? std::string(sym) : std::string(sym) + " at " + location));
     } else
-      ExclusiveIO::debugError_f("TracedProgram::backtrace(): no symbol name found\n");
+      ExclusiveIO::debugError_f("TracedProgram::unwindLibunwind(): no symbol name found\n");
   } while (unw_step(&unwind_cursor) > 0 && queue.size() < max_stack_size);
-
   return queue;
 }
 
@@ -0,0 +1,20 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+#include "stdlib.h"
+#include "string.h"
+
+// Breakpoint here: the buffer is filled (rdi: address, rsi: size)
+__attribute__((noinline)) void buffer_ready(char *buffer, size_t size) {
+  __asm__ volatile("" : : "r"(buffer), "r"(size) : "memory");
+}
+
+int main(int argc, char **argv) {
+  size_t size = argc > 1 ? strtoul(argv[1], NULL, 0) : 16 << 20;
+  char *buffer = malloc(size);
+  if (buffer == NULL) return 1;
+  for (size_t i = 0; i < size; i++) buffer[i] = (char) (i * 31 + 7);
+  buffer_ready(buffer, size);
+  free(buffer);
+  return 0;
+}
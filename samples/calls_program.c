@@ -0,0 +1,25 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+#include "stdio.h"
+#include "stdlib.h"
+
+static volatile unsigned long total = 0;
+
+__attribute__((noinline)) void callee_add(unsigned long value) {
+  total += value;
+}
+
+__attribute__((noinline)) void callee_sub(unsigned long value) {
+  total -= value / 2;
+}
+
+int main(int argc, char **argv) {
+  unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+  for (unsigned long i = 0; i < iterations; i++) {
+    callee_add(i);
+    callee_sub(i);
+  }
+  printf("%lu calls, total = %lu\n", 2 * iterations, total);
+  return 0;
+}
@@ -0,0 +1,29 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+#include "stdio.h"
+#include "stdlib.h"
+
+// Breakpoint here: depth frames of recurse below
+__attribute__((noinline)) void deepest(unsigned long depth) {
+  __asm__ volatile("" : : "r"(depth) : "memory");
+}
+
+// Not a tail call (the barrier keeps GCC from turning it into a loop): one frame per level, a stack buffer in each
+__attribute__((noinline)) unsigned long recurse(unsigned long depth) {
+  if (depth == 0) {
+    deepest(depth);
+    return 0;
+  }
+  volatile char local[24];
+  local[0] = (char) depth;
+  unsigned long sum = recurse(depth - 1);
+  __asm__ volatile("" : "+r"(sum));
+  return sum + local[0];
+}
+
+int main(int argc, char **argv) {
+  unsigned long depth = argc > 1 ? strtoul(argv[1], NULL, 0) : 100;
+  printf("%lu\n", recurse(depth));
+  return 0;
+}
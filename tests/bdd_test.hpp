@@ -0,0 +1,112 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#ifndef C_BDD_BDD_TEST_HPP
+#define C_BDD_BDD_TEST_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "bdd_elf.hpp"
+
+/**
+ * Minimal checks for the tests: each one is an executable run by ctest, failing if any CHECK did
+ */
+namespace test {
+    inline unsigned failures = 0;
+
+    inline void check(bool condition, const char *expression, const char *file, int line) {
+      if (condition) return;
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+      failures++;
+    }
+
+    inline int result() {
+      if (failures > 0) std::fprintf(stderr, "%u check(s) failed\n", failures);
+      return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    /**
+     * Writes an ELF file made of the given sections only (no segment), to feed the decoders hand-made bytes
+     */
+    class ElfWriter {
+    private:
+        struct Section {
+            std::string name;
+            Elf_Shdr header;
+            std::vector<std::uint8_t> data;
+        };
+        std::vector<Section> sections;
+
+    public:
+        void add(std::string name, std::vector<std::uint8_t> data, std::uint32_t type = SHT_PROGBITS,
+                     addr_t address = 0) {
+          Elf_Shdr header{};
+          header.sh_type = type;
+          header.sh_addr = address;
+          header.sh_addralign = 1;
+          sections.push_back({std::move(name), header, std::move(data)});
+        }
+
+        /**
+         * @return the path of a new file in the temporary directory, removed by the caller
+         */
+        std::string write() const {
+          auto all = sections;
+          Elf_Shdr namesHeader{};
+          namesHeader.sh_type = SHT_STRTAB;
+          namesHeader.sh_addralign = 1;
+          all.push_back({".shstrtab", namesHeader, {0}});
+          for (auto &section: all) {
+            section.header.sh_name = all.back().data.size();
+            all.back().data.insert(all.back().data.end(), section.name.begin(), section.name.end());
+            all.back().data.push_back(0);
+          }
+
+          std::vector<Elf_Shdr> headers(1);
+          std::vector<std::uint8_t> bytes(sizeof(Elf_Ehdr));
+          for (auto &section: all) {
+            section.header.sh_offset = bytes.size();
+            section.header.sh_size = section.data.size();
+            bytes.insert(bytes.end(), section.data.begin(), section.data.end());
+            headers.push_back(section.header);
+          }
+
+          Elf_Ehdr header{};
+          std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+          header.e_ident[EI_CLASS] = ELFCLASS64;
+          header.e_ident[EI_DATA] = ELFDATA2LSB;
+          header.e_ident[EI_VERSION] = EV_CURRENT;
+          header.e_type = ET_EXEC;
+          header.e_machine = EM_X86_64;
+          header.e_version = EV_CURRENT;
+          header.e_ehsize = sizeof(Elf_Ehdr);
+          header.e_shentsize = sizeof(Elf_Shdr);
+          header.e_shnum = headers.size();
+          header.e_shstrndx = headers.size() - 1;
+          header.e_shoff = (bytes.size() + 7) & ~std::size_t(7);
+          bytes.resize(header.e_shoff);
+          std::memcpy(bytes.data(), &header, sizeof(header));
+          auto table = reinterpret_cast<const std::uint8_t *>(headers.data());
+          bytes.insert(bytes.end(), table, table + headers.size() * sizeof(Elf_Shdr));
+
+          char path[] = "/tmp/c_bdd_test_XXXXXX";
+          int fd = mkstemp(path);
+          if (fd == -1 || ::write(fd, bytes.data(), bytes.size()) != (ssize_t) bytes.size()) std::abort();
+          close(fd);
+          return path;
+        }
+    };
+
+} // namespace test
+
+#define CHECK(condition) test::check((condition), #condition, __FILE__, __LINE__)
+
+#endif //C_BDD_BDD_TEST_HPP
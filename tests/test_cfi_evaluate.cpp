@@ -0,0 +1,96 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <map>
+#include <vector>
+
+#include "bdd_dwarf.hpp"
+#include "bdd_test.hpp"
+
+namespace {
+    constexpr std::uint8_t DW_OP_deref = 0x06, DW_OP_const1u = 0x08, DW_OP_const1s = 0x09, DW_OP_const8s = 0x0f,
+        DW_OP_drop = 0x13, DW_OP_abs = 0x19, DW_OP_and = 0x1a, DW_OP_div = 0x1b, DW_OP_minus = 0x1c, DW_OP_neg = 0x1f,
+        DW_OP_plus = 0x22, DW_OP_shl = 0x24, DW_OP_bra = 0x28, DW_OP_ge = 0x2a, DW_OP_lt = 0x2d, DW_OP_skip = 0x2f,
+        DW_OP_lit0 = 0x30, DW_OP_reg0 = 0x50, DW_OP_breg0 = 0x70, DW_OP_bregx = 0x92, DW_OP_deref_size = 0x94;
+
+    // INT64_MIN, little endian
+    const std::vector<std::uint8_t> int64_min = {DW_OP_const8s, 0, 0, 0, 0, 0, 0, 0, 0x80};
+
+    constexpr unsigned dwarf_rbp = 6, dwarf_rsp = 7, dwarf_rip = 16;
+
+    struct Machine {
+        std::map<unsigned, std::uint64_t> registers;
+        std::map<addr_t, std::uint64_t> memory;
+
+        std::optional<std::uint64_t> evaluate(const std::vector<std::uint8_t> &expression,
+                                              std::optional<std::uint64_t> initial = std::nullopt) const {
+          return dwarf::evaluate(expression, initial, [this](unsigned reg) -> std::optional<std::uint64_t> {
+              auto it = registers.find(reg);
+              return it != registers.end() ? std::optional(it->second) : std::nullopt;
+          }, [this](addr_t address) -> std::optional<std::uint64_t> {
+              auto it = memory.find(address);
+              return it != memory.end() ? std::optional(it->second) : std::nullopt;
+          });
+        }
+    };
+
+    /**
+     * The CFA of a PLT entry, as GCC & binutils write it in .eh_frame: rsp + 8, + 8 more once past the push of the
+     * entry (rip & 15 >= 11)
+     */
+    const std::vector<std::uint8_t> plt_cfa = {DW_OP_breg0 + dwarf_rsp, 8, DW_OP_bregx, dwarf_rip, 0, DW_OP_lit0 + 15,
+                                               DW_OP_and, DW_OP_lit0 + 11, DW_OP_ge, DW_OP_lit0 + 3, DW_OP_shl,
+                                               DW_OP_plus};
+}
+
+int main() {
+  Machine machine;
+  machine.registers = {{dwarf_rsp, 0x7ffc0000}, {dwarf_rbp, 0x7ffc0040}, {dwarf_rip, 0x401020}};
+  machine.memory = {{0x7ffc0030, 0x1122334455667788}};
+
+  CHECK(machine.evaluate(plt_cfa) == 0x7ffc0008);
+  machine.registers[dwarf_rip] = 0x40102b;
+  CHECK(machine.evaluate(plt_cfa) == 0x7ffc0010);
+
+  // Register rule: the CFA pushed first, the saved value 16 bytes below it
+  CHECK(machine.evaluate({DW_OP_lit0 + 16, DW_OP_minus}, 0x7ffc0040) == 0x7ffc0030);
+  // Memory reads, whole & truncated: rbp - 16 (SLEB128 0x70)
+  CHECK(machine.evaluate({DW_OP_breg0 + dwarf_rbp, 0x70, DW_OP_deref}) == 0x1122334455667788);
+  CHECK(machine.evaluate({DW_OP_breg0 + dwarf_rbp, 0x70, DW_OP_deref_size, 2}) == 0x7788);
+  // Signed comparison: -1 < 0
+  CHECK(machine.evaluate({DW_OP_const1s, 0xff, DW_OP_lit0, DW_OP_lt}) == 1);
+  CHECK(machine.evaluate({DW_OP_const1u, 0xff, DW_OP_lit0, DW_OP_lt}) == 0);
+
+  // INT64_MIN: negated (abs too) to itself, divided by -1 refused (SIGFPE on x86-64)
+  auto withMin = [&machine](std::initializer_list<std::uint8_t> operations) {
+      auto expression = int64_min;
+      expression.insert(expression.end(), operations);
+      return machine.evaluate(expression);
+  };
+  CHECK(withMin({DW_OP_neg}) == 0x8000000000000000);
+  CHECK(withMin({DW_OP_abs}) == 0x8000000000000000);
+  CHECK(machine.evaluate({DW_OP_const1s, 0xfb, DW_OP_abs}) == 5);
+  CHECK(!withMin({DW_OP_const1s, 0xff, DW_OP_div}));
+  CHECK(withMin({DW_OP_lit0 + 2, DW_OP_div}) == 0xc000000000000000);
+
+  // Branch taken to the last literal, or not then skipping it
+  auto branch = [&machine](std::uint8_t condition) {
+      return machine.evaluate({condition, DW_OP_bra, 4, 0, DW_OP_lit0 + 2, DW_OP_skip, 1, 0, DW_OP_lit0 + 3});
+  };
+  CHECK(branch(DW_OP_lit0 + 1) == 3);
+  CHECK(branch(DW_OP_lit0) == 2);
+
+  // Failures: unsupported operation, empty stack, division by zero, unknown register or memory, endless loop,
+  // truncated operand, branch out of the expression
+  CHECK(!machine.evaluate({DW_OP_reg0}));
+  CHECK(!machine.evaluate({DW_OP_drop}));
+  CHECK(!machine.evaluate({}));
+  CHECK(!machine.evaluate({DW_OP_lit0 + 1, DW_OP_lit0, DW_OP_div}));
+  CHECK(!machine.evaluate({DW_OP_breg0 + 3, 0}));
+  CHECK(!machine.evaluate({DW_OP_breg0 + dwarf_rsp, 0, DW_OP_deref}));
+  CHECK(!machine.evaluate({DW_OP_skip, 0xfd, 0xff}));
+  CHECK(!machine.evaluate({DW_OP_const1u}));
+  CHECK(!machine.evaluate({DW_OP_skip, 0x10, 0}));
+  return test::result();
+}
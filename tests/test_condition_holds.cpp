@@ -0,0 +1,63 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <functional>
+
+#include "bdd_disassembler.hpp"
+#include "bdd_test.hpp"
+
+namespace {
+    constexpr std::uint64_t CF = 1 << 0, PF = 1 << 2, ZF = 1 << 6, SF = 1 << 7, OF = 1 << 11;
+
+    struct Flags {
+        bool cf, pf, zf, sf, of;
+    };
+
+    // Intel manual, "Jcc—Jump if Condition Is Met", in opcode order (0x70 to 0x7F)
+    const std::array<std::pair<const char *, std::function<bool(const Flags &)>>, 16> conditions = {{
+        {"jo", [](const Flags &f) { return f.of; }},
+        {"jno", [](const Flags &f) { return !f.of; }},
+        {"jb", [](const Flags &f) { return f.cf; }},
+        {"jae", [](const Flags &f) { return !f.cf; }},
+        {"je", [](const Flags &f) { return f.zf; }},
+        {"jne", [](const Flags &f) { return !f.zf; }},
+        {"jbe", [](const Flags &f) { return f.cf || f.zf; }},
+        {"ja", [](const Flags &f) { return !f.cf && !f.zf; }},
+        {"js", [](const Flags &f) { return f.sf; }},
+        {"jns", [](const Flags &f) { return !f.sf; }},
+        {"jp", [](const Flags &f) { return f.pf; }},
+        {"jnp", [](const Flags &f) { return !f.pf; }},
+        {"jl", [](const Flags &f) { return f.sf != f.of; }},
+        {"jge", [](const Flags &f) { return f.sf == f.of; }},
+        {"jle", [](const Flags &f) { return f.zf || f.sf != f.of; }},
+        {"jg", [](const Flags &f) { return !f.zf && f.sf == f.of; }},
+    }};
+}
+
+int main() {
+  // Every combination of the 5 flags read, with the others (IF, reserved bit 1, ...) set or not
+  for (std::uint8_t condition = 0; condition < conditions.size(); condition++) {
+    for (unsigned combination = 0; combination < 32; combination++) {
+      Flags flags{(combination & 1) != 0, (combination & 2) != 0, (combination & 4) != 0, (combination & 8) != 0,
+                  (combination & 16) != 0};
+      std::uint64_t eflags = (flags.cf ? CF : 0) | (flags.pf ? PF : 0) | (flags.zf ? ZF : 0) | (flags.sf ? SF : 0) |
+                             (flags.of ? OF : 0);
+      bool expected = conditions[condition].second(flags);
+      if (disasm::conditionHolds(condition, eflags) != expected ||
+          disasm::conditionHolds(condition, eflags | 0x202) != expected) {
+        std::fprintf(stderr, "%s with eflags 0x%lx\n", conditions[condition].first, eflags);
+        CHECK(false);
+      }
+    }
+  }
+
+  // After "cmp $2, %eax" with eax = 1: below, less, not equal
+  std::uint64_t eflags = CF | SF | PF | 0x202;
+  CHECK(disasm::conditionHolds(0x2, eflags));  // jb
+  CHECK(disasm::conditionHolds(0xC, eflags));  // jl
+  CHECK(disasm::conditionHolds(0x5, eflags));  // jne
+  CHECK(!disasm::conditionHolds(0x7, eflags)); // ja
+  CHECK(!disasm::conditionHolds(0xF, eflags)); // jg
+  return test::result();
+}
@@ -0,0 +1,110 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <memory>
+
+#include "bdd_dwarf.hpp"
+#include "bdd_test.hpp"
+
+namespace {
+    constexpr std::uint8_t DW_LNS_copy = 1, DW_LNS_advance_pc = 2, DW_LNS_advance_line = 3, DW_LNS_set_file = 4,
+        DW_LNS_negate_stmt = 6;
+    constexpr std::uint8_t DW_LNE_end_sequence = 1, DW_LNE_set_address = 2;
+
+    constexpr std::int8_t line_base = -5;
+    constexpr std::uint8_t line_range = 14, opcode_base = 13;
+
+    void setAddress(std::vector<std::uint8_t> &program, addr_t address) {
+      program.insert(program.end(), {0, 9, DW_LNE_set_address});
+      for (unsigned i = 0; i < 8; i++) program.push_back(address >> (8 * i));
+    }
+
+    std::uint8_t special(unsigned addressAdvance, int lineAdvance) {
+      return (lineAdvance - line_base) + line_range * addressAdvance + opcode_base;
+    }
+
+    /**
+     * A DWARF 4 unit of 2 files in /src: a.c:10 at 0x1000, a.c:11 at 0x1004, a.c:16 at 0x100C, then b.c:16 (not a
+     * statement) at 0x100E up to 0x1010. Followed by a sequence at address 0, as left by the linker for a discarded
+     * function.
+     */
+    std::vector<std::uint8_t> lineProgram() {
+      std::vector<std::uint8_t> header{
+          1, // minimum_instruction_length
+          1, // maximum_operations_per_instruction
+          1, // default_is_stmt
+          static_cast<std::uint8_t>(line_base), line_range, opcode_base,
+          0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1 // standard_opcode_lengths
+      };
+      for (auto text: {"/src", ""}) header.insert(header.end(), text, text + std::strlen(text) + 1);
+      for (auto name: {"a.c", "b.c"}) {
+        header.insert(header.end(), name, name + std::strlen(name) + 1);
+        header.insert(header.end(), {1, 0, 0}); // directory, modification time, length
+      }
+      header.push_back(0);
+
+      std::vector<std::uint8_t> program;
+      setAddress(program, 0x1000);
+      program.insert(program.end(), {DW_LNS_advance_line, 9, DW_LNS_copy});
+      program.push_back(special(4, 1));
+      program.insert(program.end(), {DW_LNS_advance_line, 5, DW_LNS_advance_pc, 8, DW_LNS_copy});
+      program.insert(program.end(), {DW_LNS_set_file, 2, DW_LNS_negate_stmt});
+      program.push_back(special(2, 0));
+      program.insert(program.end(), {DW_LNS_advance_pc, 2, 0, 1, DW_LNE_end_sequence});
+      setAddress(program, 0);
+      program.insert(program.end(), {DW_LNS_copy, DW_LNS_advance_pc, 4, 0, 1, DW_LNE_end_sequence});
+
+      std::vector<std::uint8_t> unit{0, 0, 0, 0, 4, 0}; // unit_length (set below), version
+      for (unsigned i = 0; i < 4; i++) unit.push_back(header.size() >> (8 * i));
+      unit.insert(unit.end(), header.begin(), header.end());
+      unit.insert(unit.end(), program.begin(), program.end());
+      for (unsigned i = 0; i < 4; i++) unit[i] = (unit.size() - 4) >> (8 * i);
+      return unit;
+    }
+}
+
+int main() {
+  test::ElfWriter writer;
+  writer.add(".debug_line", lineProgram());
+  auto path = writer.write();
+  dwarf::LineTable table(std::make_shared<const elf::ElfFile>(path));
+
+  CHECK(!table.empty());
+  const auto &files = table.getFiles();
+  auto fileOf = [&files](const dwarf::LineEntry *entry) { return entry ? files.at(entry->file) : std::string(); };
+
+  auto entry = table.findByAddress(0x1000);
+  CHECK(entry != nullptr && entry->line == 10 && entry->isStatement);
+  CHECK(fileOf(entry) == "/src/a.c");
+  entry = table.findByAddress(0x1003);
+  CHECK(entry != nullptr && entry->line == 10);
+  entry = table.findByAddress(0x1004);
+  CHECK(entry != nullptr && entry->line == 11);
+  entry = table.findByAddress(0x100D);
+  CHECK(entry != nullptr && entry->line == 16 && fileOf(entry) == "/src/a.c");
+  entry = table.findByAddress(0x100E);
+  CHECK(entry != nullptr && entry->line == 16 && !entry->isStatement && fileOf(entry) == "/src/b.c");
+  // End of the sequence, before it & the discarded one
+  CHECK(table.findByAddress(0x1010) == nullptr);
+  CHECK(table.findByAddress(0xFFF) == nullptr);
+  CHECK(table.findByAddress(0x2) == nullptr);
+
+  entry = table.findByLocation("a.c", 10);
+  CHECK(entry != nullptr && entry->address == 0x1000);
+  entry = table.findByLocation("/src/a.c", 11);
+  CHECK(entry != nullptr && entry->address == 0x1004);
+  // No code at 12: the next line having some
+  entry = table.findByLocation("src/a.c", 12);
+  CHECK(entry != nullptr && entry->line == 16 && entry->address == 0x100C);
+  CHECK(table.findByLocation("a.c", 17) == nullptr);
+  CHECK(table.findByLocation("rc/a.c", 10) == nullptr);
+  // Only statements are breakpoint locations
+  CHECK(table.findByLocation("b.c", 16) == nullptr);
+
+  CHECK(table.getLocationString(0x1005) == "/src/a.c:11");
+  CHECK(table.getLocationString(0x1010).empty());
+
+  unlink(path.c_str());
+  return test::result();
+}
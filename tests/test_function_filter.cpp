@@ -0,0 +1,45 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include <stdexcept>
+
+#include "bdd_test.hpp"
+#include "bdd_trace.hpp"
+
+int main() {
+  trace::FunctionFilter globs({"callee_*", "?ain", "str[np]cpy"});
+  CHECK(globs.matches("callee_add"));
+  CHECK(globs.matches("callee_"));
+  CHECK(!globs.matches("my_callee_add"));
+  CHECK(globs.matches("main"));
+  CHECK(!globs.matches("domain"));
+  CHECK(globs.matches("strncpy") && globs.matches("strpcpy"));
+  CHECK(!globs.matches("strcpy"));
+
+  // A regex matches anywhere in the name unless anchored
+  trace::FunctionFilter regexes({"/^_Z.*vector/", "/alloc$/"});
+  CHECK(regexes.matches("_ZNSt6vectorIiSaIiEE9push_backEOi"));
+  CHECK(!regexes.matches("vector_Z"));
+  CHECK(regexes.matches("malloc") && regexes.matches("calloc"));
+  CHECK(!regexes.matches("allocate"));
+
+  // Too short to be a regex: "/" & "//" are globs
+  trace::FunctionFilter slashes({"/", "//"});
+  CHECK(slashes.matches("/") && slashes.matches("//"));
+  CHECK(!slashes.matches("a"));
+
+  trace::FunctionFilter both({"callee_*", "/sub/"});
+  CHECK(both.matches("callee_add") && both.matches("substitute"));
+  CHECK(!both.matches("main"));
+  CHECK(!trace::FunctionFilter({}).matches("main"));
+
+  bool thrown = false;
+  try {
+    trace::FunctionFilter malformed({"/(unclosed/"});
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  return test::result();
+}
@@ -0,0 +1,34 @@
+//
+// Created by byjtew on 17/10/2026.
+//
+
+#include "bdd_exclusive_io.hpp"
+#include "bdd_test.hpp"
+
+using exclusive_io::stringLimits;
+
+int main() {
+  const char *text = "abcdef";
+  // Strings printed whole, other arguments
+  CHECK((stringLimits("%s %d\n", text, 3) == std::array<std::size_t, 2>{SIZE_MAX, SIZE_MAX}));
+  CHECK((stringLimits("%-20s|%5lu", text, 3UL) == std::array<std::size_t, 2>{SIZE_MAX, SIZE_MAX}));
+  // Precisions, literal or as an argument (negative: none)
+  CHECK((stringLimits("%.3s", text) == std::array<std::size_t, 1>{3}));
+  CHECK((stringLimits("%10.0s|", text) == std::array<std::size_t, 1>{0}));
+  CHECK((stringLimits("(%.*s+0x%lX)", 4, text, 16UL) == std::array<std::size_t, 3>{SIZE_MAX, 4, SIZE_MAX}));
+  CHECK((stringLimits("%.*s", -1, text) == std::array<std::size_t, 2>{SIZE_MAX, SIZE_MAX}));
+  // A "*" width takes an argument too, "%%" none
+  CHECK((stringLimits("100%% %*.*s %s", 8, 2, text, text) ==
+         std::array<std::size_t, 4>{SIZE_MAX, SIZE_MAX, 2, SIZE_MAX}));
+  // More conversions than arguments, a trailing "%"
+  CHECK((stringLimits("%.2s %.1s %", text) == std::array<std::size_t, 1>{2}));
+
+  // Only the limit is read: no terminating null needed
+  char view[3] = {'x', 'y', 'z'};
+  CHECK(exclusive_io::Encoded<const char *>::size(view, 2) == sizeof(std::uint32_t) + 2 + 1);
+  char record[16];
+  exclusive_io::Encoded<const char *>::write(record, view, 2);
+  const char *from = record;
+  CHECK(std::string_view(exclusive_io::Encoded<const char *>::read(from)) == "xy");
+  return test::result();
+}